@@ -0,0 +1,713 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+/* classes */
+
+/* bddManager */
+
+// purpose: owns the nodes of reduced ordered binary decision diagrams, so
+//	diagrams built in one manager share every common subgraph
+// invariants: no two nodes have the same variable and children, and no node
+//	has equal children, so two diagrams of one manager are equal functions
+//	exactly when their roots are equal; ids 0 and 1 are the constants false
+//	and true; a manager is not thread safe
+// data members:
+//	'nodes' holds every node, freed ids are reused through 'free_ids'
+//	'unique' holds one table per variable from the children of a node to its
+//	id, so a variable's nodes can be found when levels are swapped
+//	'cache' is a lossy direct mapped cache of operation results
+//	'names' holds the variable names, 'ids' maps a name back to its variable
+//	'level' holds the position of each variable in the order, 'order' holds
+//	the variable at each level
+class bddManager
+{
+public:
+		/* prerequisites */
+
+	// the operations the cache remembers
+	enum class op : std::uint32_t { NONE, AND, OR, XOR, NOT };
+
+	// how the variables of a new expression are ordered
+	// APPEARANCE follows a depth first walk of the expression, FREQUENCY puts
+	//	the most used variables on top, SIFT sifts after building
+	enum class ordering { APPEARANCE, FREQUENCY, SIFT };
+
+	// one node, the function is var ? hi : lo, 'refs' counts the parents and
+	//	the diagrams that hold it
+	struct node
+	{
+		std::uint32_t var;
+		std::uint32_t lo;
+		std::uint32_t hi;
+		std::uint32_t refs;
+	};
+
+	// the variable of the constants, below every level
+	static constexpr std::uint32_t LEAF = UINT32_MAX;
+
+private:
+		/* prerequisites */
+
+	struct entry
+	{
+		op code;
+		std::uint32_t f;
+		std::uint32_t g;
+		std::uint32_t r;
+	};
+
+	static constexpr std::size_t CACHE = std::size_t(1) << 16;
+
+		/* member variables */
+
+	std::vector<node> nodes;
+
+	std::vector<std::uint32_t> free_ids;
+
+	std::vector<std::unordered_map<std::uint64_t, std::uint32_t>> unique;
+
+	std::vector<entry> cache;
+
+	std::vector<std::string> names;
+
+	std::unordered_map<std::string, std::uint32_t> ids;
+
+	std::vector<std::uint32_t> level;
+
+	std::vector<std::uint32_t> order;
+
+		/* member functions */
+
+	// purpose: finds the level of a node
+	// requires: a node id
+	// returns: the level of its variable, the number of variables for the
+	//	constants
+	std::uint32_t level_of(std::uint32_t f) const
+	{
+		return (f < 2) ? static_cast<std::uint32_t>(order.size())
+			: level[nodes[f].var];
+	}
+
+	// purpose: drops a reference, freeing the node when it was the last
+	// requires: a node id
+	// returns: nothing
+	void release(std::uint32_t);
+
+	// purpose: exchanges two adjacent levels in place, every node keeps its
+	//	id and its function
+	// requires: the upper of the two levels
+	// returns: nothing
+	void swap(std::uint32_t);
+
+	// purpose: finds a cached operation
+	// requires: the operation and its operands
+	// returns: the slot of the cache the operation belongs in
+	entry& slot(op, std::uint32_t, std::uint32_t);
+
+public:
+
+		/* constructors */
+
+	// default constructor
+	// creates a manager with no variables
+	bddManager();
+
+		/* member functions */
+
+	// purpose: finds a variable, creating it below every other on first use
+	// requires: a name
+	// returns: the index of the variable
+	std::uint32_t variable(const std::string&);
+
+	// purpose: finds the variables
+	// requires: nothing
+	// returns: the names, by index
+	const std::vector<std::string>& variables() const { return names; }
+
+	// purpose: finds the variable order
+	// requires: nothing
+	// returns: the variable indices from the top level down
+	const std::vector<std::uint32_t>& variable_order() const { return order; }
+
+	// purpose: finds a node
+	// requires: a node id
+	// returns: the node
+	const node& at(std::uint32_t f) const { return nodes[f]; }
+
+	// purpose: finds or creates the node var ? hi : lo
+	// requires: a variable and the two children, both below the variable
+	// returns: a node id
+	std::uint32_t make(std::uint32_t, std::uint32_t, std::uint32_t);
+
+	// purpose: combines two diagrams
+	// requires: AND, OR or XOR and two node ids
+	// returns: a node id
+	std::uint32_t apply(op, std::uint32_t, std::uint32_t);
+
+	// purpose: negates a diagram
+	// requires: a node id
+	// returns: a node id
+	std::uint32_t negate(std::uint32_t);
+
+	// purpose: counts the satisfying assignments of every variable
+	// requires: a node id
+	// returns: a long double, exact below 2^64
+	long double count(std::uint32_t) const;
+
+	// purpose: counts the nodes reachable from a root
+	// requires: a node id
+	// returns: a size, the constants included
+	std::size_t size(std::uint32_t) const;
+
+	// purpose: counts the live nodes
+	// requires: nothing
+	// returns: a size
+	std::size_t size() const { return nodes.size() - free_ids.size() - 2; }
+
+	// purpose: takes a reference on a node
+	// requires: a node id
+	// returns: nothing
+	void acquire(std::uint32_t f) { nodes[f].refs++; }
+
+	// purpose: drops a reference on a node, it is freed by the next gc()
+	// requires: a node id
+	// returns: nothing
+	void drop(std::uint32_t f) { nodes[f].refs--; }
+
+	// purpose: frees every node no diagram holds
+	// requires: nothing
+	// returns: nothing
+	void gc();
+
+	// purpose: reorders the variables with Rudell's sifting, each variable
+	//	in turn is moved through every level and left where the manager was
+	//	smallest
+	// requires: the growth at which a sweep gives up, by default 1.2
+	// returns: nothing
+	void sift(double = 1.2);
+
+};
+
+
+/* bdd */
+
+// purpose: a boolean function held as a diagram of a bddManager
+// invariants: the diagram holds a reference on its root for its lifetime
+// data members:
+//	'mgr' is the manager of the nodes
+//	'root' is the id of the top node
+class bdd
+{
+private:
+		/* member variables */
+
+	std::shared_ptr<bddManager> mgr;
+
+	std::uint32_t root = 0;
+
+public:
+
+		/* constructors */
+
+	// default constructor
+	// the constant false, without a manager
+	bdd() {}
+
+	// parametrized constructor
+	// takes a manager and a node id, and references the node
+	bdd(std::shared_ptr<bddManager>, std::uint32_t);
+
+	// copy constructor
+	bdd(const bdd&);
+
+	// destructor
+	~bdd() { if (mgr) mgr->drop(root); }
+
+		/* member functions */
+
+	// purpose: finds the manager
+	// requires: nothing
+	// returns: the manager, null for a default diagram
+	const std::shared_ptr<bddManager>& manager() const { return mgr; }
+
+	// purpose: finds the root
+	// requires: nothing
+	// returns: a node id
+	std::uint32_t id() const { return root; }
+
+	// purpose: evaluates the function by walking one path
+	// requires: a value for every variable of the manager, by index
+	// returns: a bool
+	bool evaluate(const std::vector<bool>&) const;
+
+	// purpose: evaluates the function by walking one path
+	// requires: a map from each variable name on the path to its value
+	// returns: a bool
+	bool evaluate(const std::map<std::string, bool>&) const;
+
+	// purpose: counts the satisfying assignments of the manager's variables
+	// requires: nothing
+	// returns: a long double
+	long double count() const { return mgr ? mgr->count(root) : 0; }
+
+	// purpose: counts the nodes of the diagram
+	// requires: nothing
+	// returns: a size, the constants included
+	std::size_t size() const { return mgr ? mgr->size(root) : 1; }
+
+		/* operators */
+
+	// purpose: checks whether two diagrams of one manager are equivalent
+	// requires: a diagram
+	// returns: a bool, in constant time
+	bool operator==(const bdd& other) const
+	{ return mgr == other.mgr && root == other.root; }
+
+	// purpose: combines two diagrams of one manager
+	// requires: a diagram
+	// returns: a new diagram
+	bdd operator&(const bdd&) const;
+
+	bdd operator|(const bdd&) const;
+
+	bdd operator^(const bdd&) const;
+
+	// purpose: negates the diagram
+	// requires: nothing
+	// returns: a new diagram
+	bdd operator~() const;
+
+	// purpose: assigns a diagram to this one
+	// requires: a diagram
+	// returns: this diagram
+	bdd& operator=(const bdd&);
+
+};
+
+
+		/* bddManager */
+
+	/* constructors */
+
+bddManager::bddManager() : cache(CACHE, entry{ op::NONE, 0, 0, 0 })
+{
+	nodes.push_back(node{ LEAF, 0, 0, 1 });
+	nodes.push_back(node{ LEAF, 1, 1, 1 });
+}
+
+
+	/* methods */
+
+/* private */
+
+void bddManager::release(std::uint32_t f)
+{
+	if (f < 2 || --nodes[f].refs != 0)
+		return;
+
+	const node n = nodes[f];
+	unique[n.var].erase((std::uint64_t(n.lo) << 32) | n.hi);
+	nodes[f].var = LEAF;
+	free_ids.push_back(f);
+	release(n.lo);
+	release(n.hi);
+}
+
+// an x node over y nodes f = x ? (y ? f11 : f10) : (y ? f01 : f00) becomes
+//	the y node y ? (x ? f11 : f01) : (x ? f10 : f00), rewritten in its own
+//	slot so every parent and diagram still sees the same function
+void bddManager::swap(std::uint32_t i)
+{
+	const std::uint32_t x = order[i], y = order[i + 1];
+	std::vector<std::uint32_t> upper;
+	std::uint32_t f00, f01, f10, f11, lo, hi;
+
+	upper.reserve(unique[x].size());
+	for (const auto& [key, f] : unique[x])
+		upper.push_back(f);
+
+	for (std::uint32_t f : upper)
+	{
+		const node n = nodes[f];
+		const bool lo_y = n.lo > 1 && nodes[n.lo].var == y;
+		const bool hi_y = n.hi > 1 && nodes[n.hi].var == y;
+
+		if (!lo_y && !hi_y)
+			continue;
+
+		f00 = lo_y ? nodes[n.lo].lo : n.lo;
+		f01 = lo_y ? nodes[n.lo].hi : n.lo;
+		f10 = hi_y ? nodes[n.hi].lo : n.hi;
+		f11 = hi_y ? nodes[n.hi].hi : n.hi;
+
+		unique[x].erase((std::uint64_t(n.lo) << 32) | n.hi);
+
+		// x is now below y, so these are built on the lower level
+		lo = make(x, f00, f10);
+		acquire(lo);
+		hi = make(x, f01, f11);
+		acquire(hi);
+
+		nodes[f].var = y;
+		nodes[f].lo = lo;
+		nodes[f].hi = hi;
+		unique[y].emplace((std::uint64_t(lo) << 32) | hi, f);
+
+		release(n.lo);
+		release(n.hi);
+	}
+
+	order[i] = y;
+	order[i + 1] = x;
+	level[y] = i;
+	level[x] = i + 1;
+}
+
+bddManager::entry& bddManager::slot(op code, std::uint32_t f, std::uint32_t g)
+{
+	std::uint64_t h = (std::uint64_t(f) * 0x9E3779B97F4A7C15ull)
+		^ (std::uint64_t(g) * 0xC2B2AE3D27D4EB4Full)
+		^ static_cast<std::uint64_t>(code);
+
+	return cache[(h ^ (h >> 29)) & (CACHE - 1)];
+}
+
+/* public */
+
+std::uint32_t bddManager::variable(const std::string& name)
+{
+	auto found = ids.find(name);
+	std::uint32_t v;
+
+	if (found != ids.end())
+		return found->second;
+
+	v = static_cast<std::uint32_t>(names.size());
+	names.push_back(name);
+	ids.emplace(name, v);
+	level.push_back(static_cast<std::uint32_t>(order.size()));
+	order.push_back(v);
+	unique.emplace_back();
+
+	return v;
+}
+
+std::uint32_t bddManager::make(std::uint32_t var, std::uint32_t lo,
+	std::uint32_t hi)
+{
+	const std::uint64_t key = (std::uint64_t(lo) << 32) | hi;
+	std::uint32_t f;
+
+	if (lo == hi)
+		return lo;
+
+	auto found = unique[var].find(key);
+	if (found != unique[var].end())
+		return found->second;
+
+	if (free_ids.empty())
+	{
+		f = static_cast<std::uint32_t>(nodes.size());
+		nodes.push_back(node{ var, lo, hi, 0 });
+	}
+	else
+	{
+		f = free_ids.back();
+		free_ids.pop_back();
+		nodes[f] = node{ var, lo, hi, 0 };
+	}
+
+	acquire(lo);
+	acquire(hi);
+	unique[var].emplace(key, f);
+
+	return f;
+}
+
+// Shannon expansion on the topmost variable of the two operands, the
+//	constant cases end the recursion before the cache is consulted
+std::uint32_t bddManager::apply(op code, std::uint32_t f, std::uint32_t g)
+{
+	std::uint32_t lf, lg, top, f0, f1, g0, g1, r;
+
+	switch (code)
+	{
+	case op::AND:
+		if (f == 0 || g == 0) return 0;
+		if (f == 1) return g;
+		if (g == 1 || f == g) return f;
+		break;
+	case op::OR:
+		if (f == 1 || g == 1) return 1;
+		if (f == 0) return g;
+		if (g == 0 || f == g) return f;
+		break;
+	default:
+		if (f == g) return 0;
+		if (f == 0) return g;
+		if (g == 0) return f;
+		if (f == 1) return negate(g);
+		if (g == 1) return negate(f);
+		break;
+	}
+
+	// every operation is commutative, so one order is cached
+	if (f > g)
+		std::swap(f, g);
+
+	entry& hit = slot(code, f, g);
+	if (hit.code == code && hit.f == f && hit.g == g)
+		return hit.r;
+
+	lf = level_of(f);
+	lg = level_of(g);
+	top = std::min(lf, lg);
+
+	f0 = (lf == top) ? nodes[f].lo : f;
+	f1 = (lf == top) ? nodes[f].hi : f;
+	g0 = (lg == top) ? nodes[g].lo : g;
+	g1 = (lg == top) ? nodes[g].hi : g;
+
+	r = make(order[top], apply(code, f0, g0), apply(code, f1, g1));
+
+	// the recursion may have evicted the slot, so it is looked up again
+	slot(code, f, g) = entry{ code, f, g, r };
+
+	return r;
+}
+
+std::uint32_t bddManager::negate(std::uint32_t f)
+{
+	std::uint32_t r;
+
+	if (f < 2)
+		return 1 - f;
+
+	entry& hit = slot(op::NOT, f, f);
+	if (hit.code == op::NOT && hit.f == f)
+		return hit.r;
+
+	r = make(nodes[f].var, negate(nodes[f].lo), negate(nodes[f].hi));
+	slot(op::NOT, f, f) = entry{ op::NOT, f, f, r };
+
+	return r;
+}
+
+// every skipped level doubles the count of the edge that skips it
+long double bddManager::count(std::uint32_t f) const
+{
+	std::unordered_map<std::uint32_t, long double> memo;
+
+	auto walk = [&](auto&& self, std::uint32_t g) -> long double
+		{
+			if (g < 2)
+				return g;
+
+			auto found = memo.find(g);
+			if (found != memo.end())
+				return found->second;
+
+			const node& n = nodes[g];
+			const int l = static_cast<int>(level_of(g));
+			const long double c
+				= std::ldexp(self(self, n.lo), static_cast<int>(level_of(n.lo)) - l - 1)
+				+ std::ldexp(self(self, n.hi), static_cast<int>(level_of(n.hi)) - l - 1);
+
+			memo.emplace(g, c);
+			return c;
+		};
+
+	return std::ldexp(walk(walk, f), static_cast<int>(level_of(f)));
+}
+
+std::size_t bddManager::size(std::uint32_t f) const
+{
+	std::vector<std::uint32_t> todo{ f };
+	std::unordered_set<std::uint32_t> seen{ f };
+	std::uint32_t g;
+
+	while (!todo.empty())
+	{
+		g = todo.back();
+		todo.pop_back();
+		if (g < 2)
+			continue;
+		for (std::uint32_t c : { nodes[g].lo, nodes[g].hi })
+			if (seen.insert(c).second)
+				todo.push_back(c);
+	}
+
+	return seen.size();
+}
+
+// cached results may name freed nodes, so the cache goes with them
+void bddManager::gc()
+{
+	std::vector<std::uint32_t> dead;
+
+	for (std::uint32_t f = 2; f < nodes.size(); f++)
+		if (nodes[f].refs == 0 && nodes[f].var != LEAF)
+			dead.push_back(f);
+
+	// a node freed by an earlier cascade is already a leaf
+	for (std::uint32_t f : dead)
+	{
+		if (nodes[f].refs != 0 || nodes[f].var == LEAF)
+			continue;
+		nodes[f].refs = 1;
+		release(f);
+	}
+
+	std::fill(cache.begin(), cache.end(), entry{ op::NONE, 0, 0, 0 });
+}
+
+// the variables with the most nodes move first, a sweep stops early once
+//	the manager grows past the limit
+void bddManager::sift(double growth)
+{
+	const std::uint32_t n = static_cast<std::uint32_t>(order.size());
+	std::vector<std::uint32_t> vars(n);
+	std::size_t best;
+	std::uint32_t at, best_at;
+
+	gc();
+
+	for (std::uint32_t v = 0; v < n; v++)
+		vars[v] = v;
+	std::sort(vars.begin(), vars.end(), [this](std::uint32_t a, std::uint32_t b)
+		{
+			return unique[a].size() > unique[b].size();
+		});
+
+	for (std::uint32_t v : vars)
+	{
+		at = best_at = level[v];
+		best = size();
+
+		while (at + 1 < n && size() <= growth * best)
+		{
+			swap(at++);
+			if (size() < best) { best = size(); best_at = at; }
+		}
+		while (at > 0 && (at > best_at || size() <= growth * best))
+		{
+			swap(--at);
+			if (size() < best) { best = size(); best_at = at; }
+		}
+		while (at < best_at)
+			swap(at++);
+	}
+
+	std::fill(cache.begin(), cache.end(), entry{ op::NONE, 0, 0, 0 });
+}
+
+
+		/* bdd */
+
+	/* constructors */
+
+bdd::bdd(std::shared_ptr<bddManager> m, std::uint32_t f)
+	: mgr(std::move(m)), root(f)
+{
+	if (mgr)
+		mgr->acquire(root);
+}
+
+bdd::bdd(const bdd& other) : mgr(other.mgr), root(other.root)
+{
+	if (mgr)
+		mgr->acquire(root);
+}
+
+
+	/* methods */
+
+bool bdd::evaluate(const std::vector<bool>& values) const
+{
+	std::uint32_t f = root;
+
+	while (f > 1)
+	{
+		const bddManager::node& n = mgr->at(f);
+		f = values.at(n.var) ? n.hi : n.lo;
+	}
+
+	return f == 1;
+}
+
+bool bdd::evaluate(const std::map<std::string, bool>& values) const
+{
+	std::uint32_t f = root;
+
+	while (f > 1)
+	{
+		const bddManager::node& n = mgr->at(f);
+		auto found = values.find(mgr->variables()[n.var]);
+
+		if (found == values.end())
+			throw std::invalid_argument(mgr->variables()[n.var]
+				+ " is not bound\n");
+		f = found->second ? n.hi : n.lo;
+	}
+
+	return f == 1;
+}
+
+
+	/* operators */
+
+bdd bdd::operator&(const bdd& other) const
+{
+	if (mgr != other.mgr)
+		throw std::invalid_argument("Diagrams must share a manager\n");
+	return bdd(mgr, mgr->apply(bddManager::op::AND, root, other.root));
+}
+
+bdd bdd::operator|(const bdd& other) const
+{
+	if (mgr != other.mgr)
+		throw std::invalid_argument("Diagrams must share a manager\n");
+	return bdd(mgr, mgr->apply(bddManager::op::OR, root, other.root));
+}
+
+bdd bdd::operator^(const bdd& other) const
+{
+	if (mgr != other.mgr)
+		throw std::invalid_argument("Diagrams must share a manager\n");
+	return bdd(mgr, mgr->apply(bddManager::op::XOR, root, other.root));
+}
+
+bdd bdd::operator~() const
+{
+	if (!mgr)
+		throw std::invalid_argument("Diagram has no manager\n");
+	return bdd(mgr, mgr->negate(root));
+}
+
+bdd& bdd::operator=(const bdd& other)
+{
+	if (this != &other)
+	{
+		if (other.mgr)
+			other.mgr->acquire(other.root);
+		if (mgr)
+			mgr->drop(root);
+		mgr = other.mgr;
+		root = other.root;
+	}
+
+	return *this;
+}
@@ -1,57 +1,190 @@
 #pragma once
 
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "bdd.hpp"
+#include "cover.hpp"
+#include "dag.hpp"
 #include "expression.hpp"
+#include "sat.hpp"
 
 
+class boolCorpus;
+
 /* boolExp */
 
 // purpose: represents a boolean expression
 // invariants: expression must be boolean and uses operations &, |, ^, or ~
+//	on the bits 0 and 1 and on variables; 'program' is always the compiled
+//	form of 'expression'
 // data members:
-//	'result' is a pointer to the expression's result
+//	'result' holds the expression's result once it has been evaluated
 //	'expression' is a string that represents the actual expression
+//	'program' is the expression compiled to a flat list of steps, run on a
+//	stack of 'depth' words
+//	'names' holds the variables in order of first use, variable j is bit j
+//	of an assignment's index in a truth table
+//	'parent' holds the step that consumes each step, NONE for the last, and
+//	'left' the first operand of each binary step, the second is the step
+//	just before it; 'readers' holds the VARIABLE steps of each variable
+//	'bindings' holds the value bound to each variable, -1 while unbound,
+//	and 'values' the value of every step once all of them are bound, so a
+//	change only recomputes the steps above it
+//	'profile' holds what evaluate_lazy has measured of the operands of each
+//	AND and OR step, so it can try the cheaper, more decisive one first
 class boolExp : public Expression<bool>
 {
+	// a corpus compiles its lines with the grammar of boolExp
+	friend class boolCorpus;
+
+public:
+		/* prerequisites */
+
+	// one step of a compiled expression, 'arg' indexes the variables for
+	//	VARIABLE
+	struct step
+	{
+		enum class op : std::uint8_t { ZERO, ONE, VARIABLE, NOT, AND, OR, XOR };
+
+		op code;
+		std::uint32_t arg;
+
+		// purpose: counts the operands of the step
+		// requires: nothing
+		// returns: 0, 1 or 2
+		unsigned arity() const
+		{
+			return (code == op::NOT) ? 1 : (code > op::NOT) ? 2 : 0;
+		}
+
+		// purpose: checks whether the operands can be swapped
+		// requires: nothing
+		// returns: a bool
+		bool commutative() const { return code > op::NOT; }
+	};
+
+	// an expression compiled while the program is, 'program' is its steps,
+	//	'names' its variables and 'postfix' its text in postfix notation
+	template <std::size_t STEPS, std::size_t NAMES, std::size_t TEXT>
+	struct image
+	{
+		std::array<step, STEPS> program;
+		std::array<std::string_view, NAMES> names;
+		std::array<char, TEXT> postfix;
+	};
+
 protected:
 
+	/* member variables */
+
+	// the operators of a boolean expression, in order of precedence
+	static constexpr opInfo OPERATORS[] = {
+		{ '|', '|', 2, 1, false, vmOp::OR },
+		{ '&', '&', 2, 2, false, vmOp::AND },
+		{ '^', '^', 2, 3, false, vmOp::XOR },
+		{ '~', '~', 1, 4, false, vmOp::NOT } };
+
+	// the literals are the bits 0 and 1, and variables are allowed
+	static constexpr grammar SYNTAX = { OPERATORS, {}, true, true };
+
+	static_assert(SYNTAX.consistent<bool>(), "Every kernel of a boolean"
+		" operator must take as many operands as the operator, and bits"
+		" must have it");
+
+	std::vector<step> program;
+
+	std::vector<string> names;
+
+	std::size_t depth = 0;
+
+	static constexpr std::uint32_t NONE = UINT32_MAX;
+
+	std::vector<std::uint32_t> parent;
+
+	std::vector<std::uint32_t> left;
+
+	std::vector<std::vector<std::uint32_t>> readers;
+
+	std::vector<signed char> bindings;
+
+	std::vector<char> values;
+
+	// what has been measured of the operands of one AND or OR step, operand
+	//	0 is the left one; 'cost' is the time spent in the predicates while
+	//	evaluating it and 'hits' counts the evaluations that decided the step
+	struct measure
+	{
+		double cost[2];
+		double samples[2];
+		double hits[2];
+	};
+
+	std::vector<measure> profile;
+
 	/* member functions */
 
-	// purpose: evaluates a boolean expression with two inputs
-	// requires: an array of two bools to evaluate,
-	//	and a char i.e. the operator
-	// returns: a bool
-	bool eval_simple_exp
-	(const std::array<bool, 2>&, const char&) const override;
-
-	// purpose: evaluates the top two bools on a stack with a given operation
-	// requires: a stack of bools and a char that represents the operation
-	// returns: nothing, but adjusts the stack
-	void getAndEval(stack<bool>&, const char&) override;
-
-		// can be brought to parent
-	// purpose: converts an expression from infix to postfix format
-	// requires: a string i.e. the expression in infix format
-	// returns: a string i.e. the expression in postfix format
-	string infix_to_postfix(const string&) override;
-
-		// can be brought to parent
-	// purpose: converts an expression from postfix to infix format
-	// requires: a string i.e. the expression in postfix format
-	// returns: a string i.e. the expression in infix format
-	string postfix_to_infix(const string&) override;
-
-		// can be brought to parent
-	// purpose: converts an expression from postfix to prefix format
-	// requires: a string i.e. the expression in postfix format
-	// returns: a string i.e. the expression in prefix format
-	string postfix_to_prefix(const string&) override;
-
-		// can be brought to parent
-	// purpose: converts an expression from prefix to postfix format
-	// requires: a string i.e. the expression in prefix format
-	// returns: a string i.e. the expression in postfix format
-	string prefix_to_postfix(const string&) override;
+	// purpose: finds the step of a token that is not a variable
+	// requires: the source the token refers to, and the token
+	// returns: the opcode
+	static constexpr step::op opcode(std::string_view, const exprToken&);
+
+	// purpose: stops the compilation of a malformed literal, it is not
+	//	constexpr so calling it while the program compiles is the error
+	// requires: the error and the literal
+	// returns: nothing, but throws a parseError if ever called at run time
+	static void malformed(const exprError&, std::string_view);
+
+	// purpose: parses a literal while the program compiles and sizes its
+	//	image
+	// requires: the literal and the buffer for its tokens
+	// returns: the number of steps, variables and characters of postfix
+	static constexpr std::array<std::size_t, 3> extent(std::string_view,
+		std::vector<exprToken>&);
+
+	// purpose: compiles 'expression' into 'program'
+	// requires: nothing
+	// returns: nothing, but replaces the program and names
+	void compile();
+
+	// purpose: compiles parsed tokens into 'program', leaving 'expression'
+	//	to the caller
+	// requires: the source the tokens refer to, and the tokens
+	// returns: nothing, but replaces the program and names
+	void compile(std::string_view, const std::vector<exprToken>&);
+
+	// purpose: finds the links between the steps and the depth of the stack
+	// requires: nothing
+	// returns: nothing, but replaces 'parent', 'left', 'readers' and 'depth',
+	//	forgets the profile and recompiles the program for 'vm'
+	void link();
+
+	// purpose: rewrites 'expression' from the program
+	// requires: nothing
+	// returns: nothing
+	void write();
+
+	// purpose: recomputes one step from its operands
+	// requires: the index of the step
+	// returns: true when its value changed
+	bool recompute(std::size_t);
+
+	// purpose: recomputes the steps above a changed step, stopping at the
+	//	first that keeps its value
+	// requires: the index of the changed step
+	// returns: nothing
+	void propagate(std::size_t);
+
+	// purpose: runs the program on K words per value, each bit of a word is
+	//	a separate assignment
+	// requires: K words per variable, variable j in words [jK, jK + K), and
+	//	K words for the result
+	// returns: nothing, but fills the result
+	template <std::size_t K>
+	void run(const std::uint64_t*, std::uint64_t*) const;
 
 public:
 
@@ -60,7 +193,7 @@ public:
 	// default constructor
 	// sets the expression to the additive identity,
 	//	and consequentially the result too
-	boolExp() { expression = "0"; }
+	boolExp() { expression = "0"; compile(); }
 
 	// parametrized constructor
 	// takes in a string i.e. an expression in infix notation
@@ -69,19 +202,186 @@ public:
 	boolExp(const string&, const string & = "infix");
 
 	// copy constructor
-	boolExp(const boolExp&);
+	// every member is copied, the cached result and values included
+	boolExp(const boolExp&) = default;
+
+	// compiled constructor
+	// takes in an expression compiled by precompile(), so nothing is parsed
+	template <std::size_t STEPS, std::size_t NAMES, std::size_t TEXT>
+	explicit boolExp(const image<STEPS, NAMES, TEXT>&);
 
 	/* member functions */
 
+	// purpose: finds the grammar of the expression
+	// requires: nothing
+	// returns: SYNTAX
+	const grammar& syntax() const override { return SYNTAX; }
+
 	// purpose: evaluates the expression
 	// requires: nothing
-	// returns: a boolean value i.e. the result
+	// returns: a boolean value i.e. the result, under the values given
+	//	through bind(), false if a variable is unbound
 	bool evaluate() override;
 
+	// purpose: evaluates the expression without throwing or writing to
+	//	std::cerr, for input where unbound variables are expected
+	// requires: the bool to set to the result, under the values given
+	//	through bind()
+	// returns: NONE, or UNBOUND with the index of the first unbound
+	//	variable, and then the bool is untouched
+	exprError try_evaluate(bool&);
+
+	// purpose: evaluates the expression with values for its variables
+	//	without throwing
+	// requires: a map from each variable name to its value, and the bool to
+	//	set to the result
+	// returns: NONE, or UNBOUND with the index of the first variable
+	//	missing from the map
+	exprError try_evaluate(const std::map<string, bool>&, bool&) const;
+
+	// purpose: binds a variable, once the expression has been evaluated
+	//	only the steps above its uses are recomputed, up to the first that
+	//	keeps its value
+	// requires: the name of a variable of the expression and its value
+	// returns: nothing
+	void bind(const string&, bool);
+
+	// purpose: binds a variable by its index, skipping the name lookup
+	// requires: the index of a variable in variables() and its value
+	// returns: nothing
+	void bind(std::size_t, bool);
+
+	// purpose: finds the first step of the subexpression that ends at a step
+	// requires: the index of a step
+	// returns: the index of the first step, so the subexpression is the
+	//	steps [subtree(i), i]
+	std::size_t subtree(std::size_t) const;
+
+	// purpose: replaces a subexpression, the steps outside it keep their
+	//	values so only the new steps and those above them are recomputed
+	// requires: the index of the step the subexpression ends at and the new
+	//	subexpression in infix notation
+	// returns: nothing, variables keep their bindings by name
+	void replace(std::size_t, const string&);
+
+	// purpose: evaluates the expression with values for its variables
+	// requires: a map from each variable name to its value
+	// returns: a boolean value i.e. the result
+	bool evaluate(const std::map<string, bool>&) const;
+
+	// purpose: evaluates the expression as a tree, asking for the value of a
+	//	variable only when it can still change the result, so & and |
+	//	short-circuit; the operands of each & and | are timed as they run
+	//	and the one with the least cost per decisive answer goes first, so
+	//	the order adapts to the predicates over many calls
+	// requires: a predicate bool(std::size_t) giving the value of variable
+	//	j of variables(), which must not depend on the order it is asked in
+	// returns: a boolean value i.e. the result
+	template <class Predicate>
+	bool evaluate_lazy(Predicate&&);
+
+	// purpose: evaluates 64K assignments at once, e.g. K = 4 fills one 256
+	//	bit AVX2 register per value
+	// requires: K words per variable in the order of variables(), variable j
+	//	in words [jK, jK + K), and K words for the results
+	// returns: nothing, but sets bit b of result word k to the value under
+	//	the assignment made of bit b of word k of every variable
+	template <std::size_t K = 1>
+	void evaluate_lanes(const std::uint64_t* vars, std::uint64_t* out) const
+	{ run<K>(vars, out); }
+
+	// purpose: evaluates every assignment of the variables
+	// requires: nothing, but there can be at most 32 variables
+	// returns: a bitset of 2^n bits, bit i is the value when variable j is
+	//	bit j of i
+	std::vector<std::uint64_t> truth_table() const;
+
+	// purpose: compiles the expression into a binary decision diagram
+	// requires: the manager to build in, a new one by default, and how the
+	//	variables it does not know yet are ordered, in order of appearance by
+	//	default
+	// returns: a diagram, equal to the diagram of any equivalent expression
+	//	built in the same manager
+	bdd to_bdd(std::shared_ptr<bddManager> = nullptr,
+		bddManager::ordering = bddManager::ordering::APPEARANCE) const;
+
+	// purpose: checks whether two expressions agree on every assignment
+	// requires: an expression
+	// returns: a bool
+	bool equivalent(const boolExp&) const;
+
+	// purpose: counts the assignments of the variables that make the
+	//	expression true
+	// requires: nothing
+	// returns: a long double, exact below 2^64
+	long double count_models() const { return to_bdd().count(); }
+
+	// purpose: encodes the expression as clauses with the Tseitin
+	//	transformation, one new variable per operator so the clauses grow
+	//	linearly with the expression
+	// requires: nothing
+	// returns: a solver whose variable j is variable j of variables(), and
+	//	whose clauses are satisfiable exactly when the expression is
+	satSolver to_cnf() const;
+
+	// purpose: checks whether some assignment makes the expression true
+	// requires: nothing
+	// returns: a bool
+	bool satisfiable() const { return to_cnf().solve(); }
+
+	// purpose: finds an assignment that makes the expression true
+	// requires: nothing
+	// returns: the value of every variable, or nothing when the expression
+	//	is unsatisfiable
+	std::optional<std::map<string, bool>> model() const;
+
+	// purpose: finds distinct assignments that make the expression true
+	// requires: the most assignments to find
+	// returns: the assignments, all of them when there are at most 'limit'
+	std::vector<std::map<string, bool>> all_models(std::size_t) const;
+
+	// purpose: adds the expression to a shared store, where its
+	//	subexpressions are held once for every expression that has them
+	// requires: a store
+	// returns: the id of the expression's root in the store
+	std::uint32_t intern(exprDag<step>& dag) const
+	{ return dag.intern(program, names); }
+
+	// purpose: evaluates many interned expressions on many assignments, each
+	//	node of the store once per 64 assignments
+	// requires: the store, the roots, 'words' words per variable of the
+	//	store, variable v in [v * words, v * words + words), the number of
+	//	words and room for 'words' words per root laid out alike
+	// returns: nothing, but sets bit b of result word k of a root to its
+	//	value under bit b of word k of every variable
+	static void evaluate_batch(const exprDag<step>&,
+		const std::vector<std::uint32_t>&, const std::uint64_t*, std::size_t,
+		std::uint64_t*);
+
+	// purpose: replaces the expression with an equivalent sum of products,
+	//	the smallest one for at most sopCover::EXACT variables and a small
+	//	one from the Espresso heuristic for up to 64
+	// requires: nothing
+	// returns: nothing, but the expression is only replaced when the sum of
+	//	products compiles to fewer steps, and then its variables are those
+	//	the function depends on
+	void minimize();
+
+	// purpose: finds the variables of the expression
+	// requires: nothing
+	// returns: the names in order of first use
+	const std::vector<string>& variables() const { return names; }
+
+	// purpose: finds the compiled form of the expression
+	// requires: nothing
+	// returns: the steps, in postfix order
+	const std::vector<step>& steps() const { return program; }
+
 	// purpose: gets the expression
 	// requires: can pass in "infix", "prefix", or "postfix" to get the
 	//	expression in one of those formats, by default "infix"
-	// returns: a string i.e. the expression
+	// returns: a string i.e. the expression, empty after reporting a bad
+	//	format to std::cerr
 	string getExpression(const string & = "infix");
 
 	// purpose: changes the expression to something new
@@ -90,38 +390,54 @@ public:
 	// returns: a string i.e. the expression
 	void setExpression(const string&, const string & = "infix");
 
+	// purpose: changes the expression to something new without throwing or
+	//	writing to std::cerr, for input where malformed expressions are
+	//	expected
+	// requires: the new expression and its notation, by default infix
+	// returns: NONE, or the first error with where it is in the new
+	//	expression, and then the old expression is kept
+	exprError try_set(std::string_view, notation = notation::INFIX);
+
+	// purpose: parses and compiles an infix literal while the program
+	//	compiles, a malformed one does not compile
+	// requires: the literal, as a template argument
+	// returns: its image, for the compiled constructor
+	template <exprText S>
+	static consteval auto precompile();
+
 };
 
+// purpose: a boolean expression literal, e.g. "a&(b|~c)"_bx, parsed and
+//	compiled with the program so constructing it parses nothing
+// requires: an infix expression
+// returns: the expression
+template <exprText S>
+boolExp operator""_bx()
+{
+	static constexpr auto IMAGE = boolExp::precompile<S>();
+
+	return boolExp(IMAGE);
+}
+
 
 		/* constructors */
 
 // parametrized constructor
 boolExp::boolExp(const string& xpr, const string& format)
 {
-	try
-	{
-		if (format == "infix")
-			expression = infix_to_postfix(xpr);
-		else if (format == "postfix")
-			expression = xpr;
-		else if (format == "prefix")
-			expression = prefix_to_postfix(xpr);
-		else
-			throw std::invalid_argument("Format must be 'infix', 'prefix' or"
-				"'postfix'\n");
-	}
-	catch (const std::invalid_argument& e)
-	{
-		std::cerr << e.what();
-	}
-
+	setExpression(xpr, format);
 }
 
-// copy constructor
-boolExp::boolExp(const boolExp& other)
+// compiled constructor
+// the tail of compile(), with the steps and names already made
+template <std::size_t STEPS, std::size_t NAMES, std::size_t TEXT>
+boolExp::boolExp(const image<STEPS, NAMES, TEXT>& i)
 {
-	expression = other.expression;
-	result = other.result;
+	expression.assign(i.postfix.data(), TEXT);
+	program.assign(i.program.begin(), i.program.end());
+	names.assign(i.names.begin(), i.names.end());
+	link();
+	bindings.assign(names.size(), -1);
 }
 
 
@@ -129,389 +445,943 @@ boolExp::boolExp(const boolExp& other)
 
 	/* protected */
 
-/*****************************************************************************\
-*  Good news! We can finally be bees. This isn't your world, but we can be    *
-*  bees. This is good news. You can be a bee. You'll live like a bee--a pet!  *
-*  A pet?                                                                     *
-*  A pet, Mark. This is good news! You'll live for thirty years!              *
-*  This is insane!                                                            *
-\*****************************************************************************/
-// the code does not work without the above comment
-// evaluate a simple boolean expression
-bool boolExp::eval_simple_exp
-(const std::array<bool, 2>& bee, const char& be) const
+constexpr boolExp::step::op boolExp::opcode(std::string_view src,
+	const exprToken& tok)
 {
-	try
+	switch (tok.type)
 	{
-		// which be is it
-		switch (be)
-		{
-			// if the be is &
-			// get 2 bees and and them
-		case '&': return bee[0] && bee[1]; break;
-			// if the be is |
-			// get 2 bees and or them
-		case '|': return bee[0] || bee[1]; break;
-			// if the be is ^
-			// get 2 bees and xor them
-		case '^': return bee[0] && !bee[1] || bee[1] && !bee[0]; break;
-		default:
-			throw std::invalid_argument
-			("Operation must be '&', '|', or '^'\n");
-			break;
-		}
-
+	case exprToken::kind::VALUE:
+		return (src[tok.pos] == '1') ? step::op::ONE : step::op::ZERO;
+	case exprToken::kind::NAME: return step::op::VARIABLE;
+	case exprToken::kind::UNARY: return step::op::NOT;
+	default:
+		return (tok.code == '&') ? step::op::AND
+			: (tok.code == '|') ? step::op::OR : step::op::XOR;
 	}
-	catch (const std::invalid_argument& e)
+}
+
+void boolExp::malformed(const exprError& e, std::string_view src)
+{
+	throw parseError(exprParser::describe(e, src), e.pos);
+}
+
+// the shunting yard is the one setExpression runs, in a constant
+//	expression, so a literal is accepted exactly when the text would be
+constexpr std::array<std::size_t, 3> boolExp::extent(std::string_view src,
+	std::vector<exprToken>& tokens)
+{
+	const exprError e = exprParser::try_parse(src, SYNTAX, notation::INFIX,
+		tokens);
+	std::array<std::size_t, 3> size{ tokens.size(), 0, 0 };
+
+	if (e)
+		malformed(e, src);
+
+	for (std::size_t i = 0; i < tokens.size(); i++)
 	{
-		std::cerr << e.what();
-		return bee[0];
+		bool seen = false;
+		for (std::size_t j = 0; j < i && !seen; j++)
+			seen = tokens[j].type == exprToken::kind::NAME
+				&& src.substr(tokens[j].pos, tokens[j].len)
+				== src.substr(tokens[i].pos, tokens[i].len);
+		if (tokens[i].type == exprToken::kind::NAME && !seen)
+			size[1]++;
+		size[2] += tokens[i].len + (i > 0);
 	}
 
+	return size;
+}
+
+void boolExp::compile()
+{
+	compile(expression, exprParser::parse(expression, SYNTAX,
+		notation::POSTFIX));
 }
 
-// Dijkstra's Shunting Yard Algorithm
-// https://mathcenter.oxford.emory.edu/site/cs171/shuntingYardAlgorithm/
-string boolExp::infix_to_postfix(const string& infix)
+void boolExp::compile(std::string_view src,
+	const std::vector<exprToken>& tokens)
 {
-	char symbol;
-	stack<char> ops;
-	string buffer = infix;
-	string postfix = "";
+	std::vector<step> steps;
+	std::vector<string> vars;
+	std::uint32_t arg;
+	step::op code;
+
+	steps.reserve(tokens.size());
 
-	try
+	for (const exprToken& tok : tokens)
 	{
-		while (buffer.size() > 0) // while there is more to convert
+		arg = 0;
+
+		if (tok.type == exprToken::kind::NAME)
 		{
-			symbol = buffer.front(); // the symbol is the front of the string
+			const std::string_view name(src.substr(tok.pos, tok.len));
+			auto found = std::find(vars.begin(), vars.end(), name);
+			code = step::op::VARIABLE;
+			arg = static_cast<std::uint32_t>(found - vars.begin());
+			if (found == vars.end())
+				vars.emplace_back(name);
+		}
+		else
+			code = opcode(src, tok);
 
-			switch (symbol)
-			{
-			case '(': ops.push(symbol); break;
-			case ')':
-				// while the top of the stack isn't (
-				while (ops.top() != '(')
-				{
-					symbol = ops.top(); // get the top operator
-					postfix += symbol; // push the symbol onto the postfix
-					ops.pop(); // pop the top of the operator stack
-				}
-				ops.pop(); // get rid of the (
-				break;
-			case '0': postfix += '0'; break; // append 0 to the string
-			case '1': postfix += '1'; break; // append 1 to the string
-			case '~': ops.push(symbol); break;
-			case '^': case '&': case '|': // order of operations
-				compareAndPush(symbol, ops, postfix);
-				break;
-			case ' ': break;
-			default:
-				string errMsg = "";
-				errMsg += symbol;
-				errMsg += " is not a valid character"
-					" in a boolean expression\n";
-				throw std::invalid_argument(errMsg);
-				break;
-			}
+		steps.push_back(step{ code, arg });
+	}
+
+	program = std::move(steps);
+	names = std::move(vars);
+	link();
+	bindings.assign(names.size(), -1);
+	values.clear();
+	invalidate();
+}
+
+// the steps are replayed on a stack of indices, a binary step takes the
+//	first operand's index from under the second's
+void boolExp::link()
+{
+	// in the order of step::op
+	static constexpr vmOp OPCODE[] = { vmOp::VALUE, vmOp::VALUE,
+		vmOp::VARIABLE, vmOp::NOT, vmOp::AND, vmOp::OR, vmOp::XOR };
+
+	std::vector<std::uint32_t> stack;
+	std::size_t deepest = 0;
 
-			buffer = buffer.substr(1);
+	parent.assign(program.size(), NONE);
+	left.assign(program.size(), NONE);
+	readers.assign(names.size(), {});
+	profile.assign(program.size(), measure{});
+	vm.clear();
+
+	for (std::uint32_t i = 0; i < program.size(); i++)
+	{
+		if (program[i].code == step::op::ZERO
+			|| program[i].code == step::op::ONE)
+			vm.push(program[i].code == step::op::ONE);
+		else
+			vm.emit(OPCODE[static_cast<std::size_t>(program[i].code)],
+				program[i].arg);
+
+		switch (program[i].arity())
+		{
+		case 0:
+			if (program[i].code == step::op::VARIABLE)
+				readers[program[i].arg].push_back(i);
+			break;
+		case 1:
+			parent[stack.back()] = i;
+			stack.pop_back();
+			break;
+		default:
+			parent[stack.back()] = i;
+			stack.pop_back();
+			parent[stack.back()] = i;
+			left[i] = stack.back();
+			stack.pop_back();
+			break;
 		}
 
+		stack.push_back(i);
+		deepest = std::max(deepest, stack.size());
 	}
-	catch (const std::invalid_argument& e)
+
+	vm.finish();
+	depth = deepest;
+}
+
+void boolExp::write()
+{
+	static constexpr char SYMBOL[] = { '0', '1', ' ', '~', '&', '|', '^' };
+
+	expression.clear();
+	invalidate();
+
+	for (const step& s : program)
 	{
-		std::cerr << e.what();
-		return infix;
+		if (!expression.empty())
+			expression += ' ';
+		if (s.code == step::op::VARIABLE)
+			expression += names[s.arg];
+		else
+			expression += SYMBOL[static_cast<std::size_t>(s.code)];
 	}
+}
+
+bool boolExp::recompute(std::size_t i)
+{
+	const char old = values[i];
 
-	while (!ops.empty())
+	switch (program[i].code)
 	{
-		postfix += ops.top();
-		ops.pop();
+	case step::op::ZERO: values[i] = 0; break;
+	case step::op::ONE: values[i] = 1; break;
+	case step::op::VARIABLE: values[i] = bindings[program[i].arg]; break;
+	case step::op::NOT: values[i] = !values[i - 1]; break;
+	case step::op::AND: values[i] = values[left[i]] & values[i - 1]; break;
+	case step::op::OR: values[i] = values[left[i]] | values[i - 1]; break;
+	case step::op::XOR: values[i] = values[left[i]] ^ values[i - 1]; break;
 	}
 
-	return postfix;
+	return values[i] != old;
+}
+
+void boolExp::propagate(std::size_t i)
+{
+	for (std::uint32_t k = parent[i]; k != NONE && recompute(k); k = parent[k]);
 }
 
-// https://www.prepbytes.com/blog/stacks/conversion-of-postfix-expression-to-infix-expression/
-string boolExp::postfix_to_infix(const string& post)
+// every step works on K whole words, so the inner loops are plain bitwise
+//	operations over arrays that the compiler turns into vector instructions
+template <std::size_t K>
+void boolExp::run(const std::uint64_t* vars, std::uint64_t* out) const
 {
-	stack<string> inf;
-	string mini;
+	thread_local std::vector<std::uint64_t> lanes;
+	// one past the last value, so the value on top is [top - K, top)
+	std::uint64_t* top;
+	std::uint64_t* a;
 
-	for (const char& symbol : post)
+	if (program.empty())
 	{
-		mini = "";
-		switch (symbol)
+		std::fill(out, out + K, 0);
+		return;
+	}
+	if (lanes.size() < depth * K)
+		lanes.resize(depth * K);
+	top = lanes.data();
+
+	for (const step& s : program)
+	{
+		switch (s.code)
 		{
-		case '0': case '1':
-			mini += symbol;
-			inf.push(mini);
+		case step::op::ZERO:
+			for (std::size_t k = 0; k < K; k++) top[k] = 0;
+			top += K;
 			break;
-		case '&': case '|': case '^':
-			mini += inf.top();
-			inf.pop();
-
-			mini = symbol + mini;
-
-			mini = inf.top() + mini;
-			inf.pop();
-
-			mini = '(' + mini + ')';
-			inf.push(mini);
+		case step::op::ONE:
+			for (std::size_t k = 0; k < K; k++) top[k] = ~std::uint64_t(0);
+			top += K;
+			break;
+		case step::op::VARIABLE:
+			for (std::size_t k = 0; k < K; k++) top[k] = vars[s.arg * K + k];
+			top += K;
+			break;
+		case step::op::NOT:
+			a = top - K;
+			for (std::size_t k = 0; k < K; k++) a[k] = ~a[k];
 			break;
-		case '~':
-			mini = symbol;
-			mini += inf.top();
-			inf.pop();
-			inf.push(mini);
+		case step::op::AND:
+			top -= K;
+			a = top - K;
+			for (std::size_t k = 0; k < K; k++) a[k] &= top[k];
+			break;
+		case step::op::OR:
+			top -= K;
+			a = top - K;
+			for (std::size_t k = 0; k < K; k++) a[k] |= top[k];
+			break;
+		case step::op::XOR:
+			top -= K;
+			a = top - K;
+			for (std::size_t k = 0; k < K; k++) a[k] ^= top[k];
 			break;
-		default: break;
 		}
+	}
+
+	std::copy(top - K, top, out);
+}
+
+/*****************************************************************************\
+*  Good news! We can finally be bees. This isn't your world, but we can be    *
+*  bees. This is good news. You can be a bee. You'll live like a bee--a pet!  *
+*  A pet?                                                                     *
+*  A pet, Mark. This is good news! You'll live for thirty years!              *
+*  This is insane!                                                            *
+\*****************************************************************************/
+// the code does not work without the above comment
+
+
+	/* public */
+
+// evaluate the full expression
+// the message is only written here, try_evaluate never touches a stream
+bool boolExp::evaluate()
+{
+	bool value = false;
+	const exprError e = try_evaluate(value);
+
+	if (e)
+		std::cerr << names[e.pos] << " is not bound\n";
 
+	return value;
+}
+
+// the compiled program runs on single words, lane 0 is the result
+exprError boolExp::try_evaluate(bool& out)
+{
+	if (result)
+	{
+		out = *result;
+		return exprError();
 	}
 
-	if (!inf.empty())
+	// an empty expression is false
+	if (program.empty())
 	{
-		return inf.top();
+		out = false;
+		return exprError();
 	}
-	else
+
+	if (names.empty())
+	{
+		result = vm.run(nullptr);
+		out = *result;
+		return exprError();
+	}
+
+	for (std::size_t j = 0; j < names.size(); j++)
+		if (bindings[j] < 0)
+			return exprError{ exprError::kind::UNBOUND,
+				static_cast<std::uint32_t>(j) };
+
+	// every step keeps its value so later changes are incremental
+	values.assign(program.size(), 0);
+	for (std::size_t i = 0; i < program.size(); i++)
+		recompute(i);
+	result = values.back();
+	out = *result;
+
+	return exprError();
+}
+
+bool boolExp::evaluate(const std::map<string, bool>& bindings) const
+{
+	bool value = false;
+	const exprError e = try_evaluate(bindings, value);
+
+	if (e)
+		throw std::invalid_argument(names[e.pos] + " is not bound\n");
+
+	return value;
+}
+
+exprError boolExp::try_evaluate(const std::map<string, bool>& bindings,
+	bool& out) const
+{
+	std::unique_ptr<bool[]> vars(new bool[names.size()]);
+
+	for (std::size_t i = 0; i < names.size(); i++)
 	{
-		return "";
+		auto found = bindings.find(names[i]);
+		if (found == bindings.end())
+			return exprError{ exprError::kind::UNBOUND,
+				static_cast<std::uint32_t>(i) };
+		vars[i] = found->second;
 	}
 
+	out = vm.run(vars.get());
+
+	return exprError();
 }
 
-// https://www.prepbytes.com/blog/stacks/postfix-to-prefix-conversion/
-string boolExp::postfix_to_prefix(const string& post)
+// an explicit stack of frames walks the tree the links describe, the right
+//	operand of a step is the step just before it; an operand's cost is the
+//	predicate time spent under it, read off a running total, and it is
+//	ranked by its cost per decisive answer, one that has never run going
+//	first so both get measured; the measures are halved every 4096 samples
+//	so the order follows predicates whose cost or outcome drifts
+template <class Predicate>
+bool boolExp::evaluate_lazy(Predicate&& value)
 {
-	stack<string> pre;
-	string mini;
+	typedef std::chrono::steady_clock clock;
 
-	for (const char& symbol : post)
+	struct frame
 	{
-		mini = "";
-		switch (symbol)
+		std::uint32_t at;
+		std::uint8_t stage;
+		std::uint8_t first;
+		bool held;
+		double start;
+	};
+
+	thread_local std::vector<frame> frames;
+	double spent = 0;
+	bool last = false;
+
+	auto visit = [](std::uint32_t at) { frames.push_back(frame{ at, 0, 0,
+		false, 0 }); };
+
+	auto rank = [](const measure& m, int k)
 		{
-		case '0': case '1':
-			mini += symbol;
-			// push it onto the stack
-			pre.push(mini);
+			return (m.samples[k] == 0) ? 0
+				: (m.cost[k] + m.samples[k]) / (m.hits[k] + 0.5);
+		};
+
+	auto record = [](measure& m, int k, double cost, bool hit)
+		{
+			m.cost[k] += cost;
+			m.samples[k]++;
+			m.hits[k] += hit;
+			if (m.samples[0] + m.samples[1] > 4096)
+				for (int i = 0; i < 2; i++)
+				{
+					m.cost[i] /= 2;
+					m.samples[i] /= 2;
+					m.hits[i] /= 2;
+				}
+		};
+
+	if (program.empty())
+		return false;
+
+	frames.clear();
+	visit(static_cast<std::uint32_t>(program.size() - 1));
+
+	while (!frames.empty())
+	{
+		frame& f = frames.back();
+		const std::uint32_t at = f.at;
+		const step s = program[at];
+		// the value of an operand that decides the step on its own
+		const bool decisive = (s.code == step::op::OR);
+
+		switch (s.code)
+		{
+		case step::op::ZERO: last = false; frames.pop_back(); break;
+		case step::op::ONE: last = true; frames.pop_back(); break;
+		case step::op::VARIABLE:
+		{
+			const clock::time_point t = clock::now();
+			last = value(static_cast<std::size_t>(s.arg));
+			spent += std::chrono::duration<double, std::nano>(clock::now()
+				- t).count();
+			frames.pop_back();
 			break;
-		case '&': case '|': case '^':
-			for (int i = 0; i < 2; i++)
+		}
+		case step::op::NOT:
+			if (f.stage++ == 0)
+				visit(at - 1);
+			else
 			{
-				mini = pre.top() + mini;
-				pre.pop();
+				last = !last;
+				frames.pop_back();
 			}
-			mini = symbol + mini;
-			pre.push(mini);
 			break;
-		case '~':
-			mini += symbol;
-			mini += pre.top();
-			pre.pop();
-			pre.push(mini);
+		case step::op::XOR:
+			if (f.stage == 0)
+			{
+				f.stage = 1;
+				visit(left[at]);
+			}
+			else if (f.stage == 1)
+			{
+				f.held = last;
+				f.stage = 2;
+				visit(at - 1);
+			}
+			else
+			{
+				last = (f.held != last);
+				frames.pop_back();
+			}
 			break;
-		default: break;
-		}
+		default:
+		{
+			const std::uint32_t operand[2] = { left[at], at - 1 };
+			measure& m = profile[at];
 
+			if (f.stage == 0)
+			{
+				f.first = (rank(m, 0) <= rank(m, 1)) ? 0 : 1;
+				f.start = spent;
+				f.stage = 1;
+				visit(operand[f.first]);
+			}
+			else if (f.stage == 1)
+			{
+				record(m, f.first, spent - f.start, last == decisive);
+				if (last == decisive)
+					frames.pop_back();
+				else
+				{
+					f.start = spent;
+					f.stage = 2;
+					visit(operand[1 - f.first]);
+				}
+			}
+			else
+			{
+				record(m, 1 - f.first, spent - f.start, last == decisive);
+				frames.pop_back();
+			}
+			break;
+		}
+		}
 	}
 
-	if (!pre.empty())
+	return last;
+}
+
+// the uses of the variable change first, each then carries the change up
+//	its own path, so a step shared by two paths sees both changes
+void boolExp::bind(const string& name, bool value)
+{
+	const std::size_t j = std::find(names.begin(), names.end(), name)
+		- names.begin();
+
+	if (j == names.size())
+		throw std::invalid_argument(name + " is not a variable\n");
+
+	bind(j, value);
+}
+
+void boolExp::bind(std::size_t j, bool value)
+{
+	if (bindings.at(j) == value)
+		return;
+	bindings[j] = value;
+
+	if (values.empty())
 	{
-		return pre.top();
+		result.reset();
+		return;
 	}
-	else
+
+	for (std::uint32_t i : readers[j])
 	{
-		return "";
+		values[i] = value;
+		propagate(i);
 	}
-};
 
-// https://www.prepbytes.com/blog/stacks/conversion-of-prefix-to-postfix-notation/
-string boolExp::prefix_to_postfix(const string& pre)
-{
-	stack<string> post;
-	string erp;
-	string mini;
+	result = values.back();
+}
 
-	// reverse the string
-	erp = pre;
-	std::reverse(erp.begin(), erp.end());
+std::size_t boolExp::subtree(std::size_t i) const
+{
+	std::size_t first = i;
+	long need = program.at(i).arity();
 
-	for (const char& symbol : erp)
+	while (need > 0)
 	{
-		mini = "";
-		switch (symbol)
+		first--;
+		need += static_cast<long>(program[first].arity()) - 1;
+	}
+
+	return first;
+}
+
+// the steps are spliced in place and the variables renumbered in order of
+//	first use, relinking is a linear scan but no step outside the new
+//	subexpression or its path to the root is evaluated again
+void boolExp::replace(std::size_t i, const string& infix)
+{
+	const std::size_t first = subtree(i);
+	std::map<string, signed char> bound;
+	std::map<string, std::uint32_t> seen;
+	std::vector<string> all = names, vars;
+	boolExp part;
+
+	part.expression = part.infix_to_postfix(infix);
+	part.compile();
+
+	for (std::size_t j = 0; j < names.size(); j++)
+		bound[names[j]] = bindings[j];
+
+	// the new steps index the names of both expressions for now
+	all.insert(all.end(), part.names.begin(), part.names.end());
+	for (step& s : part.program)
+		if (s.code == step::op::VARIABLE)
+			s.arg += static_cast<std::uint32_t>(names.size());
+
+	program.erase(program.begin() + first, program.begin() + i + 1);
+	program.insert(program.begin() + first, part.program.begin(),
+		part.program.end());
+
+	for (step& s : program)
+		if (s.code == step::op::VARIABLE)
 		{
-		case '0': case '1':
-			mini += symbol;
-			post.push(mini);
-			break;
-		case '~':
-			mini += post.top();
-			post.pop();
-			mini += symbol;
-			post.push(mini);
-			break;
-		case '&': case '|': case '^':
-			for (int i = 0; i < 2; i++)
-			{
-				mini += post.top();
-				post.pop();
-			}
-			mini += symbol;
-			post.push(mini);
-			break;
-		default: break;
+			auto found = seen.emplace(all[s.arg],
+				static_cast<std::uint32_t>(vars.size()));
+			if (found.second)
+				vars.push_back(all[s.arg]);
+			s.arg = found.first->second;
 		}
 
+	names = std::move(vars);
+	bindings.assign(names.size(), -1);
+	for (std::size_t j = 0; j < names.size(); j++)
+	{
+		auto found = bound.find(names[j]);
+		if (found != bound.end())
+			bindings[j] = found->second;
 	}
 
-	if (!post.empty())
+	link();
+	write();
+
+	if (values.empty() || std::find(bindings.begin(), bindings.end(), -1)
+		!= bindings.end())
 	{
-		return post.top();
+		values.clear();
+		result.reset();
+		return;
 	}
-	else
+
+	values.erase(values.begin() + first, values.begin() + i + 1);
+	values.insert(values.begin() + first, part.program.size(), 0);
+	for (std::size_t k = first; k < first + part.program.size(); k++)
+		recompute(k);
+	propagate(first + part.program.size() - 1);
+
+	result = values.back();
+}
+
+// the six lowest variables repeat inside every word, so their lanes are
+//	fixed patterns, the others are constant across a word; four words go
+//	through the program per pass
+std::vector<std::uint64_t> boolExp::truth_table() const
+{
+	static constexpr std::uint64_t PATTERN[6] = {
+		0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+		0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull };
+	constexpr std::size_t K = 4;
+
+	const std::size_t n = names.size();
+	std::vector<std::uint64_t> table, vars(n * K);
+	std::uint64_t out[K];
+	std::size_t words, block;
+
+	if (n > 32)
+		throw std::invalid_argument("A truth table needs at most 32"
+			" variables\n");
+
+	words = (n <= 6) ? 1 : (std::size_t(1) << (n - 6));
+	table.resize(words);
+
+	for (std::size_t j = 0; j < n && j < 6; j++)
+		for (std::size_t k = 0; k < K; k++)
+			vars[j * K + k] = PATTERN[j];
+
+	for (std::size_t w = 0; w < words; w += K)
 	{
-		return "";
+		for (std::size_t j = 6; j < n; j++)
+			for (std::size_t k = 0; k < K; k++)
+				vars[j * K + k] = (((w + k) >> (j - 6)) & 1)
+					? ~std::uint64_t(0) : 0;
+
+		run<K>(vars.data(), out);
+
+		block = std::min(K, words - w);
+		std::copy(out, out + block, table.begin() + w);
 	}
 
-};
+	if (n < 6)
+		table[0] &= (std::uint64_t(1) << (std::size_t(1) << n)) - 1;
 
-void boolExp::getAndEval(stack<bool>& vals, const char& op)
+	return table;
+}
+
+// the program is replayed on a stack of diagram roots, the roots are not
+//	referenced until the end because nothing is collected while building
+bdd boolExp::to_bdd(std::shared_ptr<bddManager> mgr,
+	bddManager::ordering order) const
 {
-	std::array<bool, 2> holder;
+	std::vector<std::uint32_t> vars(names.size()), roots;
+	std::vector<std::size_t> uses(names.size()), rank(names.size());
+	std::uint32_t right;
+
+	if (!mgr)
+		mgr = std::make_shared<bddManager>();
+
+	for (const step& s : program)
+		if (s.code == step::op::VARIABLE)
+			uses[s.arg]++;
+
+	for (std::size_t i = 0; i < rank.size(); i++)
+		rank[i] = i;
+	if (order == bddManager::ordering::FREQUENCY)
+		std::stable_sort(rank.begin(), rank.end(),
+			[&uses](std::size_t a, std::size_t b) { return uses[a] > uses[b]; });
+
+	for (std::size_t i : rank)
+		vars[i] = mgr->variable(names[i]);
 
-	for (int i = 0; i < 2; i++)
+	roots.reserve(depth);
+	for (const step& s : program)
 	{
-		// get the top value
-		holder[i] = vals.top();
-		// pop the top
-		vals.pop();
+		switch (s.code)
+		{
+		case step::op::ZERO: roots.push_back(0); break;
+		case step::op::ONE: roots.push_back(1); break;
+		case step::op::VARIABLE:
+			roots.push_back(mgr->make(vars[s.arg], 0, 1));
+			break;
+		case step::op::NOT: roots.back() = mgr->negate(roots.back()); break;
+		default:
+			right = roots.back();
+			roots.pop_back();
+			roots.back() = mgr->apply((s.code == step::op::AND)
+				? bddManager::op::AND : (s.code == step::op::OR)
+				? bddManager::op::OR : bddManager::op::XOR,
+				roots.back(), right);
+			break;
+		}
 	}
 
-	// evaluate them wrt the operator
-	vals.push(eval_simple_exp(holder, op));
+	bdd result(mgr, roots.empty() ? 0 : roots.back());
+
+	if (order == bddManager::ordering::SIFT)
+		mgr->sift();
+
+	return result;
 }
 
+bool boolExp::equivalent(const boolExp& other) const
+{
+	auto mgr = std::make_shared<bddManager>();
 
-	/* public */
+	return to_bdd(mgr) == other.to_bdd(mgr);
+}
 
-// evaluate the full expression
-bool boolExp::evaluate()
+// every operator gets a variable equal to its result, NOT only flips the
+//	literal and the constants are a variable fixed true
+satSolver boolExp::to_cnf() const
 {
-	bool temp;
-	stack<bool> vals;
-	string xpr = expression;
+	typedef satSolver::lit lit;
 
-	if (result)
-		return *result;
-	else
+	satSolver solver;
+	std::vector<lit> stack;
+	lit a, b, c;
+
+	for (std::size_t i = 0; i < names.size(); i++)
+		solver.new_var();
+
+	const std::uint32_t top = solver.new_var();
+	solver.add_clause({ satSolver::pos(top) });
+
+	stack.reserve(depth);
+	for (const step& s : program)
 	{
-		// if the string is empty
-		try
+		switch (s.code)
 		{
-			if (expression == "")
+		case step::op::ZERO: stack.push_back(satSolver::neg(top)); break;
+		case step::op::ONE: stack.push_back(satSolver::pos(top)); break;
+		case step::op::VARIABLE: stack.push_back(satSolver::pos(s.arg)); break;
+		case step::op::NOT: stack.back() ^= 1; break;
+		default:
+			b = stack.back();
+			stack.pop_back();
+			a = stack.back();
+			c = satSolver::pos(solver.new_var());
+
+			if (s.code == step::op::AND)
 			{
-				//throw std::invalid_argument("Expression is empty");
-				return false;
+				solver.add_clause({ c ^ 1, a });
+				solver.add_clause({ c ^ 1, b });
+				solver.add_clause({ c, a ^ 1, b ^ 1 });
 			}
-
-			for (char& symbol : xpr)
+			else if (s.code == step::op::OR)
 			{
-				switch (symbol)
-				{
-				case '0': vals.push(false); break;
-				case '1': vals.push(true); break;
-				case '~':
-					temp = vals.top();
-					vals.pop();
-					vals.push(!temp);
-					break;
-				case '&': case '|': case '^':
-					getAndEval(vals, symbol);
-					break;
-				default:
-					throw std::invalid_argument
-					("Invalid char in postfix expression\n");
-					break;
-				}
-
+				solver.add_clause({ c, a ^ 1 });
+				solver.add_clause({ c, b ^ 1 });
+				solver.add_clause({ c ^ 1, a, b });
+			}
+			else
+			{
+				solver.add_clause({ c ^ 1, a, b });
+				solver.add_clause({ c ^ 1, a ^ 1, b ^ 1 });
+				solver.add_clause({ c, a ^ 1, b });
+				solver.add_clause({ c, a, b ^ 1 });
 			}
 
-			result = new bool(vals.top());
-
-			return *result;
-		}
-		catch (const std::invalid_argument& e)
-		{
-			std::cerr << e.what();
-			return false;
+			stack.back() = c;
+			break;
 		}
-
 	}
 
+	solver.add_clause({ stack.empty() ? satSolver::neg(top) : stack.back() });
+
+	return solver;
 }
 
-// return the Expression's expression as a string in a given format
-string boolExp::getExpression(const string& format)
+std::optional<std::map<string, bool>> boolExp::model() const
+{
+	satSolver solver = to_cnf();
+	std::map<string, bool> values;
+
+	if (!solver.solve())
+		return std::nullopt;
+
+	for (std::size_t i = 0; i < names.size(); i++)
+		values[names[i]] = solver.model(static_cast<std::uint32_t>(i));
+
+	return values;
+}
+
+// after every model a clause that rules out exactly its assignment is added,
+//	the learnt clauses are kept so each search starts where the last ended
+std::vector<std::map<string, bool>> boolExp::all_models(std::size_t limit)
+	const
 {
-	try
+	satSolver solver = to_cnf();
+	std::vector<std::map<string, bool>> models;
+	std::vector<satSolver::lit> blocking(names.size());
+	bool value;
+
+	while (models.size() < limit && solver.solve())
 	{
-		if (format == "postfix") // if the user wants postfix format
-		{
-			return expression;
-		}
-		else if (format == "infix") // if the user wants infix format
-		{
+		std::map<string, bool>& values = models.emplace_back();
 
-			return postfix_to_infix(expression);
-		}
-		else if (format == "prefix") // if the user wants prefix format
+		for (std::uint32_t i = 0; i < names.size(); i++)
 		{
-			return postfix_to_prefix(expression);
+			value = solver.model(i);
+			values[names[i]] = value;
+			blocking[i] = value ? satSolver::neg(i) : satSolver::pos(i);
 		}
-		else
+
+		if (!solver.add_clause(blocking))
+			break;
+	}
+
+	return models;
+}
+
+void boolExp::evaluate_batch(const exprDag<step>& dag,
+	const std::vector<std::uint32_t>& roots, const std::uint64_t* vars,
+	std::size_t words, std::uint64_t* out)
+{
+	dag.evaluate(roots, vars, words, out,
+		[](const step& s, std::uint64_t a, std::uint64_t b) -> std::uint64_t
 		{
-			throw std::invalid_argument("Input of getExpression must be"
-				"\"postfix\", \"infix\", or \"prefix\"\n");
-		}
+			switch (s.code)
+			{
+			case step::op::ONE: return ~std::uint64_t(0);
+			case step::op::NOT: return ~a;
+			case step::op::AND: return a & b;
+			case step::op::OR: return a | b;
+			case step::op::XOR: return a ^ b;
+			default: return 0;
+			}
+		});
+}
 
+void boolExp::minimize()
+{
+	std::optional<sopCover> cover;
+
+	if (names.size() > 64)
+		return;
+	else if (names.size() <= sopCover::EXACT)
+		cover = sopCover::exact(truth_table(), names.size());
+	else
+	{
+		auto mgr = std::make_shared<bddManager>();
+		const bdd f = to_bdd(mgr);
+		cover = sopCover::heuristic(*mgr, f.id(), names.size());
 	}
-	catch (const std::invalid_argument& e)
+
+	if (!cover)
+		return;
+
+	const string infix = cover->to_infix(names);
+	if (boolExp(infix).steps().size() < program.size())
+		setExpression(infix);
+}
+
+// return the Expression's expression as a string in a given format
+// a bad format is reported like setExpression reports one, nothing is thrown
+string boolExp::getExpression(const string& format)
+{
+	notation n;
+
+	if (!exprParser::try_notation(format, n))
 	{
-		std::cerr << e.what();
+		report(exprError{ exprError::kind::BAD_FORMAT }, format);
+		return string();
 	}
 
+	switch (n)
+	{
+	case notation::POSTFIX: return expression;
+	case notation::PREFIX:
+		if (!prefix_form)
+			prefix_form = postfix_to_prefix(expression);
+		return *prefix_form;
+	default:
+		if (!infix_form)
+			infix_form = postfix_to_infix(expression);
+		return *infix_form;
+	}
 }
 
 // set the expression that is in a given format
+// the message is only written here, try_set never touches a stream
 void boolExp::setExpression(const string& xpr, const string& format)
 {
-	try
-	{
-		if (format == "postfix")
-		{
-			expression = xpr;
-		}
-		else if (format == "infix")
+	notation n;
+	const exprError e = exprParser::try_notation(format, n)
+		? try_set(xpr, n) : exprError{ exprError::kind::BAD_FORMAT };
+
+	if (e)
+		report(e, xpr);
+}
+
+// the tokens are compiled straight from the new text, so it is parsed once
+//	and nothing is thrown
+exprError boolExp::try_set(std::string_view xpr, notation n)
+{
+	thread_local std::vector<exprToken> tokens;
+	const exprError e = exprParser::try_parse(xpr, SYNTAX, n, tokens);
+
+	if (e)
+		return e;
+
+	compile(xpr, tokens);
+	expression = exprParser::write_postfix(xpr, tokens);
+
+	return e;
+}
+
+// the steps and names are written as compile() writes them and the text as
+//	write_postfix() does, into arrays sized by a first parse
+template <exprText S>
+consteval auto boolExp::precompile()
+{
+	constexpr std::string_view src = S.view();
+	constexpr std::array<std::size_t, 3> SIZE = [src]()
 		{
-			expression = infix_to_postfix(xpr);
-		}
-		else if (format == "prefix")
+			std::vector<exprToken> tokens;
+			return extent(src, tokens);
+		}();
+
+	image<SIZE[0], SIZE[1], SIZE[2]> out{};
+	std::vector<exprToken> tokens;
+	std::size_t count = 0, at = 0;
+
+	extent(src, tokens);
+
+	for (std::size_t i = 0; i < tokens.size(); i++)
+	{
+		const exprToken& tok = tokens[i];
+		const std::string_view text = src.substr(tok.pos, tok.len);
+		std::uint32_t arg = 0;
+
+		if (tok.type == exprToken::kind::NAME)
 		{
-			expression = prefix_to_postfix(xpr);
+			while (arg < count && out.names[arg] != text)
+				arg++;
+			if (arg == count)
+				out.names[count++] = text;
 		}
+		out.program[i] = step{ opcode(src, tok), arg };
+
+		if (i > 0)
+			out.postfix[at++] = ' ';
+		if (tok.type == exprToken::kind::UNARY
+			|| tok.type == exprToken::kind::BINARY)
+			out.postfix[at++] = tok.code;
 		else
-		{
-			throw std::invalid_argument("Input must be"
-				"\"postfix\", \"infix\", or \"prefix\"\n");
-		}
-	}
-	catch (const std::invalid_argument& e)
-	{
-		std::cerr << e.what();
+			for (char c : text)
+				out.postfix[at++] = c;
 	}
 
+	return out;
 }
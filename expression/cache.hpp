@@ -0,0 +1,586 @@
+#pragma once
+
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "expression.hpp"
+
+
+/* classes */
+
+/* exprEpoch */
+
+// purpose: epoch based reclamation, memory a thread unlinks from a shared
+//	structure is freed once no thread can still be reading it
+// invariants: a thread reads shared memory only while it holds a guard; a
+//	guard announces the epoch it entered in, and the epoch only advances
+//	once every announcing guard has seen it, so memory retired in epoch e is
+//	unreachable by the time the epoch is e + 2
+// data members:
+//	'epoch' is the global epoch, it starts at 1 so 0 can mean "not reading"
+//	'records' is a list of records, each claimed by one guard or retire()
+//	at a time and given back when it ends, grown when every record is taken
+//	and kept until the domain is destroyed; retired memory stays in a record
+//	and is freed by whichever retire() claims it next
+class exprEpoch
+{
+	struct record;
+
+public:
+		/* prerequisites */
+
+	// purpose: holds the epoch for as long as it lives, guards nest
+	class guard
+	{
+		exprEpoch& domain;
+		record& self;
+
+	public:
+		explicit guard(exprEpoch& = exprEpoch::global());
+		~guard();
+		guard(const guard&) = delete;
+		guard& operator=(const guard&) = delete;
+	};
+
+private:
+		/* prerequisites */
+
+	// how much memory a record holds before retire() tries to free some
+	static constexpr std::size_t THRESHOLD = 64;
+
+	// memory waiting to be freed, and the epoch it was retired in
+	struct retired
+	{
+		void* memory;
+		void (*free)(void*);
+		std::uint64_t epoch;
+	};
+
+	struct alignas(64) record
+	{
+		std::atomic<std::uint64_t> announced{ 0 };
+		std::atomic<bool> used{ true };
+		record* next = nullptr;
+		std::vector<retired> limbo;
+	};
+
+		/* member variables */
+
+	std::atomic<std::uint64_t> epoch{ 1 };
+
+	std::atomic<record*> records{ nullptr };
+
+	std::atomic<std::size_t> waiting{ 0 };
+
+		/* member functions */
+
+	// purpose: claims a free record, adding one when every record is taken
+	// requires: nothing
+	// returns: the record, owned by the caller until release()
+	record& claim();
+
+	// purpose: gives a record back
+	// requires: a record from claim(), no longer announcing
+	// returns: nothing
+	void release(record& r) { r.used.store(false, std::memory_order_release); }
+
+	// purpose: advances the epoch if every reading record has seen it, then
+	//	frees what is old enough
+	// requires: a record the caller claimed
+	// returns: nothing
+	void collect(record&);
+
+public:
+
+		/* constructors */
+
+	exprEpoch() = default;
+
+	// every record's memory is freed, no thread may be in a guard
+	~exprEpoch();
+
+	exprEpoch(const exprEpoch&) = delete;
+	exprEpoch& operator=(const exprEpoch&) = delete;
+
+		/* member functions */
+
+	// purpose: finds the domain shared by the whole process
+	// requires: nothing
+	// returns: the domain
+	static exprEpoch& global();
+
+	// purpose: hands memory over to be freed once no guard can see it
+	// requires: memory already unreachable from the shared structure, and
+	//	the function that frees it
+	// returns: nothing
+	void retire(void*, void (*)(void*));
+
+	// purpose: counts what has been retired but not freed
+	// requires: nothing
+	// returns: a count, exact only when no thread is retiring
+	std::size_t pending() const
+	{ return waiting.load(std::memory_order_relaxed); }
+
+};
+
+/* exprCache */
+
+// purpose: a process wide cache of compiled expressions, so threads that
+//	build the same expression from many records parse and compile it once
+// invariants: 'Exp' is an Expression with try_set() and
+//	try_evaluate(const map&, adt&) const; an entry is keyed by its postfix
+//	program, the operators, literals and names in order, so spacing,
+//	redundant parentheses and notation do not matter; a slot goes from empty
+//	to an entry and from one entry to another, never back unless cleared,
+//	so a lookup stops at the first empty slot of its window; an entry is
+//	read only under an exprEpoch::guard and freed through retire()
+// data members:
+//	'slots' is an open addressing table of 'mask' + 1 entries, an entry
+//	lives in one of the PROBE slots from its hash on
+//	'hits', 'misses' and 'evictions' count lookups, 'count' the slots in
+//	use and 'held' the bytes of the entries in them
+//	'prototype' is an expression of the kind cached, for its grammar
+template <class Exp>
+class exprCache
+{
+public:
+		/* prerequisites */
+
+	typedef typename Exp::value_type adt;
+
+	// a snapshot of the counters
+	struct stats
+	{
+		std::uint64_t hits;
+		std::uint64_t misses;
+		std::uint64_t evictions;
+		std::size_t entries;
+		std::size_t capacity;
+		std::size_t bytes;
+
+		double hit_rate() const
+		{ return hits + misses ? double(hits) / double(hits + misses) : 0; }
+	};
+
+private:
+		/* prerequisites */
+
+	// how many slots from its hash on an entry may live in
+	static constexpr std::size_t PROBE = 8;
+
+	struct entry
+	{
+		std::uint64_t hash;
+		std::string key;
+		Exp value;
+		std::size_t size;
+	};
+
+		/* member variables */
+
+	std::unique_ptr<std::atomic<entry*>[]> slots;
+
+	std::size_t mask;
+
+	alignas(64) std::atomic<std::uint64_t> hits{ 0 };
+
+	alignas(64) std::atomic<std::uint64_t> misses{ 0 };
+
+	std::atomic<std::uint64_t> evictions{ 0 };
+
+	std::atomic<std::size_t> count{ 0 };
+
+	std::atomic<std::size_t> held{ 0 };
+
+	const Exp prototype;
+
+		/* member functions */
+
+	// purpose: frees an entry, for exprEpoch::retire
+	// requires: the entry
+	// returns: nothing
+	static void destroy(void* e) { delete static_cast<entry*>(e); }
+
+	// purpose: writes the key of a parsed expression
+	// requires: the source, its tokens and the string to write into
+	// returns: the hash of the key, and replaces the string
+	static std::uint64_t canonical(std::string_view,
+		const std::vector<exprToken>&, std::string&);
+
+	// purpose: finds an entry, compiling and inserting it on a miss
+	// requires: the source, its notation and the entry to set, the caller
+	//	holds a guard
+	// returns: NONE, or the first error, and then the entry is untouched
+	exprError acquire(std::string_view, notation, const entry*&);
+
+public:
+
+		/* constructors */
+
+	// parametrized constructor
+	// takes in the most entries to hold, rounded up to a power of two
+	explicit exprCache(std::size_t = 4096);
+
+	// every entry is freed, no thread may be using the cache
+	~exprCache();
+
+	exprCache(const exprCache&) = delete;
+	exprCache& operator=(const exprCache&) = delete;
+
+		/* member functions */
+
+	// purpose: finds the cache shared by the whole process for this kind of
+	//	expression
+	// requires: nothing
+	// returns: the cache
+	static exprCache& shared();
+
+	// purpose: finds a compiled expression, compiling it on a miss, and
+	//	hands it to a function while it is guaranteed to live
+	// requires: the source, a function void(const Exp&) that must not keep
+	//	the reference, and the notation, by default infix
+	// returns: NONE, or the first parse error, and then the function is not
+	//	called
+	template <class Use>
+	exprError try_use(std::string_view, Use&&, notation = notation::INFIX);
+
+	// purpose: evaluates an expression with values for its variables,
+	//	compiling it only on a miss
+	// requires: the source, a map from each variable name to its value, the
+	//	value to set and the notation, by default infix
+	// returns: NONE, or the first parse error, or UNBOUND with the index of
+	//	the first variable missing from the map
+	exprError try_evaluate(std::string_view, const std::map<string, adt>&,
+		adt&, notation = notation::INFIX);
+
+	// purpose: empties the cache, the counters are kept
+	// requires: nothing
+	// returns: nothing
+	void clear();
+
+	// purpose: finds the most entries the cache holds
+	// requires: nothing
+	// returns: a size, memory is bounded by it times the largest entry,
+	//	plus what exprEpoch::pending() counts
+	std::size_t capacity() const { return mask + 1; }
+
+	// purpose: reads the counters
+	// requires: nothing
+	// returns: the hits, misses and evictions, the entries and the bytes
+	//	they hold, each read on its own so they may be a moment apart
+	stats statistics() const;
+
+};
+
+
+	/* methods */
+
+/* exprEpoch */
+
+/* private */
+
+// a record is claimed with a compare and swap, so a caller never waits;
+//	a new record is pushed on the front of the list, which only grows, and
+//	starts out claimed
+exprEpoch::record& exprEpoch::claim()
+{
+	for (record* r = records.load(std::memory_order_acquire); r; r = r->next)
+	{
+		bool free = false;
+		if (!r->used.load(std::memory_order_relaxed)
+			&& r->used.compare_exchange_strong(free, true,
+				std::memory_order_acquire))
+			return *r;
+	}
+
+	record* made = new record;
+	made->next = records.load(std::memory_order_relaxed);
+	while (!records.compare_exchange_weak(made->next, made,
+		std::memory_order_release, std::memory_order_relaxed))
+		;
+
+	return *made;
+}
+
+void exprEpoch::collect(record& self)
+{
+	std::uint64_t now = epoch.load();
+	std::size_t kept = 0;
+	bool seen = true;
+
+	for (record* r = records.load(std::memory_order_acquire); r && seen;
+		r = r->next)
+	{
+		const std::uint64_t a = r->announced.load();
+		seen = a == 0 || a == now;
+	}
+	if (seen && epoch.compare_exchange_strong(now, now + 1))
+		now++;
+
+	for (const retired& r : self.limbo)
+		if (r.epoch + 2 <= now)
+			r.free(r.memory);
+		else
+			self.limbo[kept++] = r;
+
+	waiting.fetch_sub(self.limbo.size() - kept, std::memory_order_relaxed);
+	self.limbo.resize(kept);
+}
+
+/* public */
+
+exprEpoch::~exprEpoch()
+{
+	for (record* r = records.load(); r; )
+	{
+		record* next = r->next;
+		for (const retired& x : r->limbo)
+			x.free(x.memory);
+		delete r;
+		r = next;
+	}
+}
+
+exprEpoch& exprEpoch::global()
+{
+	static exprEpoch domain;
+
+	return domain;
+}
+
+void exprEpoch::retire(void* memory, void (*free)(void*))
+{
+	record& self = claim();
+
+	self.limbo.push_back(retired{ memory, free, epoch.load() });
+	waiting.fetch_add(1, std::memory_order_relaxed);
+
+	if (self.limbo.size() >= THRESHOLD)
+		collect(self);
+
+	release(self);
+}
+
+/* guard */
+
+// each guard announces in a record of its own, so a nested guard costs a
+//	record and a thread holds none outside a guard; the announcement is
+//	sequentially consistent so no pointer read under the guard can be
+//	ordered before it
+exprEpoch::guard::guard(exprEpoch& d) : domain(d), self(d.claim())
+{
+	self.announced.store(domain.epoch.load());
+}
+
+exprEpoch::guard::~guard()
+{
+	self.announced.store(0, std::memory_order_release);
+	domain.release(self);
+}
+
+/* exprCache */
+
+/* private */
+
+// each token is its kind, its code and its index, and the text of an
+//	operand or a call, so two keys are equal only for the same program; the
+//	hash is FNV-1a over the key
+template <class Exp>
+std::uint64_t exprCache<Exp>::canonical(std::string_view src,
+	const std::vector<exprToken>& tokens, std::string& key)
+{
+	std::uint64_t h = 0xcbf29ce484222325ull;
+
+	key.clear();
+	for (const exprToken& tok : tokens)
+	{
+		key += static_cast<char>(tok.type);
+		key += tok.code;
+		key += static_cast<char>(tok.index & 0xff);
+		key += static_cast<char>(tok.index >> 8);
+		if (tok.type != exprToken::kind::UNARY
+			&& tok.type != exprToken::kind::BINARY)
+		{
+			key.append(src.data() + tok.pos, tok.len);
+			key += '\0';
+		}
+	}
+
+	for (char c : key)
+		h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+
+	return h;
+}
+
+// a hit costs a parse and no allocation; a miss compiles outside the
+//	table, then publishes with a compare and swap, and a thread that loses
+//	the race to the same key drops its copy and uses the winner's; when the
+//	window is full a slot in it is swapped out and its entry retired
+template <class Exp>
+exprError exprCache<Exp>::acquire(std::string_view src, notation n,
+	const entry*& out)
+{
+	thread_local std::vector<exprToken> tokens;
+	thread_local std::string key;
+	thread_local std::uint64_t victim = 0x9e3779b97f4a7c15ull;
+
+	exprError e = exprParser::try_parse(src,
+		static_cast<const Expression<adt>&>(prototype).syntax(), n, tokens);
+	if (e)
+		return e;
+
+	const std::uint64_t h = canonical(src, tokens, key);
+
+	for (std::size_t i = 0; i < PROBE; i++)
+	{
+		const entry* found = slots[(h + i) & mask].load(
+			std::memory_order_acquire);
+		if (!found)
+			break;
+		if (found->hash == h && found->key == key)
+		{
+			hits.fetch_add(1, std::memory_order_relaxed);
+			out = found;
+			return e;
+		}
+	}
+
+	misses.fetch_add(1, std::memory_order_relaxed);
+
+	std::unique_ptr<entry> made(new entry{ h, key, Exp(), 0 });
+	e = made->value.try_set(src, n);
+	if (e)
+		return e;
+	made->size = sizeof(entry) + made->key.capacity()
+		+ made->value.compiled().bytes();
+
+	for (std::size_t i = 0; i < PROBE; i++)
+	{
+		std::atomic<entry*>& s = slots[(h + i) & mask];
+		entry* found = s.load(std::memory_order_acquire);
+
+		if (!found && s.compare_exchange_strong(found, made.get(),
+			std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			count.fetch_add(1, std::memory_order_relaxed);
+			held.fetch_add(made->size, std::memory_order_relaxed);
+			out = made.release();
+			return e;
+		}
+		if (found->hash == h && found->key == key)
+		{
+			out = found;
+			return e;
+		}
+	}
+
+	victim ^= victim << 13;
+	victim ^= victim >> 7;
+	victim ^= victim << 17;
+
+	entry* old = slots[(h + victim % PROBE) & mask].exchange(made.get(),
+		std::memory_order_acq_rel);
+	held.fetch_add(made->size, std::memory_order_relaxed);
+	out = made.release();
+
+	if (old)
+	{
+		held.fetch_sub(old->size, std::memory_order_relaxed);
+		evictions.fetch_add(1, std::memory_order_relaxed);
+		exprEpoch::global().retire(old, destroy);
+	}
+	else
+		count.fetch_add(1, std::memory_order_relaxed);
+
+	return e;
+}
+
+/* public */
+
+template <class Exp>
+exprCache<Exp>::exprCache(std::size_t entries) : mask(PROBE - 1)
+{
+	while (mask + 1 < entries)
+		mask = mask << 1 | 1;
+
+	slots.reset(new std::atomic<entry*>[mask + 1]);
+	for (std::size_t i = 0; i <= mask; i++)
+		slots[i].store(nullptr, std::memory_order_relaxed);
+
+	// the domain outlives every cache built after it
+	exprEpoch::global();
+}
+
+template <class Exp>
+exprCache<Exp>::~exprCache()
+{
+	for (std::size_t i = 0; i <= mask; i++)
+		delete slots[i].load(std::memory_order_relaxed);
+}
+
+template <class Exp>
+exprCache<Exp>& exprCache<Exp>::shared()
+{
+	static exprCache cache;
+
+	return cache;
+}
+
+template <class Exp>
+template <class Use>
+exprError exprCache<Exp>::try_use(std::string_view src, Use&& use,
+	notation n)
+{
+	exprEpoch::guard hold;
+	const entry* found = nullptr;
+	const exprError e = acquire(src, n, found);
+
+	if (!e)
+		use(found->value);
+
+	return e;
+}
+
+template <class Exp>
+exprError exprCache<Exp>::try_evaluate(std::string_view src,
+	const std::map<string, adt>& bindings, adt& out, notation n)
+{
+	exprError e;
+
+	const exprError parsed = try_use(src, [&](const Exp& x)
+		{ e = x.try_evaluate(bindings, out); }, n);
+
+	return parsed ? parsed : e;
+}
+
+template <class Exp>
+void exprCache<Exp>::clear()
+{
+	for (std::size_t i = 0; i <= mask; i++)
+	{
+		entry* old = slots[i].exchange(nullptr, std::memory_order_acq_rel);
+		if (old)
+		{
+			count.fetch_sub(1, std::memory_order_relaxed);
+			held.fetch_sub(old->size, std::memory_order_relaxed);
+			exprEpoch::global().retire(old, destroy);
+		}
+	}
+}
+
+template <class Exp>
+typename exprCache<Exp>::stats exprCache<Exp>::statistics() const
+{
+	return stats{ hits.load(std::memory_order_relaxed),
+		misses.load(std::memory_order_relaxed),
+		evictions.load(std::memory_order_relaxed),
+		count.load(std::memory_order_relaxed), mask + 1,
+		held.load(std::memory_order_relaxed) };
+}
@@ -0,0 +1,457 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TECAF_MMAP 1
+#endif
+
+#include "boolExp.hpp"
+
+
+/* classes */
+
+/* boolCorpus */
+
+// purpose: a large set of independent boolean expressions, compiled into one
+//	contiguous program and evaluated in parallel into a packed bitset
+// invariants: expression i is the steps [offsets[i], offsets[i + 1]) of
+//	'arena', empty when its line did not parse; a VARIABLE step indexes the
+//	variables of the whole corpus
+// data members:
+//	'arena' holds the steps of every expression, back to back
+//	'offsets' holds where each expression starts, and one past the last
+//	'names' holds the variables of every expression in order of first use
+//	'depth' is the deepest stack any expression needs
+//	'results' holds bit i % 64 of word i / 64 for expression i
+class boolCorpus
+{
+private:
+		/* prerequisites */
+
+	typedef boolExp::step step;
+
+	// the expressions a thread takes at once, whole words of the results
+	static constexpr std::size_t BLOCK = 4096;
+
+		/* member variables */
+
+	std::vector<step> arena;
+
+	std::vector<std::uint64_t> offsets{ 0 };
+
+	std::vector<std::string> names;
+
+	std::size_t depth = 0;
+
+	std::vector<std::uint64_t> results;
+
+		/* member functions */
+
+	// purpose: runs a task on every block, each thread owns a range of
+	//	blocks and steals half of another's when its own runs out
+	// requires: the number of blocks, the threads, 0 for one per core, and
+	//	a task taking a block index
+	// returns: nothing
+	template <class Task>
+	static void parallel(std::size_t, unsigned, Task);
+
+	// purpose: evaluates one expression
+	// requires: its index, the value of every variable and a stack of
+	//	'depth' entries
+	// returns: a bool, false for an expression that did not parse
+	bool run(std::size_t, const unsigned char*, unsigned char*) const;
+
+public:
+
+		/* constructors */
+
+	// default constructor
+	// an empty corpus
+	boolCorpus() {}
+
+	// parametrized constructor
+	// takes newline delimited infix expressions, one per line, and the
+	//	threads to parse them on, 0 for one per core
+	boolCorpus(std::string_view, unsigned = 0);
+
+		/* member functions */
+
+	// purpose: reads a corpus from a file of newline delimited infix
+	//	expressions, mapped into memory where the platform allows
+	// requires: the path and the threads to parse on, 0 for one per core
+	// returns: a corpus
+	static boolCorpus from_file(const std::string&, unsigned = 0);
+
+	// purpose: counts the expressions
+	// requires: nothing
+	// returns: a size
+	std::size_t size() const { return offsets.size() - 1; }
+
+	// purpose: checks whether an expression parsed
+	// requires: its index
+	// returns: a bool
+	bool valid(std::size_t i) const { return offsets[i + 1] > offsets[i]; }
+
+	// purpose: finds the variables of the corpus
+	// requires: nothing
+	// returns: the names in order of first use
+	const std::vector<std::string>& variables() const { return names; }
+
+	// purpose: evaluates every expression
+	// requires: a value for every variable by name, none by default, and the
+	//	threads, 0 for one per core
+	// returns: the results, bit i % 64 of word i / 64 for expression i
+	const std::vector<std::uint64_t>& evaluate(
+		const std::map<std::string, bool> & = {}, unsigned = 0);
+
+	// purpose: finds the result of an expression after evaluate()
+	// requires: its index
+	// returns: a bool
+	bool result(std::size_t i) const { return results[i / 64] >> (i % 64) & 1; }
+
+};
+
+
+	/* constructors */
+
+// the text is cut at line ends into one chunk per thread, every chunk is
+//	compiled on its own with its own variables, then the chunks are joined
+//	and their variables renumbered into the corpus'
+boolCorpus::boolCorpus(std::string_view text, unsigned threads)
+{
+	struct chunk
+	{
+		std::string_view text;
+		std::vector<step> steps;
+		std::vector<std::uint64_t> ends;
+		std::vector<std::string> names;
+		std::size_t depth = 0;
+	};
+
+	std::vector<chunk> chunks;
+	std::size_t start = 0, cut;
+
+	if (!text.empty() && text.back() == '\n')
+		text.remove_suffix(1);
+	if (text.empty())
+		return;
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = static_cast<unsigned>(std::min<std::size_t>(threads,
+		text.size() / 65536 + 1));
+
+	for (unsigned t = 1; t <= threads && start <= text.size(); t++)
+	{
+		cut = (t == threads) ? text.size()
+			: text.find('\n', std::max(start, text.size() / threads * t));
+		if (cut == std::string_view::npos)
+			cut = text.size();
+		chunks.emplace_back().text = text.substr(start, cut - start);
+		start = cut + 1;
+	}
+
+	auto compile = [](chunk& c)
+		{
+			std::unordered_map<std::string_view, std::uint32_t> local;
+			std::vector<exprToken> tokens;
+			std::size_t from = 0, to, height, deepest;
+			std::string_view line;
+			step next;
+
+			for (; from <= c.text.size(); from = to + 1)
+			{
+				to = std::min(c.text.find('\n', from), c.text.size());
+				line = c.text.substr(from, to - from);
+				if (!line.empty() && line.back() == '\r')
+					line.remove_suffix(1);
+
+				// a line that does not parse is left empty, without throwing
+				if (exprParser::try_parse(line, boolExp::SYNTAX,
+					notation::INFIX, tokens))
+					tokens.clear();
+
+				// the opcodes are boolExp's, only the variables are
+				//	numbered here, by a map instead of its linear search
+				height = deepest = 0;
+				for (const exprToken& tok : tokens)
+				{
+					next = step{ boolExp::opcode(line, tok), 0 };
+					if (next.code == step::op::VARIABLE)
+					{
+						auto found = local.emplace(line.substr(tok.pos,
+							tok.len), static_cast<std::uint32_t>(
+							c.names.size()));
+						if (found.second)
+							c.names.emplace_back(found.first->first);
+						next.arg = found.first->second;
+					}
+					height = height + 1 - next.arity();
+					deepest = std::max(deepest, height);
+					c.steps.push_back(next);
+				}
+				c.depth = std::max(c.depth, deepest);
+				c.ends.push_back(c.steps.size());
+			}
+		};
+
+	{
+		std::vector<std::thread> pool;
+		for (std::size_t t = 1; t < chunks.size(); t++)
+			pool.emplace_back(compile, std::ref(chunks[t]));
+		compile(chunks[0]);
+		for (std::thread& t : pool)
+			t.join();
+	}
+
+	std::unordered_map<std::string, std::uint32_t> global;
+	std::vector<std::vector<std::uint32_t>> remap(chunks.size());
+	std::vector<std::size_t> base(chunks.size() + 1);
+
+	for (std::size_t t = 0; t < chunks.size(); t++)
+	{
+		for (const std::string& name : chunks[t].names)
+		{
+			auto found = global.emplace(name,
+				static_cast<std::uint32_t>(names.size()));
+			if (found.second)
+				names.push_back(name);
+			remap[t].push_back(found.first->second);
+		}
+		base[t + 1] = base[t] + chunks[t].steps.size();
+		depth = std::max(depth, chunks[t].depth);
+		for (std::uint64_t end : chunks[t].ends)
+			offsets.push_back(base[t] + end);
+	}
+
+	arena.resize(base.back());
+	parallel(chunks.size(), threads, [&](std::size_t t)
+		{
+			step* out = arena.data() + base[t];
+			for (step s : chunks[t].steps)
+			{
+				if (s.code == step::op::VARIABLE)
+					s.arg = remap[t][s.arg];
+				*out++ = s;
+			}
+		});
+}
+
+
+	/* methods */
+
+/* private */
+
+template <class Task>
+void boolCorpus::parallel(std::size_t blocks, unsigned threads, Task task)
+{
+	struct range
+	{
+		std::mutex lock;
+		std::size_t begin;
+		std::size_t end;
+	};
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = static_cast<unsigned>(std::min<std::size_t>(threads, blocks));
+	if (threads <= 1)
+	{
+		for (std::size_t b = 0; b < blocks; b++)
+			task(b);
+		return;
+	}
+
+	std::unique_ptr<range[]> ranges(new range[threads]);
+	for (unsigned t = 0; t < threads; t++)
+	{
+		ranges[t].begin = blocks * t / threads;
+		ranges[t].end = blocks * (t + 1) / threads;
+	}
+
+	auto work = [&](unsigned self)
+		{
+			std::size_t b, begin, end;
+
+			for (;;)
+			{
+				{
+					std::lock_guard<std::mutex> hold(ranges[self].lock);
+					b = ranges[self].begin;
+					if (b < ranges[self].end)
+						ranges[self].begin++;
+				}
+
+				if (b < ranges[self].end)
+				{
+					task(b);
+					continue;
+				}
+
+				// the back half of a victim's range, the victim keeps working
+				//	from the front
+				begin = end = 0;
+				for (unsigned k = 1; k < threads && begin == end; k++)
+				{
+					range& victim = ranges[(self + k) % threads];
+					std::lock_guard<std::mutex> hold(victim.lock);
+					if (victim.begin < victim.end)
+					{
+						end = victim.end;
+						begin = victim.end - (victim.end - victim.begin + 1) / 2;
+						victim.end = begin;
+					}
+				}
+
+				if (begin == end)
+					return;
+
+				std::lock_guard<std::mutex> hold(ranges[self].lock);
+				ranges[self].begin = begin;
+				ranges[self].end = end;
+			}
+		};
+
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads; t++)
+		pool.emplace_back(work, t);
+	work(0);
+	for (std::thread& t : pool)
+		t.join();
+}
+
+bool boolCorpus::run(std::size_t i, const unsigned char* vars,
+	unsigned char* stack) const
+{
+	const step* s = arena.data() + offsets[i];
+	const step* last = arena.data() + offsets[i + 1];
+	// one past the last value, so an empty stack is top == stack
+	unsigned char* top = stack;
+
+	if (s == last)
+		return false;
+
+	for (; s != last; ++s)
+	{
+		switch (s->code)
+		{
+		case step::op::ZERO: *top++ = 0; break;
+		case step::op::ONE: *top++ = 1; break;
+		case step::op::VARIABLE: *top++ = vars[s->arg]; break;
+		case step::op::NOT: top[-1] ^= 1; break;
+		case step::op::AND: top--; top[-1] &= *top; break;
+		case step::op::OR: top--; top[-1] |= *top; break;
+		case step::op::XOR: top--; top[-1] ^= *top; break;
+		}
+	}
+
+	return top[-1];
+}
+
+/* public */
+
+boolCorpus boolCorpus::from_file(const std::string& path, unsigned threads)
+{
+#ifdef TECAF_MMAP
+	int fd = ::open(path.c_str(), O_RDONLY);
+	struct stat info;
+
+	if (fd < 0 || ::fstat(fd, &info) != 0)
+	{
+		if (fd >= 0) ::close(fd);
+		throw std::runtime_error("Could not open " + path + "\n");
+	}
+
+	if (info.st_size == 0)
+	{
+		::close(fd);
+		return boolCorpus();
+	}
+
+	void* map = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (map == MAP_FAILED)
+		throw std::runtime_error("Could not map " + path + "\n");
+
+	struct unmapper
+	{
+		void* p;
+		std::size_t n;
+		~unmapper() { ::munmap(p, n); }
+	} unmap{ map, static_cast<std::size_t>(info.st_size) };
+
+	return boolCorpus(std::string_view(static_cast<const char*>(map),
+		unmap.n), threads);
+#else
+	std::FILE* in = std::fopen(path.c_str(), "rb");
+	std::string text;
+	char buffer[1 << 16];
+	std::size_t n;
+
+	if (!in)
+		throw std::runtime_error("Could not open " + path + "\n");
+
+	while ((n = std::fread(buffer, 1, sizeof buffer, in)) > 0)
+		text.append(buffer, n);
+	std::fclose(in);
+
+	return boolCorpus(text, threads);
+#endif
+}
+
+// every block is a whole number of result words, so no two threads write
+//	the same word
+const std::vector<std::uint64_t>& boolCorpus::evaluate(
+	const std::map<std::string, bool>& bindings, unsigned threads)
+{
+	const std::size_t n = size();
+	std::vector<unsigned char> vars(names.size());
+
+	for (std::size_t j = 0; j < names.size(); j++)
+	{
+		auto found = bindings.find(names[j]);
+		if (found == bindings.end())
+			throw std::invalid_argument(names[j] + " is not bound\n");
+		vars[j] = found->second;
+	}
+
+	results.assign((n + 63) / 64, 0);
+
+	parallel((n + BLOCK - 1) / BLOCK, threads, [&](std::size_t b)
+		{
+			std::vector<unsigned char> stack(depth + 1);
+			const std::size_t last = std::min(n, (b + 1) * BLOCK);
+			std::uint64_t word;
+
+			for (std::size_t w = b * BLOCK; w < last; w += 64)
+			{
+				word = 0;
+				for (std::size_t i = w; i < std::min(last, w + 64); i++)
+					word |= std::uint64_t(run(i, vars.data(), stack.data()))
+						<< (i - w);
+				results[w / 64] = word;
+			}
+		});
+
+	return results;
+}
@@ -0,0 +1,604 @@
+#pragma once
+
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "bdd.hpp"
+
+
+/* classes */
+
+/* sopCover */
+
+// purpose: a boolean function as a sum of products, i.e. an OR of cubes that
+//	are each an AND of literals, built as small as the method allows
+// invariants: there are at most 64 variables, variable j is bit j of a cube
+// data members:
+//	'terms' holds the cubes of the cover
+class sopCover
+{
+public:
+		/* prerequisites */
+
+	// the literals of a cube, variable j appears when bit j of 'care' is set
+	//	and is then negated when bit j of 'bits' is clear
+	struct cube
+	{
+		std::uint64_t care;
+		std::uint64_t bits;
+	};
+
+	// the most variables the exact method is used for
+	static constexpr std::size_t EXACT = 10;
+
+private:
+		/* prerequisites */
+
+	// the most search nodes of the exact cover, and the most cubes the
+	//	heuristic starts from
+	static constexpr std::size_t NODES = 20000;
+
+	static constexpr std::size_t PATHS = std::size_t(1) << 14;
+
+		/* member variables */
+
+	std::vector<cube> terms;
+
+		/* member functions */
+
+	// purpose: checks whether one cube holds another
+	// requires: the larger and the smaller cube
+	// returns: a bool
+	static bool contains(const cube& a, const cube& b)
+	{
+		return (a.care & ~b.care) == 0 && ((a.bits ^ b.bits) & a.care) == 0;
+	}
+
+	// purpose: checks whether a cube lies inside a diagram's function
+	// requires: the manager, the diagram and the cube
+	// returns: a bool
+	static bool implies(const bddManager&, std::uint32_t, const cube&);
+
+	// purpose: builds the diagram of a cube
+	// requires: the manager and the cube
+	// returns: a node id
+	static std::uint32_t to_bdd(bddManager&, const cube&);
+
+	// purpose: adds Minato and Morreale's irredundant sum of products of a
+	//	function between two bounds, each cube ANDed with a prefix
+	// requires: the manager, the level of each variable, the lower and upper
+	//	bound, the prefix and a node id to hold the diagram of the cover
+	// returns: false when the cover grew past PATHS cubes
+	bool isop(bddManager&, const std::vector<std::uint32_t>&, std::uint32_t,
+		std::uint32_t, cube, std::uint32_t&);
+
+	// purpose: drops literals of every cube while it stays inside the
+	//	function, then drops the cubes a larger one holds
+	// requires: the manager and the function
+	// returns: nothing
+	void expand(const bddManager&, std::uint32_t);
+
+	// purpose: drops the cubes the others cover
+	// requires: the manager
+	// returns: nothing
+	void irredundant(bddManager&);
+
+	// purpose: shrinks every cube to the smallest one holding what only it
+	//	covers, so the next expansion can grow it another way
+	// requires: the manager and the number of variables
+	// returns: nothing
+	void reduce(bddManager&, std::size_t);
+
+public:
+
+		/* member functions */
+
+	// purpose: finds a smallest cover with Quine and McCluskey's method,
+	//	every prime implicant is generated and the fewest primes, then the
+	//	fewest literals, covering the function are chosen by branch and bound
+	// requires: a truth table as returned by boolExp::truth_table and the
+	//	number of variables, at most EXACT
+	// returns: a cover, the best one found when the search gives up
+	static sopCover exact(const std::vector<std::uint64_t>&, std::size_t);
+
+	// purpose: finds a small cover with the reduce, expand and irredundant
+	//	loop of Espresso, starting from an irredundant cover of a diagram
+	// requires: the manager, the diagram and the number of variables, at
+	//	most 64, variable j of a cube is variable j of the manager
+	// returns: a cover, or nothing when the starting cover is too large
+	static std::optional<sopCover> heuristic(bddManager&, std::uint32_t,
+		std::size_t);
+
+	// purpose: finds the cubes
+	// requires: nothing
+	// returns: the cubes
+	const std::vector<cube>& cubes() const { return terms; }
+
+	// purpose: counts the literals of the cover
+	// requires: nothing
+	// returns: a size
+	std::size_t literals() const;
+
+	// purpose: writes the cover as an infix expression
+	// requires: the name of every variable
+	// returns: a string, "0" for the empty cover
+	std::string to_infix(const std::vector<std::string>&) const;
+
+};
+
+
+	/* methods */
+
+/* private */
+
+// the cube fixes some variables, so below it the diagram must be true on
+//	every path, which is decided once per node
+bool sopCover::implies(const bddManager& mgr, std::uint32_t f, const cube& c)
+{
+	std::unordered_map<std::uint32_t, bool> memo;
+
+	auto walk = [&](auto& self, std::uint32_t g) -> bool
+		{
+			if (g < 2)
+				return g == 1;
+
+			auto it = memo.find(g);
+			if (it != memo.end())
+				return it->second;
+
+			const bddManager::node& n = mgr.at(g);
+			const std::uint64_t bit = std::uint64_t(1) << n.var;
+			bool holds;
+
+			if (c.care & bit)
+				holds = self(self, (c.bits & bit) ? n.hi : n.lo);
+			else
+				holds = self(self, n.lo) && self(self, n.hi);
+
+			return memo[g] = holds;
+		};
+
+	return walk(walk, f);
+}
+
+std::uint32_t sopCover::to_bdd(bddManager& mgr, const cube& c)
+{
+	std::uint32_t f = 1;
+	std::uint64_t left = c.care;
+	std::uint32_t v;
+
+	while (left)
+	{
+		v = static_cast<std::uint32_t>(std::countr_zero(left));
+		left &= left - 1;
+		f = mgr.apply(bddManager::op::AND, f, (c.bits >> v & 1)
+			? mgr.make(v, 0, 1) : mgr.make(v, 1, 0));
+	}
+
+	return f;
+}
+
+// the cubes of the top variable's two cofactors are found first, then
+//	the cubes free of it cover what they left between the bounds
+bool sopCover::isop(bddManager& mgr, const std::vector<std::uint32_t>& level,
+	std::uint32_t lo, std::uint32_t hi, cube prefix, std::uint32_t& f)
+{
+	std::uint32_t v, l0, l1, h0, h1, f0, f1, rest;
+
+	if (lo == 0)
+	{
+		f = 0;
+		return true;
+	}
+	else if (hi == 1)
+	{
+		if (terms.size() == PATHS)
+			return false;
+		terms.push_back(prefix);
+		f = 1;
+		return true;
+	}
+
+	// lo is neither false nor true here, and hi holds it, so neither bound
+	//	is a constant
+	v = (level[mgr.at(lo).var] < level[mgr.at(hi).var]) ? mgr.at(lo).var
+		: mgr.at(hi).var;
+	const std::uint64_t bit = std::uint64_t(1) << v;
+
+	auto cofactor = [&mgr, v](std::uint32_t g, bool high)
+		{ return (g < 2 || mgr.at(g).var != v) ? g
+			: high ? mgr.at(g).hi : mgr.at(g).lo; };
+
+	l0 = cofactor(lo, false);
+	l1 = cofactor(lo, true);
+	h0 = cofactor(hi, false);
+	h1 = cofactor(hi, true);
+
+	if (!isop(mgr, level, mgr.apply(bddManager::op::AND, l0, mgr.negate(h1)),
+		h0, cube{ prefix.care | bit, prefix.bits }, f0))
+		return false;
+	if (!isop(mgr, level, mgr.apply(bddManager::op::AND, l1, mgr.negate(h0)),
+		h1, cube{ prefix.care | bit, prefix.bits | bit }, f1))
+		return false;
+
+	rest = mgr.apply(bddManager::op::OR,
+		mgr.apply(bddManager::op::AND, l0, mgr.negate(f0)),
+		mgr.apply(bddManager::op::AND, l1, mgr.negate(f1)));
+	if (!isop(mgr, level, rest, mgr.apply(bddManager::op::AND, h0, h1),
+		prefix, f))
+		return false;
+
+	f = mgr.apply(bddManager::op::OR, mgr.make(v, f0, f1), f);
+	return true;
+}
+
+// the largest cubes are expanded first, they are the likeliest to swallow
+//	the others
+void sopCover::expand(const bddManager& mgr, std::uint32_t f)
+{
+	std::vector<cube> grown;
+	std::uint64_t left, bit;
+
+	std::stable_sort(terms.begin(), terms.end(), [](const cube& a,
+		const cube& b) { return std::popcount(a.care) < std::popcount(b.care); });
+
+	for (cube c : terms)
+	{
+		if (std::any_of(grown.begin(), grown.end(),
+			[&c](const cube& g) { return contains(g, c); }))
+			continue;
+
+		for (left = c.care; left; left &= left - 1)
+		{
+			bit = left & (~left + 1);
+			const cube wider{ c.care & ~bit, c.bits & ~bit };
+			if (implies(mgr, f, wider))
+				c = wider;
+		}
+
+		grown.erase(std::remove_if(grown.begin(), grown.end(),
+			[&c](const cube& g) { return contains(c, g); }), grown.end());
+		grown.push_back(c);
+	}
+
+	terms = std::move(grown);
+}
+
+// the cubes with the most literals go first, 'after' holds the union of the
+//	cubes not decided yet and 'kept_f' of those kept so far
+void sopCover::irredundant(bddManager& mgr)
+{
+	const std::size_t m = terms.size();
+	std::vector<std::uint32_t> after(m + 1, 0);
+	std::vector<cube> kept;
+	std::uint32_t kept_f = 0, rest, own;
+
+	std::stable_sort(terms.begin(), terms.end(), [](const cube& a,
+		const cube& b) { return std::popcount(a.care) > std::popcount(b.care); });
+
+	for (std::size_t i = m; i-- > 0;)
+		after[i] = mgr.apply(bddManager::op::OR, after[i + 1],
+			to_bdd(mgr, terms[i]));
+
+	for (std::size_t i = 0; i < m; i++)
+	{
+		rest = mgr.apply(bddManager::op::OR, kept_f, after[i + 1]);
+		if (implies(mgr, rest, terms[i]))
+			continue;
+
+		own = to_bdd(mgr, terms[i]);
+		kept_f = mgr.apply(bddManager::op::OR, kept_f, own);
+		kept.push_back(terms[i]);
+	}
+
+	terms = std::move(kept);
+}
+
+// the part only a cube covers is found on the diagrams, then the cube keeps
+//	the free variables that part does not pin
+void sopCover::reduce(bddManager& mgr, std::size_t n)
+{
+	const std::size_t m = terms.size();
+	std::vector<std::uint32_t> after(m + 1, 0);
+	std::vector<cube> reduced;
+	std::uint32_t done = 0, own, lit;
+	std::uint64_t bit;
+
+	for (std::size_t i = m; i-- > 0;)
+		after[i] = mgr.apply(bddManager::op::OR, after[i + 1],
+			to_bdd(mgr, terms[i]));
+
+	for (std::size_t i = 0; i < m; i++)
+	{
+		cube c = terms[i];
+		own = mgr.apply(bddManager::op::AND, to_bdd(mgr, c), mgr.negate(
+			mgr.apply(bddManager::op::OR, done, after[i + 1])));
+
+		if (own == 0)
+			continue;
+
+		for (std::uint32_t v = 0; v < n; v++)
+		{
+			bit = std::uint64_t(1) << v;
+			if (c.care & bit)
+				continue;
+
+			lit = mgr.make(v, 1, 0);
+			if (mgr.apply(bddManager::op::AND, own, lit) == 0)
+				c = cube{ c.care | bit, c.bits | bit };
+			else if (mgr.apply(bddManager::op::AND, own, mgr.negate(lit)) == 0)
+				c = cube{ c.care | bit, c.bits };
+		}
+
+		done = mgr.apply(bddManager::op::OR, done, to_bdd(mgr, c));
+		reduced.push_back(c);
+	}
+
+	terms = std::move(reduced);
+}
+
+/* public */
+
+// an implicant is prime when no neighbour with the same free variables
+//	is an implicant too, and every implicant with k free variables is made by
+//	merging two with k - 1, so the levels are built bottom up
+sopCover sopCover::exact(const std::vector<std::uint64_t>& table,
+	std::size_t n)
+{
+	const std::uint64_t full = (std::uint64_t(1) << n) - 1;
+	const std::uint64_t weight = n + 1;
+	std::vector<std::uint32_t> minterms, chosen, best;
+	std::vector<int> slot(std::size_t(1) << n, -1);
+	std::unordered_set<std::uint64_t> level, next;
+	std::vector<cube> primes;
+	std::uint64_t best_cost = UINT64_MAX, bit;
+	std::size_t nodes = 0;
+	sopCover cover;
+
+	for (std::uint32_t i = 0; i < (std::uint32_t(1) << n); i++)
+		if (table[i / 64] >> (i % 64) & 1)
+		{
+			slot[i] = static_cast<int>(minterms.size());
+			minterms.push_back(i);
+		}
+
+	if (minterms.empty())
+		return cover;
+	else if (minterms.size() == slot.size())
+	{
+		cover.terms.push_back(cube{ 0, 0 });
+		return cover;
+	}
+
+	auto pack = [](std::uint64_t care, std::uint64_t bits)
+		{ return care << 32 | bits; };
+
+	for (std::uint32_t m : minterms)
+		level.insert(pack(full, m));
+
+	while (!level.empty())
+	{
+		next.clear();
+		for (std::uint64_t key : level)
+		{
+			const std::uint64_t care = key >> 32, bits = key & 0xffffffff;
+			bool merged = false;
+
+			for (std::uint64_t left = care; left; left &= left - 1)
+			{
+				bit = left & (~left + 1);
+				if (level.count(pack(care, bits ^ bit)))
+				{
+					merged = true;
+					next.insert(pack(care & ~bit, bits & ~bit));
+				}
+			}
+
+			if (!merged)
+				primes.push_back(cube{ care, bits });
+		}
+		std::swap(level, next);
+	}
+
+	// which primes cover each minterm, as bitsets over the minterms
+	const std::size_t words = (minterms.size() + 63) / 64;
+	std::vector<std::vector<std::uint64_t>> covers(primes.size(),
+		std::vector<std::uint64_t>(words));
+	std::vector<std::vector<std::uint32_t>> by_minterm(minterms.size());
+
+	for (std::uint32_t p = 0; p < primes.size(); p++)
+	{
+		const std::uint64_t free = full & ~primes[p].care;
+		std::uint64_t s = free;
+
+		do
+		{
+			const int j = slot[primes[p].bits | s];
+			covers[p][j / 64] |= std::uint64_t(1) << (j % 64);
+			by_minterm[j].push_back(p);
+			s = (s - 1) & free;
+		} while (s != free);
+	}
+
+	auto cost_of = [&](std::uint32_t p)
+		{ return weight + std::popcount(primes[p].care); };
+
+	// a greedy cover bounds the search from the start
+	std::vector<std::uint64_t> uncovered(words, ~std::uint64_t(0));
+	if (minterms.size() % 64)
+		uncovered.back() = (std::uint64_t(1) << (minterms.size() % 64)) - 1;
+
+	{
+		std::vector<std::uint64_t> open = uncovered;
+		std::uint64_t total = 0;
+
+		while (std::any_of(open.begin(), open.end(),
+			[](std::uint64_t w) { return w != 0; }))
+		{
+			std::uint32_t pick = 0;
+			double score = -1;
+
+			for (std::uint32_t p = 0; p < primes.size(); p++)
+			{
+				std::size_t gain = 0;
+				for (std::size_t w = 0; w < words; w++)
+					gain += std::popcount(open[w] & covers[p][w]);
+				if (gain && double(gain) / cost_of(p) > score)
+				{
+					score = double(gain) / cost_of(p);
+					pick = p;
+				}
+			}
+
+			for (std::size_t w = 0; w < words; w++)
+				open[w] &= ~covers[pick][w];
+			best.push_back(pick);
+			total += cost_of(pick);
+		}
+
+		best_cost = total;
+	}
+
+	// branches on the uncovered minterm with the fewest primes, so
+	//	essential primes are taken without branching
+	auto branch = [&](auto& self, const std::vector<std::uint64_t>& open,
+		std::uint64_t cost) -> void
+		{
+			std::size_t target = SIZE_MAX, fewest = SIZE_MAX;
+
+			if (++nodes > NODES)
+				return;
+
+			for (std::size_t w = 0; w < words; w++)
+				for (std::uint64_t left = open[w]; left; left &= left - 1)
+				{
+					const std::size_t j = 64 * w + std::countr_zero(left);
+					if (by_minterm[j].size() < fewest)
+					{
+						fewest = by_minterm[j].size();
+						target = j;
+					}
+				}
+
+			if (target == SIZE_MAX)
+			{
+				if (cost < best_cost)
+				{
+					best_cost = cost;
+					best = chosen;
+				}
+				return;
+			}
+
+			std::vector<std::uint64_t> rest(words);
+			for (std::uint32_t p : by_minterm[target])
+			{
+				if (cost + cost_of(p) >= best_cost)
+					continue;
+
+				for (std::size_t w = 0; w < words; w++)
+					rest[w] = open[w] & ~covers[p][w];
+
+				chosen.push_back(p);
+				self(self, rest, cost + cost_of(p));
+				chosen.pop_back();
+			}
+		};
+
+	branch(branch, uncovered, 0);
+
+	for (std::uint32_t p : best)
+		cover.terms.push_back(primes[p]);
+
+	return cover;
+}
+
+std::optional<sopCover> sopCover::heuristic(bddManager& mgr,
+	std::uint32_t f, std::size_t n)
+{
+	std::vector<std::uint32_t> level(mgr.variables().size());
+	std::size_t cost, best_cost;
+	std::uint32_t g;
+	sopCover cover, best;
+
+	for (std::uint32_t i = 0; i < level.size(); i++)
+		level[mgr.variable_order()[i]] = i;
+
+	if (!cover.isop(mgr, level, f, f, cube{ 0, 0 }, g))
+		return std::nullopt;
+
+	auto measure = [](const sopCover& s)
+		{ return s.terms.size() * 65 + s.literals(); };
+
+	cover.expand(mgr, f);
+	cover.irredundant(mgr);
+	best = cover;
+	best_cost = measure(cover);
+
+	for (;;)
+	{
+		cover.reduce(mgr, n);
+		cover.expand(mgr, f);
+		cover.irredundant(mgr);
+
+		cost = measure(cover);
+		if (cost >= best_cost)
+			break;
+		best = cover;
+		best_cost = cost;
+	}
+
+	return best;
+}
+
+std::size_t sopCover::literals() const
+{
+	std::size_t total = 0;
+
+	for (const cube& c : terms)
+		total += std::popcount(c.care);
+
+	return total;
+}
+
+// AND binds tighter than OR, so no parentheses are needed
+std::string sopCover::to_infix(const std::vector<std::string>& names) const
+{
+	std::string out;
+	std::uint64_t left;
+	std::uint32_t v;
+
+	if (terms.empty())
+		return "0";
+
+	for (std::size_t i = 0; i < terms.size(); i++)
+	{
+		if (i > 0)
+			out += '|';
+		if (terms[i].care == 0)
+		{
+			out += '1';
+			continue;
+		}
+
+		for (left = terms[i].care; left; left &= left - 1)
+		{
+			v = static_cast<std::uint32_t>(std::countr_zero(left));
+			if (left != terms[i].care)
+				out += '&';
+			if (!(terms[i].bits >> v & 1))
+				out += '~';
+			out += names[v];
+		}
+	}
+
+	return out;
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/* classes */
+
+/* exprDag */
+
+// purpose: a hash-consed store of compiled expressions, every distinct
+//	subexpression of every expression interned into it is held once
+// invariants: 'Step' has an 'op' enum with a VARIABLE code, members 'code'
+//	and 'arg', and arity() and commutative() const member functions; a node
+//	only points at nodes with smaller ids, so ids are a topological order;
+//	the operands of a commutative node are sorted; a store is not thread safe
+// data members:
+//	'nodes' holds every node, 'unique' maps a node back to its id
+//	'names' holds the variables of every expression, 'ids' maps a name back
+//	to its index, the 'arg' of a VARIABLE node is that index
+template <class Step>
+class exprDag
+{
+public:
+		/* prerequisites */
+
+	// one step with the ids of its operands, NONE where there is no operand
+	struct node
+	{
+		Step step;
+		std::uint32_t left;
+		std::uint32_t right;
+	};
+
+	static constexpr std::uint32_t NONE = UINT32_MAX;
+
+private:
+		/* prerequisites */
+
+	struct key
+	{
+		std::uint64_t head;
+		std::uint64_t tail;
+
+		bool operator==(const key& other) const
+		{ return head == other.head && tail == other.tail; }
+	};
+
+	struct hasher
+	{
+		std::size_t operator()(const key& k) const
+		{
+			std::uint64_t h = k.head * 0x9e3779b97f4a7c15ull ^ k.tail;
+			h ^= h >> 29;
+			h *= 0xbf58476d1ce4e5b9ull;
+			return static_cast<std::size_t>(h ^ (h >> 32));
+		}
+	};
+
+		/* member variables */
+
+	std::vector<node> nodes;
+
+	std::unordered_map<key, std::uint32_t, hasher> unique;
+
+	std::vector<std::string> names;
+
+	std::unordered_map<std::string, std::uint32_t> ids;
+
+		/* member functions */
+
+	// purpose: finds or creates a node
+	// requires: the step and the ids of its operands
+	// returns: a node id
+	std::uint32_t make(Step, std::uint32_t, std::uint32_t);
+
+public:
+
+		/* member functions */
+
+	// purpose: finds a variable, creating it on first use
+	// requires: a name
+	// returns: the index of the variable
+	std::uint32_t variable(const std::string&);
+
+	// purpose: finds the variables
+	// requires: nothing
+	// returns: the names, by index
+	const std::vector<std::string>& variables() const { return names; }
+
+	// purpose: adds a compiled expression, sharing every subexpression the
+	//	store already holds
+	// requires: the steps in postfix order and the names their VARIABLE
+	//	steps index
+	// returns: the id of the root, equal to the root of any structurally
+	//	equal expression up to the order of commutative operands
+	std::uint32_t intern(const std::vector<Step>&,
+		const std::vector<std::string>&);
+
+	// purpose: finds a node
+	// requires: a node id
+	// returns: the node
+	const node& at(std::uint32_t id) const { return nodes[id]; }
+
+	// purpose: counts the nodes
+	// requires: nothing
+	// returns: a size
+	std::size_t size() const { return nodes.size(); }
+
+	// purpose: finds the nodes some roots need
+	// requires: the roots
+	// returns: the ids, ascending, so operands come before their users
+	std::vector<std::uint32_t> schedule(const std::vector<std::uint32_t>&)
+		const;
+
+	// purpose: evaluates many roots on many inputs, a node shared by several
+	//	roots is evaluated once per input
+	// requires: the roots; 'count' values per variable of the store, variable
+	//	v in [v * count, v * count + count); the count; room for 'count' values
+	//	per root laid out alike; and a kernel Value(const Step&, Value, Value)
+	//	for every step but VARIABLE, given default values for missing operands
+	// returns: nothing, but fills the outputs
+	template <class Value, class Kernel>
+	void evaluate(const std::vector<std::uint32_t>&, const Value*,
+		std::size_t, Value*, Kernel) const;
+
+};
+
+
+	/* methods */
+
+/* private */
+
+template <class Step>
+std::uint32_t exprDag<Step>::make(Step s, std::uint32_t left,
+	std::uint32_t right)
+{
+	if (s.commutative() && right < left)
+		std::swap(left, right);
+
+	const key k{ (std::uint64_t(s.code) << 32) | s.arg,
+		(std::uint64_t(left) << 32) | right };
+
+	auto found = unique.find(k);
+	if (found != unique.end())
+		return found->second;
+
+	const std::uint32_t id = static_cast<std::uint32_t>(nodes.size());
+	nodes.push_back(node{ s, left, right });
+	unique.emplace(k, id);
+
+	return id;
+}
+
+/* public */
+
+template <class Step>
+std::uint32_t exprDag<Step>::variable(const std::string& name)
+{
+	auto found = ids.find(name);
+	if (found != ids.end())
+		return found->second;
+
+	const std::uint32_t v = static_cast<std::uint32_t>(names.size());
+	names.push_back(name);
+	ids.emplace(name, v);
+
+	return v;
+}
+
+// the steps are replayed on a stack of node ids, a variable's index in the
+//	expression is swapped for its index in the store
+template <class Step>
+std::uint32_t exprDag<Step>::intern(const std::vector<Step>& program,
+	const std::vector<std::string>& vars)
+{
+	std::vector<std::uint32_t> local(vars.size()), stack;
+	std::uint32_t left, right;
+
+	for (std::size_t i = 0; i < vars.size(); i++)
+		local[i] = variable(vars[i]);
+
+	for (Step s : program)
+	{
+		left = right = NONE;
+
+		if (s.code == Step::op::VARIABLE)
+			s.arg = local[s.arg];
+		else if (s.arity() == 2)
+		{
+			right = stack.back();
+			stack.pop_back();
+			left = stack.back();
+			stack.pop_back();
+		}
+		else if (s.arity() == 1)
+		{
+			left = stack.back();
+			stack.pop_back();
+		}
+
+		stack.push_back(make(s, left, right));
+	}
+
+	if (stack.size() != 1)
+		throw std::invalid_argument("Only a whole expression can be"
+			" interned\n");
+
+	return stack.back();
+}
+
+template <class Step>
+std::vector<std::uint32_t> exprDag<Step>::schedule
+(const std::vector<std::uint32_t>& roots) const
+{
+	std::vector<char> needed(nodes.size());
+	std::vector<std::uint32_t> order;
+	std::uint32_t top = 0;
+
+	for (std::uint32_t r : roots)
+	{
+		needed[r] = 1;
+		top = std::max(top, r + 1);
+	}
+
+	// operands have smaller ids, so one downward sweep marks them all
+	for (std::uint32_t id = top; id-- > 0;)
+		if (needed[id])
+		{
+			if (nodes[id].left != NONE)
+				needed[nodes[id].left] = 1;
+			if (nodes[id].right != NONE)
+				needed[nodes[id].right] = 1;
+		}
+
+	for (std::uint32_t id = 0; id < top; id++)
+		if (needed[id])
+			order.push_back(id);
+
+	return order;
+}
+
+// the needed nodes are copied into a compact program whose operands index
+//	its own value array, which is then swept once per input
+template <class Step>
+template <class Value, class Kernel>
+void exprDag<Step>::evaluate(const std::vector<std::uint32_t>& roots,
+	const Value* vars, std::size_t count, Value* out, Kernel kernel) const
+{
+	const std::vector<std::uint32_t> order = schedule(roots);
+	std::vector<std::uint32_t> slot(order.empty() ? 0 : order.back() + 1);
+	std::vector<node> compact(order.size());
+	std::vector<Value> values(order.size());
+
+	for (std::uint32_t k = 0; k < order.size(); k++)
+	{
+		const node& n = nodes[order[k]];
+		slot[order[k]] = k;
+		compact[k] = node{ n.step, (n.left == NONE) ? NONE : slot[n.left],
+			(n.right == NONE) ? NONE : slot[n.right] };
+	}
+
+	for (std::size_t i = 0; i < count; i++)
+	{
+		for (std::size_t k = 0; k < compact.size(); k++)
+		{
+			const node& n = compact[k];
+
+			if (n.step.code == Step::op::VARIABLE)
+				values[k] = vars[n.step.arg * count + i];
+			else
+				values[k] = kernel(n.step,
+					(n.left == NONE) ? Value() : values[n.left],
+					(n.right == NONE) ? Value() : values[n.right]);
+		}
+
+		for (std::size_t r = 0; r < roots.size(); r++)
+			out[r * count + i] = values[slot[roots[r]]];
+	}
+}
@@ -3,16 +3,22 @@
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <iostream>
 #include <map>
+#include <optional>
+#include <span>
 #include <sstream>
-#include <stack>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "vm.hpp"
+
 
-using std::stack;
 using std::string;
 
 
@@ -26,13 +32,353 @@ bool isNumber(const std::string&);
 
 /* classes */
 
+/* parsing */
+
+// the notations an expression can be written in
+enum class notation { INFIX, PREFIX, POSTFIX };
+
+// purpose: describes one operator of a grammar
+// data members:
+//	'symbol' is how the operator is written in infix
+//	'code' is how it is written in postfix and prefix, unary minus is written
+//	'-' in infix but '~' in postfix so the two minuses stay apart
+//	'arity' is 1 for a prefix operator and 2 for a binary one
+//	'precedence' is higher for operators that bind tighter
+//	'right' is true for right associative binary operators
+//	'kernel' is the operation of the virtual machine that applies it, so the
+//	operator runs through exprKernel with no lookup at run time
+struct opInfo
+{
+	char symbol;
+	char code;
+	unsigned char arity;
+	unsigned short precedence;
+	bool right;
+	vmOp kernel;
+};
+
+// purpose: describes one function of a grammar, e.g. sin
+// data members:
+//	'name' is the name it is called by
+//	'arity' is the number of arguments it takes
+//	'kernel' is the operation of the virtual machine that applies it
+struct fnInfo
+{
+	std::string_view name;
+	unsigned char arity;
+	vmOp kernel;
+};
+
+// purpose: describes what the parser accepts for one kind of expression
+// data members:
+//	'operators' are the operators, one entry per arity of a symbol
+//	'functions' are the functions that can be called
+//	'bits' is true when the only literals are the single digits 0 and 1, so
+//	"10|" reads as 1 0 |, otherwise literals are decimal numbers
+//	'names' is true when variables are allowed
+struct grammar
+{
+	std::span<const opInfo> operators;
+	std::span<const fnInfo> functions;
+	bool bits;
+	bool names;
+
+	// purpose: checks the tables, meant for a static_assert next to them
+	// requires: the type of value the kernels run on
+	// returns: true when every kernel takes as many operands as its
+	//	operator or function and exprKernel<adt> has it, and no two
+	//	operators share a symbol and an arity or a code
+	template <typename adt>
+	constexpr bool consistent() const
+	{
+		for (std::size_t i = 0; i < operators.size(); i++)
+		{
+			if (vmArity(operators[i].kernel) != operators[i].arity
+				|| !exprKernel<adt>::has(operators[i].kernel))
+				return false;
+			for (std::size_t j = 0; j < i; j++)
+				if (operators[j].code == operators[i].code
+					|| (operators[j].symbol == operators[i].symbol
+					&& operators[j].arity == operators[i].arity))
+					return false;
+		}
+		for (const fnInfo& fn : functions)
+			if (vmArity(fn.kernel) != fn.arity
+				|| !exprKernel<adt>::has(fn.kernel))
+				return false;
+
+		return true;
+	}
+};
+
+// purpose: one token of a parsed expression
+// invariants: the text of the token is the source from 'pos' to
+//	'pos + len', so tokens never copy the source
+// data members:
+//	'type' is what the token is
+//	'code' is the postfix spelling of an operator
+//	'index' is the entry of an operator or a function in its grammar table
+//	'pos' and 'len' locate the token in the source
+struct exprToken
+{
+	enum class kind : std::uint8_t { VALUE, NAME, CALL, UNARY, BINARY };
+
+	kind type;
+	char code;
+	std::uint16_t index;
+	std::uint32_t pos;
+	std::uint32_t len;
+};
+
+// purpose: the text of an expression literal, held by value so a string
+//	literal can be a template argument
+// data members:
+//	'text' is the characters, with the terminating null
+template <std::size_t N>
+struct exprText
+{
+	char text[N];
+
+	consteval exprText(const char (&s)[N])
+	{
+		for (std::size_t i = 0; i < N; i++)
+			text[i] = s[i];
+	}
+
+	// purpose: views the text
+	// requires: nothing
+	// returns: a string_view, without the null
+	constexpr std::string_view view() const { return { text, N - 1 }; }
+};
+
+// purpose: why an expression could not be parsed or evaluated, small enough
+//	to return by value so a failure costs no allocation and no exception
+// data members:
+//	'type' is what went wrong, NONE when nothing did
+//	'pos' and 'len' locate the offending text in the source, except for
+//	UNBOUND where 'pos' is the index of the variable
+struct exprError
+{
+	enum class kind : std::uint8_t
+	{
+		NONE, BAD_CHARACTER, EXPECTED_OPERAND, EXPECTED_OPERATOR,
+		EXPECTED_BINARY, EXPECTED_CALL, EXPECTED_END, UNMATCHED_OPEN,
+		UNMATCHED_CLOSE, STRAY_COMMA, ARGUMENTS, NAMES, PARENTHESES,
+		MISSING_OPERAND, MISSING_OPERATOR, TOO_LONG, BAD_FORMAT, UNBOUND
+	};
+
+	kind type = kind::NONE;
+	std::uint32_t pos = 0;
+	std::uint32_t len = 0;
+
+	// true when something went wrong
+	constexpr explicit operator bool() const { return type != kind::NONE; }
+};
+
+// purpose: a syntax error, with the offset in the source where it was found
+// data members:
+//	'where' is the offset of the offending character
+class parseError : public std::invalid_argument
+{
+private:
+	std::size_t where;
+
+public:
+	parseError(const std::string& message, std::size_t pos)
+		: std::invalid_argument(message + " at position "
+			+ std::to_string(pos) + "\n"), where(pos) {}
+
+	// purpose: finds where the error is
+	// requires: nothing
+	// returns: the offset in the source
+	std::size_t position() const { return where; }
+};
+
+// purpose: splits an expression into tokens in one pass over a string view
+// invariants: 'at' never moves backwards, and never past the end; the
+//	source is at most UINT32_MAX characters long
+// data members:
+//	'src' is the source being read
+//	'rules' is the grammar of the source
+//	'form' is the notation of the source, operators are read by symbol in
+//	infix and by code otherwise
+//	'at' is the offset of the next unread character
+class exprLexer
+{
+private:
+		/* member variables */
+
+	std::string_view src;
+
+	const grammar& rules;
+
+	notation form;
+
+	std::size_t at = 0;
+
+public:
+
+		/* prerequisites */
+
+	// what a lexeme is before the parser gives it a meaning
+	// INVALID is a character the grammar has no use for
+	enum class lexeme
+	{ END, VALUE, NAME, OPERATOR, OPEN, CLOSE, COMMA, INVALID };
+
+	// purpose: one lexeme and where it is
+	struct item
+	{
+		lexeme type;
+		std::size_t pos;
+		std::size_t len;
+	};
+
+		/* constructors */
+
+	// parametrized constructor
+	// takes the source, its grammar and its notation
+	constexpr exprLexer(std::string_view, const grammar&, notation);
+
+		/* member functions */
+
+	// purpose: reads the next lexeme
+	// requires: nothing
+	// returns: an item, END once the source is exhausted
+	constexpr item next();
+
+	// purpose: looks at the next lexeme without consuming it
+	// requires: nothing
+	// returns: an item
+	constexpr item peek();
+
+};
+
+// purpose: turns an expression in any notation into a postfix token buffer
+// invariants: the parser keeps no state between calls
+class exprParser
+{
+private:
+
+	// an entry of the operator stack, 'paren' is true for an open
+	//	parenthesis or call, 'args' counts the arguments of a call, or the
+	//	operands a prefix operator still needs
+	struct frame
+	{
+		exprToken tok;
+		bool paren;
+		std::size_t args;
+	};
+
+	// purpose: finds an operator of a grammar
+	// requires: the grammar, the character, whether it is a symbol or a code
+	//	and the arity, 0 for any
+	// returns: the index of the operator, or -1
+	static constexpr int find_operator(const grammar&, char, bool,
+		unsigned char);
+
+	// purpose: finds a function of a grammar
+	// requires: the grammar and the name
+	// returns: the index of the function, or -1
+	static constexpr int find_function(const grammar&, std::string_view);
+
+	// purpose: builds an error
+	// requires: its kind and where it is
+	// returns: an exprError
+	static constexpr exprError fail(exprError::kind, std::size_t, std::size_t);
+
+	// purpose: parses infix with Dijkstra's shunting yard algorithm
+	// requires: the source, its grammar and the buffer for the tokens
+	// returns: the first error, and fills the buffer with the postfix tokens
+	static constexpr exprError infix(std::string_view, const grammar&,
+		std::vector<exprToken>&);
+
+	// purpose: parses prefix, tracking how many operands each pending
+	//	operator still needs instead of recursing
+	// requires: the source, its grammar and the buffer for the tokens
+	// returns: the first error, and fills the buffer with the postfix tokens
+	static constexpr exprError prefix(std::string_view, const grammar&,
+		std::vector<exprToken>&);
+
+	// purpose: checks postfix, tracking the depth of the value stack
+	// requires: the source, its grammar and the buffer for the tokens
+	// returns: the first error, and fills the buffer with the postfix tokens
+	static constexpr exprError postfix(std::string_view, const grammar&,
+		std::vector<exprToken>&);
+
+public:
+
+		/* member functions */
+
+	// purpose: parses an expression without throwing, the buffer keeps its
+	//	capacity so a caller parsing many expressions allocates only while
+	//	the buffer grows
+	// requires: the source, its grammar, its notation and the buffer for
+	//	the tokens
+	// returns: the first error, NONE when the source parsed, and fills the
+	//	buffer with the tokens in postfix order, they refer into the source
+	static constexpr exprError try_parse(std::string_view, const grammar&,
+		notation, std::vector<exprToken>&);
+
+	// purpose: parses an expression
+	// requires: the source, its grammar and its notation
+	// returns: the tokens in postfix order, they refer into the source, or
+	//	throws a parseError
+	static std::vector<exprToken> parse(std::string_view, const grammar&,
+		notation);
+
+	// purpose: spells out an error, off the hot path
+	// requires: the error and the source it was found in
+	// returns: a string i.e. the message, without a position
+	static string describe(const exprError&, std::string_view);
+
+	// purpose: writes a token buffer back as text
+	// requires: the source the tokens refer to, and the tokens
+	// returns: a string i.e. the expression in postfix, tokens separated by
+	//	single spaces
+	static string write_postfix(std::string_view,
+		const std::vector<exprToken>&);
+
+	// purpose: writes a token buffer in infix, walking the tree the tokens
+	//	form once into a buffer sized up front, so the time is linear however
+	//	deep the tree is; binary operations are parenthesized, and so are
+	//	unary ones whose symbol is also a binary operator's
+	// requires: the source the tokens refer to, the tokens and their grammar
+	// returns: a string i.e. the expression in infix
+	static string write_infix(std::string_view, const std::vector<exprToken>&,
+		const grammar&);
+
+	// purpose: writes a token buffer in prefix, in linear time as well
+	// requires: the source the tokens refer to, the tokens and their grammar
+	// returns: a string i.e. the expression in prefix, tokens separated by
+	//	single spaces
+	static string write_prefix(std::string_view, const std::vector<exprToken>&,
+		const grammar&);
+
+	// purpose: reads a notation from its name without throwing
+	// requires: a name and the notation to set
+	// returns: false when the name is not "infix", "prefix" or "postfix"
+	static bool try_notation(std::string_view, notation&);
+
+	// purpose: reads a notation from its name
+	// requires: "infix", "prefix" or "postfix"
+	// returns: the notation
+	static notation to_notation(const string&);
+
+};
+
 /* Expression */
 
 // purpose: an abstract class that represents expressions
 // invariants: none
 // data members:
-//	'result' is a pointer to the expression's result
+//	'result' holds the expression's result once it has been evaluated
 //	'expression' is a string that represents the actual expression
+//	'infix_form' and 'prefix_form' cache its other notations
+//	'vm' is the expression compiled for the virtual machine, filled by the
+//	subclass as it compiles
+// the parsing, the conversions and the kernels all come from the grammar a
+//	subclass returns from syntax(), so a new kind of expression is a table
+//	of operators and, when the defaults do not fit, an exprKernel
 template <typename adt>
 class Expression
 {
@@ -40,67 +386,87 @@ protected:
 
 	/* member variables */
 
-// assigns importance to each operator
-	inline static const std::map<char, unsigned short> PEMDAS
-		= { {'(', 0}, {'|', 1}, {'&', 2}, {'^', 3}, {'~', 4},
-			{'+', 1}, {'-', 1}, {'*', 2}, {'/', 2} };
-
-	// the result of the expression
-	// nullptr means the expression has not been evaluated yet
-	adt* result = nullptr;
+	// the result of the expression, stored inline so copies never share it
+	// empty means the expression has not been evaluated since it changed
+	std::optional<adt> result;
 
 	// the expression in postfix notation
 	string expression;
 
+	// the expression in infix and prefix notation, converted on first use
+	// empty means it has not been converted since the expression changed
+	std::optional<string> infix_form;
+
+	std::optional<string> prefix_form;
+
+	// the expression compiled to opcodes, so every kind of expression runs
+	//	on the same interpreter
+	exprVM<adt> vm;
+
 	/* member functions */
 
-// purpose: helper function for Dijkstra's algorithm, compares the
-//	current operator with the stack wrt the order of operations and pushes
-//	them onto the string i.e. the postfix expression
-// requires: a char i.e. the operator, a stack that holds the current
-//	operators, and a string i.e. the postfix expression
-// returns: nothing, but pops elements onto the string
-	virtual void compareAndPush(const char&, stack<char>&, string&) = 0;
-
-	// purpose: evaluates an expression with two inputs
-	// requires: an array of two values to evaluate,
-	//	and a char i.e. the operator
-	// returns: an adt
-	virtual adt eval_simple_exp(
-		const std::array<adt, 2>&,
-		const char&
-	) const = 0;
-
-	// purpose: evaluates the top two values on a stack with a given operation
-	// requires: a stack of values and a char that represents the operation
-	// returns: nothing, but adjusts the stack
-	virtual void getAndEval(stack<adt>&, const char&) = 0;
+	// purpose: forgets the result and the converted notations, for when the
+	//	expression changes
+	// requires: nothing
+	// returns: nothing
+	void invalidate()
+	{
+		result.reset();
+		infix_form.reset();
+		prefix_form.reset();
+	}
+
+	// purpose: writes a parse error to std::cerr, for the members that
+	//	report errors instead of returning them
+	// requires: the error and the source it was found in
+	// returns: nothing
+	static void report(const exprError& e, std::string_view src)
+	{
+		std::cerr << exprParser::describe(e, src);
+		if (e.type != exprError::kind::BAD_FORMAT
+			&& e.type != exprError::kind::TOO_LONG)
+			std::cerr << " at position " << e.pos;
+		std::cerr << "\n";
+	}
+
+	// purpose: compiles parsed tokens for 'vm', every operator and function
+	//	through the kernel its grammar entry names
+	// requires: the source the tokens refer to, the tokens, and the vector
+	//	to fill with the variables
+	// returns: nothing, but replaces 'vm' and the variables, in order of
+	//	first use
+	void assemble(std::string_view, const std::vector<exprToken>&,
+		std::vector<string>&);
 
 	// purpose: converts an expression from infix to postfix notation
 	// requires: a string i.e. an expression in infix notation
 	// returns: a string i.e. an expression in postfix notation
-	virtual string infix_to_postfix(const string&) = 0;
+	string infix_to_postfix(const string&) const;
 
-	// purpose: converts an expression from postfix to infix notation
+	// purpose: converts an expression from postfix to infix notation,
+	//	parenthesizing every binary operation so it reads back the same
 	// requires: a string i.e. an expression in postfix notation
 	// returns: a string i.e. an expression in infix notation
-	virtual string postfix_to_infix(const string&) = 0;
+	string postfix_to_infix(const string&) const;
 
 	// purpose: converts an expression from postfix to prefix notation
 	// requires: a string i.e. an expression in postfix notation
 	// returns: a string i.e. an expression in prefix notation
-	virtual string postfix_to_prefix(const string&) = 0;
+	string postfix_to_prefix(const string&) const;
 
 	// purpose: converts an expression from prefix to postfix notation
 	// requires: a string i.e. an expression in prefix notation
 	// returns: a string i.e. an expression in postfix notation
-	virtual string prefix_to_postfix(const string&) = 0;
+	string prefix_to_postfix(const string&) const;
 
 public:
 
+	// the type of the result
+	typedef adt value_type;
+
 	/* destructor */
 
-	virtual ~Expression() { delete result; result = nullptr; }
+	virtual ~Expression() {}
 
 	/* member functions */
 
@@ -109,6 +475,17 @@ public:
 // returns: an adt i.e. the result
 	virtual adt evaluate() = 0;
 
+	// purpose: finds the compiled form of the expression
+	// requires: nothing
+	// returns: the machine, its variables are those of the subclass in
+	//	order of first use
+	const exprVM<adt>& compiled() const { return vm; }
+
+	// purpose: finds the grammar of the expression
+	// requires: nothing
+	// returns: the grammar, a constexpr table of the subclass
+	virtual const grammar& syntax() const = 0;
+
 	// purpose: gets the expression
 	// requires: can pass in "infix", "prefix", or "postfix" to get the
 	//	expression in one of those formats, by default "infix"
@@ -126,6 +503,754 @@ public:
 
 	/* definitions */
 
+		/* exprLexer */
+
+constexpr exprLexer::exprLexer(std::string_view source, const grammar& g,
+	notation n)
+	: src(source), rules(g), form(n) {}
+
+constexpr exprLexer::item exprLexer::next()
+{
+	item found = peek();
+
+	at = found.pos + found.len;
+	return found;
+}
+
+// scientific literals are read as digits [. digits] [e [+-] digits]
+constexpr exprLexer::item exprLexer::peek()
+{
+	std::size_t pos = at, end;
+	char c;
+
+	auto digit = [this](std::size_t i)
+		{
+			return i < src.size() && src[i] >= '0' && src[i] <= '9';
+		};
+	auto alpha = [this](std::size_t i)
+		{
+			return i < src.size() && ((src[i] >= 'a' && src[i] <= 'z')
+				|| (src[i] >= 'A' && src[i] <= 'Z') || src[i] == '_');
+		};
+
+	while (pos < src.size() && (src[pos] == ' ' || src[pos] == '\t'
+		|| src[pos] == '\n' || src[pos] == '\r'))
+		pos++;
+
+	if (pos == src.size())
+		return item{ lexeme::END, pos, 0 };
+
+	c = src[pos];
+	end = pos + 1;
+
+	if (rules.bits && (c == '0' || c == '1'))
+		return item{ lexeme::VALUE, pos, 1 };
+	else if (!rules.bits && (digit(pos) || (c == '.' && digit(pos + 1))))
+	{
+		end = pos;
+		while (digit(end)) end++;
+		if (end < src.size() && src[end] == '.')
+			for (end++; digit(end); end++);
+		if (end < src.size() && (src[end] == 'e' || src[end] == 'E'))
+		{
+			std::size_t exp = end + 1;
+			if (exp < src.size() && (src[exp] == '+' || src[exp] == '-'))
+				exp++;
+			if (digit(exp))
+				for (end = exp; digit(end); end++);
+		}
+		return item{ lexeme::VALUE, pos, end - pos };
+	}
+	else if (alpha(pos))
+	{
+		while (alpha(end) || digit(end)) end++;
+		return item{ lexeme::NAME, pos, end - pos };
+	}
+
+	switch (c)
+	{
+	case '(': return item{ lexeme::OPEN, pos, 1 };
+	case ')': return item{ lexeme::CLOSE, pos, 1 };
+	case ',': return item{ lexeme::COMMA, pos, 1 };
+	default: break;
+	}
+
+	for (const opInfo& op : rules.operators)
+		if ((form == notation::INFIX ? op.symbol : op.code) == c)
+			return item{ lexeme::OPERATOR, pos, 1 };
+
+	return item{ lexeme::INVALID, pos, 1 };
+}
+
+
+		/* exprParser */
+
+	/* private */
+
+constexpr int exprParser::find_operator(const grammar& g, char c, bool code,
+	unsigned char arity)
+{
+	for (std::size_t i = 0; i < g.operators.size(); i++)
+		if ((code ? g.operators[i].code : g.operators[i].symbol) == c
+			&& (arity == 0 || g.operators[i].arity == arity))
+			return static_cast<int>(i);
+
+	return -1;
+}
+
+constexpr int exprParser::find_function(const grammar& g,
+	std::string_view name)
+{
+	for (std::size_t i = 0; i < g.functions.size(); i++)
+		if (g.functions[i].name == name)
+			return static_cast<int>(i);
+
+	return -1;
+}
+
+constexpr exprError exprParser::fail(exprError::kind k, std::size_t pos,
+	std::size_t len)
+{
+	return exprError{ k, static_cast<std::uint32_t>(pos),
+		static_cast<std::uint32_t>(len) };
+}
+
+// the parser alternates between expecting an operand and expecting an
+//	operator, which is what tells a unary minus from a binary one
+constexpr exprError exprParser::infix(std::string_view src,
+	const grammar& g, std::vector<exprToken>& out)
+{
+	typedef exprLexer::lexeme lexeme;
+	typedef exprError::kind error;
+
+	exprLexer lex(src, g, notation::INFIX);
+	std::vector<frame> ops;
+	exprLexer::item it;
+	bool operand = true;
+	int found;
+
+	out.clear();
+	out.reserve(src.size() / 2 + 1);
+
+	// pops operators off the stack until an open parenthesis
+	auto unwind = [&out, &ops]()
+		{
+			while (!ops.empty() && !ops.back().paren)
+			{
+				out.push_back(ops.back().tok);
+				ops.pop_back();
+			}
+		};
+
+	auto token = [](exprToken::kind k, char code, int index,
+		const exprLexer::item& i)
+		{
+			return exprToken{ k, code, static_cast<std::uint16_t>(index),
+				static_cast<std::uint32_t>(i.pos),
+				static_cast<std::uint32_t>(i.len) };
+		};
+
+	while ((it = lex.next()).type != lexeme::END)
+	{
+		if (it.type == lexeme::INVALID)
+			return fail(error::BAD_CHARACTER, it.pos, it.len);
+
+		if (operand)
+		{
+			switch (it.type)
+			{
+			case lexeme::VALUE:
+				out.push_back(token(exprToken::kind::VALUE, 0, 0, it));
+				operand = false;
+				break;
+			case lexeme::NAME:
+				found = find_function(g, src.substr(it.pos, it.len));
+				if (found >= 0)
+				{
+					if (lex.next().type != lexeme::OPEN)
+						return fail(error::EXPECTED_CALL, it.pos, it.len);
+					ops.push_back(frame{ token(exprToken::kind::CALL, 0, found,
+						it), true, 1 });
+				}
+				else if (!g.names)
+					return fail(error::NAMES, it.pos, it.len);
+				else
+				{
+					out.push_back(token(exprToken::kind::NAME, 0, 0, it));
+					operand = false;
+				}
+				break;
+			case lexeme::OPEN:
+				ops.push_back(frame{ token(exprToken::kind::UNARY, '(', 0, it),
+					true, 0 });
+				break;
+			case lexeme::OPERATOR:
+				found = find_operator(g, src[it.pos], false, 1);
+				if (found < 0)
+					return fail(error::EXPECTED_OPERAND, it.pos, it.len);
+				ops.push_back(frame{ token(exprToken::kind::UNARY,
+					g.operators[found].code, found, it), false, 0 });
+				break;
+			default:
+				return fail(error::EXPECTED_OPERAND, it.pos, it.len);
+			}
+		}
+		else
+		{
+			switch (it.type)
+			{
+			case lexeme::OPERATOR:
+			{
+				found = find_operator(g, src[it.pos], false, 2);
+				if (found < 0)
+					return fail(error::EXPECTED_BINARY, it.pos, it.len);
+
+				const opInfo& op = g.operators[found];
+				while (!ops.empty() && !ops.back().paren)
+				{
+					const opInfo& top = g.operators[ops.back().tok.index];
+					if (top.precedence > op.precedence
+						|| (top.precedence == op.precedence && !op.right))
+					{
+						out.push_back(ops.back().tok);
+						ops.pop_back();
+					}
+					else
+						break;
+				}
+				ops.push_back(frame{ token(exprToken::kind::BINARY, op.code,
+					found, it), false, 0 });
+				operand = true;
+				break;
+			}
+			case lexeme::CLOSE:
+				unwind();
+				if (ops.empty())
+					return fail(error::UNMATCHED_CLOSE, it.pos, it.len);
+				if (ops.back().tok.type == exprToken::kind::CALL)
+				{
+					if (ops.back().args != g.functions[ops.back().tok.index].arity)
+						return fail(error::ARGUMENTS, ops.back().tok.pos,
+							ops.back().tok.len);
+					out.push_back(ops.back().tok);
+				}
+				ops.pop_back();
+				break;
+			case lexeme::COMMA:
+				unwind();
+				if (ops.empty() || ops.back().tok.type != exprToken::kind::CALL)
+					return fail(error::STRAY_COMMA, it.pos, it.len);
+				ops.back().args++;
+				operand = true;
+				break;
+			default:
+				return fail(error::EXPECTED_OPERATOR, it.pos, it.len);
+			}
+		}
+	}
+
+	if (operand)
+		return fail(error::EXPECTED_OPERAND, it.pos, 0);
+
+	while (!ops.empty())
+	{
+		if (ops.back().paren)
+			return fail(error::UNMATCHED_OPEN, ops.back().tok.pos,
+				ops.back().tok.len);
+		out.push_back(ops.back().tok);
+		ops.pop_back();
+	}
+
+	return exprError();
+}
+
+// each pending operator counts the operands it is still waiting for, an
+//	operand completes every operator that was waiting for its last one
+constexpr exprError exprParser::prefix(std::string_view src,
+	const grammar& g, std::vector<exprToken>& out)
+{
+	typedef exprLexer::lexeme lexeme;
+	typedef exprError::kind error;
+
+	exprLexer lex(src, g, notation::PREFIX);
+	std::vector<frame> ops;
+	exprLexer::item it;
+	int found;
+
+	out.clear();
+	out.reserve(src.size() / 2 + 1);
+
+	while ((it = lex.next()).type != lexeme::END)
+	{
+		if (it.type == lexeme::INVALID)
+			return fail(error::BAD_CHARACTER, it.pos, it.len);
+		if (ops.empty() && !out.empty())
+			return fail(error::EXPECTED_END, it.pos, it.len);
+
+		exprToken tok{ exprToken::kind::VALUE, 0, 0,
+			static_cast<std::uint32_t>(it.pos),
+			static_cast<std::uint32_t>(it.len) };
+		std::size_t arity = 0;
+
+		switch (it.type)
+		{
+		case lexeme::VALUE: break;
+		case lexeme::NAME:
+			found = find_function(g, src.substr(it.pos, it.len));
+			if (found >= 0)
+			{
+				tok.type = exprToken::kind::CALL;
+				tok.index = static_cast<std::uint16_t>(found);
+				arity = g.functions[found].arity;
+			}
+			else if (!g.names)
+				return fail(error::NAMES, it.pos, it.len);
+			else
+				tok.type = exprToken::kind::NAME;
+			break;
+		case lexeme::OPERATOR:
+			found = find_operator(g, src[it.pos], true, 0);
+			tok.type = (g.operators[found].arity == 1)
+				? exprToken::kind::UNARY : exprToken::kind::BINARY;
+			tok.code = src[it.pos];
+			tok.index = static_cast<std::uint16_t>(found);
+			arity = g.operators[found].arity;
+			break;
+		default:
+			return fail(error::PARENTHESES, it.pos, it.len);
+		}
+
+		if (arity > 0)
+		{
+			ops.push_back(frame{ tok, false, arity });
+			continue;
+		}
+
+		out.push_back(tok);
+		while (!ops.empty() && --ops.back().args == 0)
+		{
+			out.push_back(ops.back().tok);
+			ops.pop_back();
+		}
+	}
+
+	if (out.empty() || !ops.empty())
+		return fail(error::EXPECTED_OPERAND, it.pos, 0);
+
+	return exprError();
+}
+
+constexpr exprError exprParser::postfix(std::string_view src,
+	const grammar& g, std::vector<exprToken>& out)
+{
+	typedef exprLexer::lexeme lexeme;
+	typedef exprError::kind error;
+
+	exprLexer lex(src, g, notation::POSTFIX);
+	exprLexer::item it;
+	std::size_t depth = 0, arity;
+	int found;
+
+	out.clear();
+	out.reserve(src.size() / 2 + 1);
+
+	while ((it = lex.next()).type != lexeme::END)
+	{
+		exprToken tok{ exprToken::kind::VALUE, 0, 0,
+			static_cast<std::uint32_t>(it.pos),
+			static_cast<std::uint32_t>(it.len) };
+		arity = 0;
+
+		switch (it.type)
+		{
+		case lexeme::VALUE: break;
+		case lexeme::NAME:
+			found = find_function(g, src.substr(it.pos, it.len));
+			if (found >= 0)
+			{
+				tok.type = exprToken::kind::CALL;
+				tok.index = static_cast<std::uint16_t>(found);
+				arity = g.functions[found].arity;
+			}
+			else if (!g.names)
+				return fail(error::NAMES, it.pos, it.len);
+			else
+				tok.type = exprToken::kind::NAME;
+			break;
+		case lexeme::OPERATOR:
+			found = find_operator(g, src[it.pos], true, 0);
+			tok.type = (g.operators[found].arity == 1)
+				? exprToken::kind::UNARY : exprToken::kind::BINARY;
+			tok.code = src[it.pos];
+			tok.index = static_cast<std::uint16_t>(found);
+			arity = g.operators[found].arity;
+			break;
+		case lexeme::INVALID:
+			return fail(error::BAD_CHARACTER, it.pos, it.len);
+		default:
+			return fail(error::PARENTHESES, it.pos, it.len);
+		}
+
+		if (depth < arity)
+			return fail(error::MISSING_OPERAND, it.pos, it.len);
+
+		depth += 1 - arity;
+		out.push_back(tok);
+	}
+
+	if (depth != 1)
+		return fail(depth == 0 ? error::EXPECTED_OPERAND
+			: error::MISSING_OPERATOR, it.pos, 0);
+
+	return exprError();
+}
+
+	/* public */
+
+constexpr exprError exprParser::try_parse(std::string_view src,
+	const grammar& g, notation n, std::vector<exprToken>& out)
+{
+	if (src.size() > UINT32_MAX)
+		return fail(exprError::kind::TOO_LONG, 0, 0);
+
+	switch (n)
+	{
+	case notation::INFIX: return infix(src, g, out);
+	case notation::PREFIX: return prefix(src, g, out);
+	default: return postfix(src, g, out);
+	}
+}
+
+std::vector<exprToken> exprParser::parse(std::string_view src,
+	const grammar& g, notation n)
+{
+	std::vector<exprToken> out;
+	const exprError e = try_parse(src, g, n, out);
+
+	if (e.type == exprError::kind::TOO_LONG)
+		throw std::invalid_argument(describe(e, src) + "\n");
+	else if (e)
+		throw parseError(describe(e, src), e.pos);
+
+	return out;
+}
+
+// the text of the error is only built here, never while parsing
+string exprParser::describe(const exprError& e, std::string_view src)
+{
+	typedef exprError::kind error;
+
+	const string text(src.substr(std::min<std::size_t>(e.pos, src.size()),
+		e.len));
+
+	switch (e.type)
+	{
+	case error::NONE: return "No error";
+	case error::BAD_CHARACTER: return "'" + text + "' is not a valid character";
+	case error::EXPECTED_OPERAND: return "Expected an operand";
+	case error::EXPECTED_OPERATOR: return "Expected an operator";
+	case error::EXPECTED_BINARY: return "Expected a binary operator";
+	case error::EXPECTED_CALL: return "Expected '(' after " + text;
+	case error::EXPECTED_END: return "Expected the end of the expression";
+	case error::UNMATCHED_OPEN: return "Unmatched '('";
+	case error::UNMATCHED_CLOSE: return "Unmatched ')'";
+	case error::STRAY_COMMA: return "',' outside of a call";
+	case error::ARGUMENTS: return "Wrong number of arguments to " + text;
+	case error::NAMES: return "Variables are not allowed, found " + text;
+	case error::PARENTHESES:
+		return "Parentheses are only allowed in infix";
+	case error::MISSING_OPERAND: return "Missing an operand";
+	case error::MISSING_OPERATOR: return "Missing an operator";
+	case error::TOO_LONG: return "Expression is too long";
+	case error::BAD_FORMAT:
+		return "Format must be 'infix', 'prefix' or 'postfix'";
+	default: return "A variable is not bound";
+	}
+}
+
+// one allocation, sized from the tokens before anything is copied
+string exprParser::write_postfix(std::string_view src,
+	const std::vector<exprToken>& tokens)
+{
+	std::size_t size = tokens.size();
+	string out;
+
+	for (const exprToken& tok : tokens)
+		size += tok.len;
+	out.reserve(size);
+
+	for (const exprToken& tok : tokens)
+	{
+		if (!out.empty())
+			out += ' ';
+		if (tok.type == exprToken::kind::UNARY
+			|| tok.type == exprToken::kind::BINARY)
+			out += tok.code;
+		else
+			out.append(src.data() + tok.pos, tok.len);
+	}
+
+	return out;
+}
+
+// the operands of every token are found with one pass over a stack, then an
+//	explicit stack of (token, next operand) pairs walks the tree in order
+string exprParser::write_infix(std::string_view src,
+	const std::vector<exprToken>& tokens, const grammar& g)
+{
+	struct visit
+	{
+		std::uint32_t tok;
+		std::uint32_t next;
+	};
+
+	const std::size_t n = tokens.size();
+	std::vector<std::uint32_t> first(n + 1), kids, stack;
+	std::vector<unsigned char> arity(n), wrap(n);
+	std::vector<visit> walk;
+	std::size_t size = 0;
+	string out;
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		const exprToken& tok = tokens[i];
+
+		switch (tok.type)
+		{
+		case exprToken::kind::UNARY:
+			arity[i] = 1;
+			wrap[i] = find_operator(g, g.operators[tok.index].symbol, false,
+				2) >= 0;
+			size += 1 + 2 * wrap[i];
+			break;
+		case exprToken::kind::BINARY:
+			arity[i] = 2;
+			size += 3;
+			break;
+		case exprToken::kind::CALL:
+			arity[i] = g.functions[tok.index].arity;
+			size += tok.len + 1 + std::max<std::size_t>(arity[i], 1);
+			break;
+		default:
+			size += tok.len;
+			break;
+		}
+		first[i + 1] = first[i] + arity[i];
+	}
+
+	kids.resize(first[n]);
+	for (std::uint32_t i = 0; i < n; i++)
+	{
+		for (std::size_t k = arity[i]; k-- > 0;)
+		{
+			kids[first[i] + k] = stack.back();
+			stack.pop_back();
+		}
+		stack.push_back(i);
+	}
+
+	if (stack.empty())
+		return out;
+
+	out.reserve(size);
+	walk.push_back(visit{ stack.back(), 0 });
+
+	while (!walk.empty())
+	{
+		const visit v = walk.back();
+		const exprToken& tok = tokens[v.tok];
+
+		if (arity[v.tok] == 0 && tok.type != exprToken::kind::CALL)
+		{
+			out.append(src.data() + tok.pos, tok.len);
+			walk.pop_back();
+			continue;
+		}
+
+		if (v.next == 0)
+		{
+			if (tok.type == exprToken::kind::CALL)
+				out.append(src.data() + tok.pos, tok.len).append(1, '(');
+			else if (tok.type == exprToken::kind::BINARY || wrap[v.tok])
+				out += '(';
+			if (tok.type == exprToken::kind::UNARY)
+				out += g.operators[tok.index].symbol;
+		}
+		else if (v.next < arity[v.tok])
+			out += (tok.type == exprToken::kind::BINARY)
+				? g.operators[tok.index].symbol : ',';
+
+		if (v.next == arity[v.tok])
+		{
+			if (tok.type != exprToken::kind::UNARY || wrap[v.tok])
+				out += ')';
+			walk.pop_back();
+			continue;
+		}
+
+		walk.back().next++;
+		walk.push_back(visit{ kids[first[v.tok] + v.next], 0 });
+	}
+
+	return out;
+}
+
+// prefix is the tree in preorder, so the operands are pushed in reverse
+string exprParser::write_prefix(std::string_view src,
+	const std::vector<exprToken>& tokens, const grammar& g)
+{
+	const std::size_t n = tokens.size();
+	std::vector<std::uint32_t> first(n + 1), kids, stack;
+	std::vector<unsigned char> arity(n);
+	std::size_t size = n;
+	string out;
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		const exprToken& tok = tokens[i];
+
+		arity[i] = (tok.type == exprToken::kind::UNARY) ? 1
+			: (tok.type == exprToken::kind::BINARY) ? 2
+			: (tok.type == exprToken::kind::CALL)
+			? g.functions[tok.index].arity : 0;
+		size += tok.len;
+		first[i + 1] = first[i] + arity[i];
+	}
+
+	kids.resize(first[n]);
+	for (std::uint32_t i = 0; i < n; i++)
+	{
+		for (std::size_t k = arity[i]; k-- > 0;)
+		{
+			kids[first[i] + k] = stack.back();
+			stack.pop_back();
+		}
+		stack.push_back(i);
+	}
+
+	out.reserve(size);
+	while (!stack.empty())
+	{
+		const std::uint32_t i = stack.back();
+		const exprToken& tok = tokens[i];
+		stack.pop_back();
+
+		if (!out.empty())
+			out += ' ';
+		if (tok.type == exprToken::kind::UNARY
+			|| tok.type == exprToken::kind::BINARY)
+			out += tok.code;
+		else
+			out.append(src.data() + tok.pos, tok.len);
+
+		for (std::size_t k = arity[i]; k-- > 0;)
+			stack.push_back(kids[first[i] + k]);
+	}
+
+	return out;
+}
+
+bool exprParser::try_notation(std::string_view format, notation& n)
+{
+	if (format == "infix")
+		n = notation::INFIX;
+	else if (format == "prefix")
+		n = notation::PREFIX;
+	else if (format == "postfix")
+		n = notation::POSTFIX;
+	else
+		return false;
+
+	return true;
+}
+
+notation exprParser::to_notation(const string& format)
+{
+	notation n;
+
+	if (!try_notation(format, n))
+		throw std::invalid_argument(describe(
+			exprError{ exprError::kind::BAD_FORMAT }, format) + "\n");
+
+	return n;
+}
+
+
+		/* Expression */
+
+	/* protected */
+
+template <typename adt>
+void Expression<adt>::assemble(std::string_view src,
+	const std::vector<exprToken>& tokens, std::vector<string>& names)
+{
+	const grammar& g = syntax();
+
+	vm.clear();
+	names.clear();
+
+	for (const exprToken& tok : tokens)
+	{
+		switch (tok.type)
+		{
+		case exprToken::kind::VALUE:
+			vm.push(exprKernel<adt>::literal(src.substr(tok.pos, tok.len)));
+			break;
+		case exprToken::kind::NAME:
+		{
+			const std::string_view name = src.substr(tok.pos, tok.len);
+			auto found = std::find(names.begin(), names.end(), name);
+			vm.emit(vmOp::VARIABLE,
+				static_cast<std::uint32_t>(found - names.begin()));
+			if (found == names.end())
+				names.emplace_back(name);
+			break;
+		}
+		case exprToken::kind::CALL:
+			vm.emit(g.functions[tok.index].kernel);
+			break;
+		default:
+			vm.emit(g.operators[tok.index].kernel);
+			break;
+		}
+	}
+
+	vm.finish();
+}
+
+// Dijkstra's Shunting Yard Algorithm, run by the shared parser in one pass
+//	over a view of the input
+// https://mathcenter.oxford.emory.edu/site/cs171/shuntingYardAlgorithm/
+template <typename adt>
+string Expression<adt>::infix_to_postfix(const string& infix) const
+{
+	return exprParser::write_postfix(infix,
+		exprParser::parse(infix, syntax(), notation::INFIX));
+}
+
+template <typename adt>
+string Expression<adt>::postfix_to_infix(const string& post) const
+{
+	return exprParser::write_infix(post,
+		exprParser::parse(post, syntax(), notation::POSTFIX), syntax());
+}
+
+template <typename adt>
+string Expression<adt>::postfix_to_prefix(const string& post) const
+{
+	return exprParser::write_prefix(post,
+		exprParser::parse(post, syntax(), notation::POSTFIX), syntax());
+}
+
+// the shared parser reads prefix left to right, without reversing it
+template <typename adt>
+string Expression<adt>::prefix_to_postfix(const string& pre) const
+{
+	return exprParser::write_postfix(pre,
+		exprParser::parse(pre, syntax(), notation::PREFIX));
+}
+
+
 // written by Gemini
 bool isNumber(const std::string& str)
 {
@@ -0,0 +1,240 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "expression.hpp"
+
+
+/* classes */
+
+/* exprPool */
+
+// purpose: many expressions of one kind kept as arrays instead of objects,
+//	their programs back to back in one buffer and their results packed, each
+//	known by a 32 bit handle, so evaluating them all is one linear pass
+// invariants: 'Exp' is an Expression with variables() and try_set();
+//	program h starts at instruction offsets[h] and ends at its HALT; a
+//	variable is shared by name by every expression of the pool
+// data members:
+//	'vm' holds every program, each ending in HALT
+//	'offsets' holds where each program starts
+//	'names' holds the variables of the pool in order of first use, 'ids'
+//	maps a name back to its index
+//	'results' holds the result of every program after evaluate(), bit h % 64
+//	of word h / 64 when the results are bools
+//	'scratch' is what text is compiled in before its program is copied, and
+//	'remap' what its variables are here
+template <class Exp>
+class exprPool
+{
+public:
+		/* prerequisites */
+
+	typedef typename Exp::value_type adt;
+
+	typedef std::uint32_t handle;
+
+private:
+		/* prerequisites */
+
+	static constexpr bool BITS = std::is_same_v<adt, bool>;
+
+		/* member variables */
+
+	exprVM<adt> vm;
+
+	std::vector<std::uint32_t> offsets;
+
+	std::vector<std::string> names;
+
+	std::unordered_map<std::string, std::uint32_t> ids;
+
+	std::vector<std::conditional_t<BITS, std::uint64_t, adt>> results;
+
+	Exp scratch;
+
+	std::vector<std::uint32_t> remap;
+
+public:
+
+		/* member functions */
+
+	// purpose: adds an expression, copying its program into the pool
+	// requires: the expression, an empty one is added as adt()
+	// returns: its handle
+	handle add(const Exp&);
+
+	// purpose: compiles an expression and adds it without throwing, the
+	//	text is compiled in one reused expression so no object is left
+	//	behind
+	// requires: the expression, its notation, by default infix, and the
+	//	handle to set
+	// returns: NONE, or the first error, and then nothing is added
+	exprError try_add(std::string_view, handle&, notation = notation::INFIX);
+
+	// purpose: counts the expressions
+	// requires: nothing
+	// returns: a size
+	std::size_t size() const { return offsets.size(); }
+
+	// purpose: finds the variables of every expression
+	// requires: nothing
+	// returns: the names, by index
+	const std::vector<std::string>& variables() const { return names; }
+
+	// purpose: finds how much memory the pool takes
+	// requires: nothing
+	// returns: a number of bytes, the programs, offsets and results
+	std::size_t bytes() const
+	{ return vm.bytes() + offsets.capacity() * sizeof(std::uint32_t)
+		+ results.capacity() * sizeof(results[0]); }
+
+	// purpose: evaluates every expression in one pass over the programs
+	// requires: the value of each variable, in the order of variables()
+	// returns: nothing, but replaces the results
+	void evaluate(std::span<const adt>);
+
+	// purpose: evaluates every expression with values for its variables
+	//	without throwing
+	// requires: a map from each variable name to its value
+	// returns: NONE, or UNBOUND with the index of the first variable
+	//	missing from the map, and then the results are unchanged
+	exprError try_evaluate(const std::map<std::string, adt>&);
+
+	// purpose: evaluates one expression
+	// requires: its handle and the value of each variable, in the order of
+	//	variables()
+	// returns: the result
+	adt evaluate(handle, std::span<const adt>) const;
+
+	// purpose: finds the result of an expression
+	// requires: its handle, after evaluate()
+	// returns: the result
+	adt result(handle h) const
+	{
+		if constexpr (BITS)
+			return (results[h / 64] >> (h % 64)) & 1;
+		else
+			return results[h];
+	}
+
+};
+
+
+	/* methods */
+
+/* public */
+
+// the program is appended with its variables swapped for the pool's
+template <class Exp>
+typename exprPool<Exp>::handle exprPool<Exp>::add(const Exp& e)
+{
+	const handle h = static_cast<handle>(offsets.size());
+
+	if (offsets.size() == UINT32_MAX)
+		throw std::length_error("An expression pool holds fewer than 2^32"
+			" expressions\n");
+
+	offsets.push_back(static_cast<std::uint32_t>(vm.size()));
+
+	if (e.compiled().empty())
+	{
+		vm.push(adt());
+		vm.finish();
+		return h;
+	}
+
+	remap.clear();
+	for (const std::string& name : e.variables())
+	{
+		auto found = ids.emplace(name, static_cast<std::uint32_t>(
+			names.size()));
+		if (found.second)
+			names.push_back(name);
+		remap.push_back(found.first->second);
+	}
+
+	vm.append(e.compiled(), remap.data());
+
+	return h;
+}
+
+template <class Exp>
+exprError exprPool<Exp>::try_add(std::string_view xpr, handle& h,
+	notation n)
+{
+	const exprError e = scratch.try_set(xpr, n);
+
+	if (!e)
+		h = add(scratch);
+
+	return e;
+}
+
+template <class Exp>
+void exprPool<Exp>::evaluate(std::span<const adt> values)
+{
+	std::size_t k = 0;
+
+	if (values.size() < names.size())
+		throw std::invalid_argument("Expected a value for each of the "
+			+ std::to_string(names.size()) + " variables\n");
+
+	if constexpr (BITS)
+	{
+		results.assign((offsets.size() + 63) / 64, 0);
+		vm.run_all(values.data(), [this, &k](bool value)
+			{
+				results[k / 64] |= std::uint64_t(value) << (k % 64);
+				k++;
+			});
+	}
+	else
+	{
+		results.resize(offsets.size());
+		vm.run_all(values.data(), [this, &k](const adt& value)
+			{ results[k++] = value; });
+	}
+}
+
+template <class Exp>
+exprError exprPool<Exp>::try_evaluate(
+	const std::map<std::string, adt>& bindings)
+{
+	std::unique_ptr<adt[]> values(new adt[names.size()]);
+
+	for (std::size_t j = 0; j < names.size(); j++)
+	{
+		auto found = bindings.find(names[j]);
+		if (found == bindings.end())
+			return exprError{ exprError::kind::UNBOUND,
+				static_cast<std::uint32_t>(j) };
+		values[j] = found->second;
+	}
+
+	evaluate(std::span<const adt>(values.get(), names.size()));
+
+	return exprError();
+}
+
+template <class Exp>
+typename exprPool<Exp>::adt exprPool<Exp>::evaluate(handle h,
+	std::span<const adt> values) const
+{
+	if (values.size() < names.size())
+		throw std::invalid_argument("Expected a value for each of the "
+			+ std::to_string(names.size()) + " variables\n");
+
+	return vm.run(offsets[h], values.data());
+}
@@ -1,29 +1,75 @@
 #pragma once
 
 
+#include <cmath>
+
 #include "expression.hpp"
+#include "realfx.hpp"
 
 
 	/* realExp */
 
 // purpose: represents a real-valued expression
 // invariants: expression must be representable as real numbers and uses
-//	operations +, -, *, or /
+//	operations +, -, *, /, ^, unary minus and the functions in FUNCTIONS;
+//	'vm' is always the compiled form of 'expression'
 // data members:
-//	'result' is a pointer to the expression's result
+//	'result' holds the expression's result once it has been evaluated
 //	'expression' is a string that represents the actual expression
+//	'names' holds the variables in order of first use, read by VARIABLE
+//	instructions through the slot of the same index
 class realExp : public Expression<long double>
 {
 protected:
 
+	/* member variables */
+
+	// the operators of a real expression, in order of precedence
+	// unary minus binds looser than ^, so -x^2 is -(x^2)
+	static constexpr opInfo OPERATORS[] = {
+		{ '+', '+', 2, 1, false, vmOp::ADD },
+		{ '-', '-', 2, 1, false, vmOp::SUB },
+		{ '*', '*', 2, 2, false, vmOp::MUL },
+		{ '/', '/', 2, 2, false, vmOp::DIV },
+		{ '-', '~', 1, 3, false, vmOp::NEGATE },
+		{ '^', '^', 2, 4, true, vmOp::POW } };
+
+	// the functions that can be called, their names cannot be variables
+	static constexpr fnInfo FUNCTIONS[] = {
+		{ "sin", 1, vmOp::SIN }, { "cos", 1, vmOp::COS },
+		{ "tan", 1, vmOp::TAN }, { "exp", 1, vmOp::EXP },
+		{ "log", 1, vmOp::LOG }, { "sqrt", 1, vmOp::SQRT },
+		{ "abs", 1, vmOp::ABS } };
+
+	// the literals are decimal numbers, and variables are allowed
+	static constexpr grammar SYNTAX = { OPERATORS, FUNCTIONS, false, true };
+
+	// to_fxn runs the same program on graphs, so both kernels must have
+	//	every entry
+	static_assert(SYNTAX.consistent<long double>()
+		&& SYNTAX.consistent<realFxN>(), "Every kernel of a real operator or"
+		" function must take as many operands as it does, and reals and"
+		" their graphs must have it");
+
+	std::vector<string> names;
+
 	/* member functions */
 
-	// purpose: evaluates a real expression with two inputs
-	// requires: an array of two long doubles to evaluate,
-	//	and a char i.e. the operator
-	// returns: a long double that is the result
-	long double eval_simple_exp
-	(const std::array<long double, 2>&, const char&) const override;
+	// purpose: compiles 'expression' into 'vm'
+	// requires: nothing
+	// returns: nothing, but replaces the program and names
+	void compile();
+
+	// purpose: compiles parsed tokens into 'vm', leaving 'expression' to
+	//	the caller
+	// requires: the source the tokens refer to, and the tokens
+	// returns: nothing, but replaces the program and names
+	void compile(std::string_view, const std::vector<exprToken>&);
+
+	// purpose: runs the program on the virtual machine
+	// requires: the value of every variable, by index
+	// returns: a long double i.e. the result, NaN when there is no program
+	long double run(const long double*) const;
 
 public:
 
@@ -31,7 +77,7 @@ public:
 
 	// default constructor
 	// sets the expression to the additive identity
-	realExp() { expression = "0"; }
+	realExp() { expression = "0"; compile(); }
 
 	// parametrized constructor
 	// takes in a string i.e. an expression in infix notation
@@ -41,6 +87,94 @@ public:
 
 	// copy constructor
 	realExp(const realExp&);
+
+	/* member functions */
+
+	// purpose: finds the grammar of the expression
+	// requires: nothing
+	// returns: SYNTAX
+	const grammar& syntax() const override { return SYNTAX; }
+
+	// purpose: evaluates an expression without variables
+	// requires: nothing
+	// returns: a long double i.e. the result, NaN if a variable is unbound
+	long double evaluate() override;
+
+	// purpose: evaluates an expression without variables, without throwing
+	//	or writing to std::cerr
+	// requires: the long double to set to the result
+	// returns: NONE, or UNBOUND with the index of a variable, and then the
+	//	long double is untouched
+	exprError try_evaluate(long double&);
+
+	// purpose: evaluates the expression with values for its variables
+	// requires: a map from each variable name to its value
+	// returns: a long double i.e. the result
+	long double evaluate(const std::map<string, long double>&) const;
+
+	// purpose: evaluates the expression with values for its variables
+	//	without throwing
+	// requires: a map from each variable name to its value, and the long
+	//	double to set to the result
+	// returns: NONE, or UNBOUND with the index of the first variable
+	//	missing from the map
+	exprError try_evaluate(const std::map<string, long double>&,
+		long double&) const;
+
+	// purpose: evaluates the expression with values for its variables
+	// requires: the value of each variable, in the order of variables()
+	// returns: a long double i.e. the result
+	long double evaluate(std::span<const long double>) const;
+
+	// purpose: finds the variables of the expression
+	// requires: nothing
+	// returns: the names in order of first use, i.e. the order evaluate
+	//	expects their values in
+	const std::vector<string>& variables() const { return names; }
+
+	// purpose: builds the symbolic form of the expression
+	// requires: the variables of the function in order, i.e. the first one
+	//	is variable 0, and values for any other variable, by default none
+	// returns: a realFxN that evaluates the same expression
+	realFxN to_fxn(const std::vector<string>&,
+		const std::map<string, long double>& = {}) const;
+
+	// purpose: compiles the expression into a function of one variable
+	// requires: the name of the variable, and values for any other variable,
+	//	by default none
+	// returns: a realFx backed by the symbolic form, so its derivative is
+	//	exact and it evaluates and integrates in batches
+	realFx to_fx(const string&,
+		const std::map<string, long double>& = {}) const;
+
+	// purpose: gets the expression
+	// requires: can pass in "infix", "prefix", or "postfix" to get the
+	//	expression in one of those formats, by default "infix"
+	// returns: a string i.e. the expression, empty after reporting a bad
+	//	format to std::cerr
+	string getExpression(const string & = "infix") override;
+
+	// purpose: changes the expression to something new
+	// requires: a string i.e. the new expression, and a string i.e. the
+	//	format either "infix", "prefix", or "postfix", by default "infix"
+	// returns: nothing
+	void setExpression(const string&, const string & = "infix") override;
+
+	// purpose: changes the expression to something new without throwing or
+	//	writing to std::cerr, for input where malformed expressions are
+	//	expected
+	// requires: the new expression and its notation, by default infix
+	// returns: NONE, or the first error with where it is in the new
+	//	expression, and then the old expression is kept
+	exprError try_set(std::string_view, notation = notation::INFIX);
+
+	/* operators */
+
+	// purpose: assigns an expression to this one
+	// requires: a real expression
+	// returns: this expression
+	realExp& operator=(const realExp&);
+
 };
 
 
@@ -51,5 +185,217 @@ public:
 // parametrized constructor
 realExp::realExp(const string& xpr, const string& format)
 {
+	setExpression(xpr, format);
+}
+
+// copy constructor
+realExp::realExp(const realExp& other) : names(other.names)
+{
+	vm = other.vm;
+	expression = other.expression;
+	result = other.result;
+	infix_form = other.infix_form;
+	prefix_form = other.prefix_form;
+}
+
+
+	/* methods */
+
+/* protected */
+
+void realExp::compile()
+{
+	compile(expression, exprParser::parse(expression, SYNTAX,
+		notation::POSTFIX));
+}
+
+// the machine is the only compiled form, so each literal is parsed once,
+//	by the kernel
+void realExp::compile(std::string_view src,
+	const std::vector<exprToken>& tokens)
+{
+	assemble(src, tokens, names);
+}
+
+long double realExp::run(const long double* vars) const
+{
+	return vm.empty() ? std::nan("") : vm.run(vars);
+}
+
+/* public */
+
+// evaluate the full expression
+// the message is only written here, try_evaluate never touches a stream
+long double realExp::evaluate()
+{
+	long double value = std::nan("");
+	const exprError e = try_evaluate(value);
+
+	if (e)
+		std::cerr << names[e.pos] << " is not bound\n";
+
+	return value;
+}
+
+exprError realExp::try_evaluate(long double& out)
+{
+	if (!result)
+	{
+		if (!names.empty())
+			return exprError{ exprError::kind::UNBOUND, 0 };
+		result = run(nullptr);
+	}
+
+	out = *result;
+
+	return exprError();
+}
+
+long double realExp::evaluate(const std::map<string, long double>& bindings)
+	const
+{
+	long double value = 0;
+	const exprError e = try_evaluate(bindings, value);
+
+	if (e)
+		throw std::invalid_argument(names[e.pos] + " is not bound\n");
+
+	return value;
+}
+
+// the names are resolved to slots once, then the program runs on the slots
+exprError realExp::try_evaluate(const std::map<string, long double>& bindings,
+	long double& out) const
+{
+	std::vector<long double> slots(names.size());
+
+	for (std::size_t i = 0; i < names.size(); i++)
+	{
+		auto found = bindings.find(names[i]);
+		if (found == bindings.end())
+			return exprError{ exprError::kind::UNBOUND,
+				static_cast<std::uint32_t>(i) };
+		slots[i] = found->second;
+	}
+
+	out = run(slots.data());
+
+	return exprError();
+}
+
+long double realExp::evaluate(std::span<const long double> values) const
+{
+	if (values.size() < names.size())
+		throw std::invalid_argument("Expected a value for each of the "
+			+ std::to_string(names.size()) + " variables\n");
+
+	return run(values.data());
+}
+
+// the program is run on graphs instead of values, each instruction through
+//	the kernel of realFxN, so it follows the tables like evaluation does
+realFxN realExp::to_fxn(const std::vector<string>& vars,
+	const std::map<string, long double>& bindings) const
+{
+	std::vector<realFxN> leaves;
+
+	if (vm.empty())
+		throw std::invalid_argument("Expression is empty\n");
+
+	for (const string& name : names)
+	{
+		auto slot = std::find(vars.begin(), vars.end(), name);
+		auto bound = bindings.find(name);
+
+		if (slot != vars.end())
+			leaves.push_back(realFxN::variable(
+				static_cast<std::uint32_t>(slot - vars.begin())));
+		else if (bound != bindings.end())
+			leaves.emplace_back(bound->second);
+		else
+			throw std::invalid_argument(name + " is not bound\n");
+	}
+
+	return vm.run_as(leaves.data());
+}
+
+realFx realExp::to_fx(const string& var,
+	const std::map<string, long double>& bindings) const
+{
+	return realFx(to_fxn({ var }, bindings));
+}
+
+// return the Expression's expression as a string in a given format
+string realExp::getExpression(const string& format)
+{
+	notation n;
+
+	if (!exprParser::try_notation(format, n))
+	{
+		report(exprError{ exprError::kind::BAD_FORMAT }, format);
+		return string();
+	}
+
+	if (expression.empty())
+		return expression;
+
+	switch (n)
+	{
+	case notation::POSTFIX: return expression;
+	case notation::PREFIX:
+		if (!prefix_form)
+			prefix_form = postfix_to_prefix(expression);
+		return *prefix_form;
+	default:
+		if (!infix_form)
+			infix_form = postfix_to_infix(expression);
+		return *infix_form;
+	}
+}
+
+// the old expression is kept when the new one does not parse
+// the message is only written here, try_set never touches a stream
+void realExp::setExpression(const string& xpr, const string& format)
+{
+	notation n;
+	const exprError e = exprParser::try_notation(format, n)
+		? try_set(xpr, n) : exprError{ exprError::kind::BAD_FORMAT };
+
+	if (e)
+		report(e, xpr);
+}
+
+// the tokens are compiled straight from the new text, so it is parsed once
+//	and nothing is thrown
+exprError realExp::try_set(std::string_view xpr, notation n)
+{
+	thread_local std::vector<exprToken> tokens;
+	const exprError e = exprParser::try_parse(xpr, SYNTAX, n, tokens);
+
+	if (e)
+		return e;
+
+	compile(xpr, tokens);
+	expression = exprParser::write_postfix(xpr, tokens);
+	invalidate();
+
+	return e;
+}
+
+
+	/* operators */
+
+realExp& realExp::operator=(const realExp& other)
+{
+	if (this != &other)
+	{
+		expression = other.expression;
+		names = other.names;
+		vm = other.vm;
+		result = other.result;
+		infix_form = other.infix_form;
+		prefix_form = other.prefix_form;
+	}
 
+	return *this;
 }
@@ -0,0 +1,646 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/* classes */
+
+/* satSolver */
+
+// purpose: a conflict driven clause learning SAT solver in the style of
+//	MiniSat, i.e. two watched literals, VSIDS branching with phase saving,
+//	first UIP learning with clause minimization, Luby restarts and
+//	activity based clause deletion
+// invariants: literal 2v is variable v and 2v + 1 its negation; clauses can
+//	be added between calls to solve, which makes the solver incremental
+// data members:
+//	'clauses' holds the problem and learnt clauses, a deleted clause is left
+//	empty so indices stay stable, and 'watches' holds for every literal the
+//	clauses watching it
+//	'assigns', 'level', 'reason' and 'phase' describe every variable, 'trail'
+//	holds the assigned literals in order and 'limits' where each decision
+//	level starts on it
+//	'activity', 'heap' and 'slot' order the unassigned variables by VSIDS
+//	activity, 'var_inc' and 'cla_inc' are the current bumps
+//	'ok' is false once the clauses are known to be unsatisfiable
+//	'best' holds the model found by the last successful solve, 'seen' and
+//	'clear' are scratch space for conflict analysis
+class satSolver
+{
+public:
+		/* prerequisites */
+
+	typedef std::uint32_t lit;
+
+	// purpose: makes the literals of a variable
+	// requires: a variable
+	// returns: a literal
+	static lit pos(std::uint32_t v) { return 2 * v; }
+	static lit neg(std::uint32_t v) { return 2 * v + 1; }
+
+private:
+		/* prerequisites */
+
+	struct clause
+	{
+		std::vector<lit> lits;
+		bool learnt;
+		double activity;
+	};
+
+	// a watching clause, with a literal of it that is checked first
+	struct watcher
+	{
+		std::uint32_t cref;
+		lit blocker;
+	};
+
+	static constexpr std::uint32_t NONE = UINT32_MAX;
+
+		/* member variables */
+
+	std::vector<clause> clauses;
+
+	std::vector<std::vector<watcher>> watches;
+
+	std::vector<std::int8_t> assigns;
+
+	std::vector<std::uint32_t> level;
+
+	std::vector<std::uint32_t> reason;
+
+	std::vector<bool> phase;
+
+	std::vector<lit> trail;
+
+	std::vector<std::size_t> limits;
+
+	std::size_t qhead = 0;
+
+	std::vector<double> activity;
+
+	std::vector<std::uint32_t> heap;
+
+	std::vector<std::uint32_t> slot;
+
+	double var_inc = 1;
+
+	double cla_inc = 1;
+
+	std::size_t learnts = 0;
+
+	bool ok = true;
+
+	std::vector<bool> best;
+
+	std::vector<char> seen;
+
+	std::vector<lit> clear;
+
+		/* member functions */
+
+	// purpose: finds the value of a literal
+	// requires: a literal
+	// returns: 1 for true, -1 for false and 0 for unassigned
+	int value(lit l) const
+	{
+		const int v = assigns[l >> 1];
+		return (l & 1) ? -v : v;
+	}
+
+	// purpose: assigns a literal true
+	// requires: the literal and the clause that implied it, or NONE
+	// returns: nothing
+	void enqueue(lit, std::uint32_t);
+
+	// purpose: watches the first two literals of a clause
+	// requires: a clause index
+	// returns: nothing
+	void attach(std::uint32_t);
+
+	// purpose: assigns every literal implied by unit clauses
+	// requires: nothing
+	// returns: the index of a falsified clause, or NONE
+	std::uint32_t propagate();
+
+	// purpose: learns a clause from a conflict by walking back to the first
+	//	unique implication point
+	// requires: the falsified clause and a vector to hold the learnt clause
+	// returns: the level to backtrack to
+	std::uint32_t analyze(std::uint32_t, std::vector<lit>&);
+
+	// purpose: undoes every assignment above a decision level
+	// requires: a level
+	// returns: nothing
+	void cancel_until(std::size_t);
+
+	// purpose: keeps the branching heap ordered after an activity changes
+	// requires: a position in the heap
+	// returns: nothing
+	void heap_up(std::size_t);
+	void heap_down(std::size_t);
+
+	// purpose: makes an unassigned variable a candidate for branching
+	// requires: a variable
+	// returns: nothing
+	void heap_insert(std::uint32_t);
+
+	// purpose: raises the activity of a variable
+	// requires: a variable
+	// returns: nothing
+	void bump(std::uint32_t);
+
+	// purpose: drops half of the least active learnt clauses
+	// requires: nothing
+	// returns: nothing
+	void reduce();
+
+	// purpose: searches until a model, a refutation or a conflict budget
+	// requires: the number of conflicts allowed
+	// returns: 1 for satisfiable, -1 for unsatisfiable, 0 when out of budget
+	int search(std::size_t);
+
+	// purpose: finds a term of the Luby sequence 1 1 2 1 1 2 4 ...
+	// requires: an index
+	// returns: a size
+	static std::size_t luby(std::size_t);
+
+public:
+
+		/* member functions */
+
+	// purpose: adds a variable
+	// requires: nothing
+	// returns: the index of the variable
+	std::uint32_t new_var();
+
+	// purpose: finds how many variables there are
+	// requires: nothing
+	// returns: a size
+	std::size_t variables() const { return assigns.size(); }
+
+	// purpose: adds a clause, i.e. a disjunction of literals
+	// requires: the literals
+	// returns: false when the clauses became unsatisfiable
+	bool add_clause(std::vector<lit>);
+
+	// purpose: decides whether the clauses are satisfiable
+	// requires: nothing
+	// returns: a bool, the model can then be read through model()
+	bool solve();
+
+	// purpose: finds the value of a variable in the last model
+	// requires: a variable
+	// returns: a bool
+	bool model(std::uint32_t v) const { return best[v]; }
+
+};
+
+
+	/* methods */
+
+/* private */
+
+void satSolver::enqueue(lit l, std::uint32_t from)
+{
+	const std::uint32_t v = l >> 1;
+
+	assigns[v] = (l & 1) ? -1 : 1;
+	level[v] = static_cast<std::uint32_t>(limits.size());
+	reason[v] = from;
+	trail.push_back(l);
+}
+
+void satSolver::attach(std::uint32_t c)
+{
+	const std::vector<lit>& lits = clauses[c].lits;
+
+	watches[lits[0]].push_back(watcher{ c, lits[1] });
+	watches[lits[1]].push_back(watcher{ c, lits[0] });
+}
+
+// a clause is visited only when one of its two watched literals becomes
+//	false, and then only until another non-false literal takes its place
+std::uint32_t satSolver::propagate()
+{
+	std::uint32_t conflict = NONE;
+
+	while (qhead < trail.size() && conflict == NONE)
+	{
+		const lit falsified = trail[qhead++] ^ 1;
+		std::vector<watcher>& ws = watches[falsified];
+		std::size_t i = 0, j = 0;
+
+		while (i < ws.size())
+		{
+			const watcher w = ws[i++];
+
+			if (value(w.blocker) == 1)
+			{
+				ws[j++] = w;
+				continue;
+			}
+
+			std::vector<lit>& lits = clauses[w.cref].lits;
+			if (lits.empty())
+				continue;
+
+			if (lits[0] == falsified)
+				std::swap(lits[0], lits[1]);
+
+			const lit first = lits[0];
+			if (first != w.blocker && value(first) == 1)
+			{
+				ws[j++] = watcher{ w.cref, first };
+				continue;
+			}
+
+			bool moved = false;
+			for (std::size_t k = 2; k < lits.size(); k++)
+				if (value(lits[k]) != -1)
+				{
+					std::swap(lits[1], lits[k]);
+					watches[lits[1]].push_back(watcher{ w.cref, first });
+					moved = true;
+					break;
+				}
+			if (moved)
+				continue;
+
+			ws[j++] = watcher{ w.cref, first };
+			if (value(first) == -1)
+			{
+				conflict = w.cref;
+				while (i < ws.size())
+					ws[j++] = ws[i++];
+			}
+			else
+				enqueue(first, w.cref);
+		}
+
+		ws.resize(j);
+	}
+
+	if (conflict != NONE)
+		qhead = trail.size();
+
+	return conflict;
+}
+
+// a literal of the learnt clause is dropped when its reason is made of
+//	literals the clause already has
+std::uint32_t satSolver::analyze(std::uint32_t conflict, std::vector<lit>& out)
+{
+	const std::size_t current = limits.size();
+	std::size_t index = trail.size(), paths = 0, keep = 1;
+	std::uint32_t back = 0, v;
+	lit p = NONE;
+
+	out.assign(1, 0);
+
+	do
+	{
+		clause& c = clauses[conflict];
+		if (c.learnt)
+		{
+			c.activity += cla_inc;
+			if (c.activity > 1e20)
+			{
+				for (clause& d : clauses)
+					d.activity *= 1e-20;
+				cla_inc *= 1e-20;
+			}
+		}
+
+		for (std::size_t j = (p == NONE) ? 0 : 1; j < c.lits.size(); j++)
+		{
+			v = c.lits[j] >> 1;
+			if (!seen[v] && level[v] > 0)
+			{
+				bump(v);
+				seen[v] = 1;
+				if (level[v] >= current)
+					paths++;
+				else
+					out.push_back(c.lits[j]);
+			}
+		}
+
+		while (!seen[trail[--index] >> 1]);
+		p = trail[index];
+		conflict = reason[p >> 1];
+		seen[p >> 1] = 0;
+		paths--;
+	} while (paths > 0);
+
+	out[0] = p ^ 1;
+	clear.assign(out.begin() + 1, out.end());
+
+	for (std::size_t i = 1; i < out.size(); i++)
+	{
+		const std::uint32_t from = reason[out[i] >> 1];
+		bool redundant = from != NONE;
+
+		if (redundant)
+			for (std::size_t k = 1; k < clauses[from].lits.size(); k++)
+			{
+				v = clauses[from].lits[k] >> 1;
+				if (!seen[v] && level[v] > 0)
+				{
+					redundant = false;
+					break;
+				}
+			}
+		if (!redundant)
+			out[keep++] = out[i];
+	}
+	for (lit l : clear)
+		seen[l >> 1] = 0;
+	out.resize(keep);
+
+	// the literal of the highest remaining level is watched next to the
+	//	asserting one
+	for (std::size_t i = 1; i < out.size(); i++)
+		if (level[out[i] >> 1] > back)
+		{
+			back = level[out[i] >> 1];
+			std::swap(out[1], out[i]);
+		}
+
+	return back;
+}
+
+void satSolver::cancel_until(std::size_t target)
+{
+	std::uint32_t v;
+
+	if (limits.size() <= target)
+		return;
+
+	for (std::size_t i = trail.size(); i-- > limits[target];)
+	{
+		v = trail[i] >> 1;
+		phase[v] = assigns[v] > 0;
+		assigns[v] = 0;
+		reason[v] = NONE;
+		heap_insert(v);
+	}
+
+	trail.resize(limits[target]);
+	qhead = trail.size();
+	limits.resize(target);
+}
+
+void satSolver::heap_up(std::size_t i)
+{
+	const std::uint32_t v = heap[i];
+
+	while (i > 0 && activity[heap[(i - 1) / 2]] < activity[v])
+	{
+		heap[i] = heap[(i - 1) / 2];
+		slot[heap[i]] = static_cast<std::uint32_t>(i);
+		i = (i - 1) / 2;
+	}
+
+	heap[i] = v;
+	slot[v] = static_cast<std::uint32_t>(i);
+}
+
+void satSolver::heap_down(std::size_t i)
+{
+	const std::uint32_t v = heap[i];
+	std::size_t child;
+
+	while ((child = 2 * i + 1) < heap.size())
+	{
+		if (child + 1 < heap.size()
+			&& activity[heap[child + 1]] > activity[heap[child]])
+			child++;
+		if (activity[heap[child]] <= activity[v])
+			break;
+		heap[i] = heap[child];
+		slot[heap[i]] = static_cast<std::uint32_t>(i);
+		i = child;
+	}
+
+	heap[i] = v;
+	slot[v] = static_cast<std::uint32_t>(i);
+}
+
+void satSolver::heap_insert(std::uint32_t v)
+{
+	if (slot[v] != NONE)
+		return;
+
+	heap.push_back(v);
+	heap_up(heap.size() - 1);
+}
+
+void satSolver::bump(std::uint32_t v)
+{
+	activity[v] += var_inc;
+
+	if (activity[v] > 1e100)
+	{
+		for (double& a : activity)
+			a *= 1e-100;
+		var_inc *= 1e-100;
+	}
+
+	if (slot[v] != NONE)
+		heap_up(slot[v]);
+}
+
+// clauses that are the reason of an assignment, and binary clauses, stay
+void satSolver::reduce()
+{
+	std::vector<std::uint32_t> learnt;
+
+	for (std::uint32_t c = 0; c < clauses.size(); c++)
+	{
+		const std::vector<lit>& lits = clauses[c].lits;
+		if (clauses[c].learnt && lits.size() > 2
+			&& reason[lits[0] >> 1] != c)
+			learnt.push_back(c);
+	}
+
+	std::sort(learnt.begin(), learnt.end(), [this](std::uint32_t a,
+		std::uint32_t b) { return clauses[a].activity < clauses[b].activity; });
+
+	for (std::size_t i = 0; i < learnt.size() / 2; i++)
+	{
+		clauses[learnt[i]].lits.clear();
+		clauses[learnt[i]].lits.shrink_to_fit();
+		learnts--;
+	}
+}
+
+int satSolver::search(std::size_t budget)
+{
+	std::vector<lit> learnt;
+	std::size_t conflicts = 0;
+	std::uint32_t conflict, back, v;
+
+	for (;;)
+	{
+		conflict = propagate();
+
+		if (conflict != NONE)
+		{
+			conflicts++;
+			if (limits.empty())
+				return -1;
+
+			back = analyze(conflict, learnt);
+			cancel_until(back);
+
+			if (learnt.size() == 1)
+				enqueue(learnt[0], NONE);
+			else
+			{
+				clauses.push_back(clause{ learnt, true, cla_inc });
+				attach(static_cast<std::uint32_t>(clauses.size() - 1));
+				enqueue(learnt[0], static_cast<std::uint32_t>(clauses.size() - 1));
+				learnts++;
+			}
+
+			var_inc /= 0.95;
+			cla_inc /= 0.999;
+		}
+		else
+		{
+			if (conflicts >= budget)
+			{
+				cancel_until(0);
+				return 0;
+			}
+
+			if (learnts >= clauses.size() / 3 + trail.size() + 1000)
+				reduce();
+
+			v = NONE;
+			while (!heap.empty())
+			{
+				v = heap[0];
+				heap[0] = heap.back();
+				slot[heap[0]] = 0;
+				heap.pop_back();
+				slot[v] = NONE;
+				if (!heap.empty())
+					heap_down(0);
+				if (assigns[v] == 0)
+					break;
+				v = NONE;
+			}
+
+			if (v == NONE)
+			{
+				for (std::size_t i = 0; i < assigns.size(); i++)
+					best[i] = assigns[i] > 0;
+				return 1;
+			}
+
+			limits.push_back(trail.size());
+			enqueue(phase[v] ? pos(v) : neg(v), NONE);
+		}
+	}
+}
+
+std::size_t satSolver::luby(std::size_t i)
+{
+	std::size_t size = 1, seq = 0;
+
+	while (size < i + 1)
+	{
+		seq++;
+		size = 2 * size + 1;
+	}
+
+	while (size - 1 != i)
+	{
+		size = (size - 1) >> 1;
+		seq--;
+		i = i % size;
+	}
+
+	return std::size_t(1) << seq;
+}
+
+/* public */
+
+std::uint32_t satSolver::new_var()
+{
+	const std::uint32_t v = static_cast<std::uint32_t>(assigns.size());
+
+	assigns.push_back(0);
+	level.push_back(0);
+	reason.push_back(NONE);
+	phase.push_back(false);
+	activity.push_back(0);
+	slot.push_back(NONE);
+	seen.push_back(0);
+	best.push_back(false);
+	watches.resize(2 * assigns.size());
+	heap_insert(v);
+
+	return v;
+}
+
+// the clause is simplified against the top level assignment first
+bool satSolver::add_clause(std::vector<lit> lits)
+{
+	std::size_t keep = 0;
+
+	if (!ok)
+		return false;
+
+	cancel_until(0);
+	std::sort(lits.begin(), lits.end());
+
+	for (std::size_t i = 0; i < lits.size(); i++)
+	{
+		if (value(lits[i]) == 1 || (i > 0 && lits[i] == (lits[i - 1] ^ 1)))
+			return true;
+		if (value(lits[i]) != -1 && (i == 0 || lits[i] != lits[i - 1]))
+			lits[keep++] = lits[i];
+	}
+	lits.resize(keep);
+
+	if (lits.empty())
+		return ok = false;
+	else if (lits.size() == 1)
+	{
+		enqueue(lits[0], NONE);
+		return ok = (propagate() == NONE);
+	}
+
+	clauses.push_back(clause{ std::move(lits), false, 0 });
+	attach(static_cast<std::uint32_t>(clauses.size() - 1));
+
+	return true;
+}
+
+bool satSolver::solve()
+{
+	int status = 0;
+
+	if (!ok)
+		return false;
+
+	cancel_until(0);
+	if (propagate() != NONE)
+		return ok = false;
+
+	for (std::size_t round = 0; status == 0; round++)
+		status = search(100 * luby(round));
+
+	if (status < 0)
+		ok = false;
+	cancel_until(0);
+
+	return status > 0;
+}
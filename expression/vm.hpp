@@ -0,0 +1,588 @@
+#pragma once
+
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TECAF_THREADED 1
+#endif
+
+
+/* classes */
+
+// the operations of a compiled expression, every operator and function of
+//	every kind of expression is its own opcode so each has its own handler
+enum class vmOp : std::uint8_t
+{
+	VALUE, VARIABLE, NEGATE, NOT, ADD, SUB, MUL, DIV, POW, AND, OR, XOR,
+	SIN, COS, TAN, EXP, LOG, SQRT, ABS, HALT
+};
+
+// purpose: counts the operands of an operation
+// requires: the operation
+// returns: 0, 1 or 2
+constexpr unsigned vmArity(vmOp op)
+{
+	return (op <= vmOp::VARIABLE || op == vmOp::HALT) ? 0
+		: (op <= vmOp::NOT || op >= vmOp::SIN) ? 1 : 2;
+}
+
+/* exprKernel */
+
+// purpose: the operations of the virtual machine on one type of value, a
+//	new type of expression specializes it when the defaults do not apply
+// invariants: every member is a static function, so the machine inlines it;
+//	has() tells the operations the type has, found in std or by argument
+//	dependent lookup; a grammar that names another fails consistent() and
+//	the machine refuses to emit it, so the body it keeps to compile, which
+//	returns its first operand, never runs
+template <typename adt>
+struct exprKernel
+{
+	static constexpr bool has(vmOp op)
+	{
+		using std::pow;
+		using std::sin;
+		using std::cos;
+		using std::tan;
+		using std::exp;
+		using std::log;
+		using std::sqrt;
+		using std::abs;
+
+		switch (op)
+		{
+		case vmOp::POW: return requires (adt a) { adt(pow(a, a)); };
+		case vmOp::NOT: return requires (adt a) { adt(!a); };
+		case vmOp::AND: return requires (adt a) { adt(a && a); };
+		case vmOp::OR: return requires (adt a) { adt(a || a); };
+		case vmOp::XOR: return requires (adt a) { adt(!a != !a); };
+		case vmOp::SIN: return requires (adt a) { adt(sin(a)); };
+		case vmOp::COS: return requires (adt a) { adt(cos(a)); };
+		case vmOp::TAN: return requires (adt a) { adt(tan(a)); };
+		case vmOp::EXP: return requires (adt a) { adt(exp(a)); };
+		case vmOp::LOG: return requires (adt a) { adt(log(a)); };
+		case vmOp::SQRT: return requires (adt a) { adt(sqrt(a)); };
+		case vmOp::ABS: return requires (adt a) { adt(abs(a)); };
+		default: return true;
+		}
+	}
+	// from_chars leaves a literal out of range untouched, so it is read
+	//	again the way strtod reads it, infinite when it is too large and 0 or
+	//	subnormal when it is too small; an integer saturates
+	static adt literal(std::string_view text)
+	{
+		const char* end = text.data() + text.size();
+
+		if constexpr (requires (adt& v) { std::from_chars(end, end, v); })
+		{
+			adt value{};
+			if (std::from_chars(text.data(), end, value).ec
+				== std::errc::result_out_of_range)
+				return overflow<adt>(text);
+			return value;
+		}
+		else
+		{
+			long double value = 0;
+			if (std::from_chars(text.data(), end, value).ec
+				== std::errc::result_out_of_range)
+				value = overflow<long double>(text);
+			return adt(value);
+		}
+	}
+	template <typename T>
+	static T overflow(std::string_view text)
+	{
+		const std::string copy(text);
+
+		if constexpr (std::is_same_v<T, float>)
+			return std::strtof(copy.c_str(), nullptr);
+		else if constexpr (std::is_same_v<T, double>)
+			return std::strtod(copy.c_str(), nullptr);
+		else if constexpr (std::is_floating_point_v<T>)
+			return std::strtold(copy.c_str(), nullptr);
+		else
+			return std::numeric_limits<T>::max();
+	}
+	static adt negate(adt a) { return -a; }
+	static adt add(adt a, adt b) { return a + b; }
+	static adt sub(adt a, adt b) { return a - b; }
+	static adt mul(adt a, adt b) { return a * b; }
+	static adt div(adt a, adt b) { return a / b; }
+	static adt pow(adt a, adt b)
+	{
+		using std::pow;
+		if constexpr (has(vmOp::POW)) return pow(a, b);
+		else return a;
+	}
+	static adt logical_not(adt a)
+	{
+		if constexpr (has(vmOp::NOT)) return !a;
+		else return a;
+	}
+	static adt logical_and(adt a, adt b)
+	{
+		if constexpr (has(vmOp::AND)) return a && b;
+		else return a;
+	}
+	static adt logical_or(adt a, adt b)
+	{
+		if constexpr (has(vmOp::OR)) return a || b;
+		else return a;
+	}
+	static adt logical_xor(adt a, adt b)
+	{
+		if constexpr (has(vmOp::XOR)) return !a != !b;
+		else return a;
+	}
+	static adt sin(adt a)
+	{
+		using std::sin;
+		if constexpr (has(vmOp::SIN)) return sin(a);
+		else return a;
+	}
+	static adt cos(adt a)
+	{
+		using std::cos;
+		if constexpr (has(vmOp::COS)) return cos(a);
+		else return a;
+	}
+	static adt tan(adt a)
+	{
+		using std::tan;
+		if constexpr (has(vmOp::TAN)) return tan(a);
+		else return a;
+	}
+	static adt exp(adt a)
+	{
+		using std::exp;
+		if constexpr (has(vmOp::EXP)) return exp(a);
+		else return a;
+	}
+	static adt log(adt a)
+	{
+		using std::log;
+		if constexpr (has(vmOp::LOG)) return log(a);
+		else return a;
+	}
+	static adt sqrt(adt a)
+	{
+		using std::sqrt;
+		if constexpr (has(vmOp::SQRT)) return sqrt(a);
+		else return a;
+	}
+	static adt abs(adt a)
+	{
+		using std::abs;
+		if constexpr (has(vmOp::ABS)) return abs(a);
+		else return a;
+	}
+};
+
+// bits have the logical operations and the arithmetic of the field of two
+//	elements, but no division and no functions
+template <>
+struct exprKernel<bool>
+{
+	static constexpr bool has(vmOp op)
+	{
+		return op != vmOp::DIV && (op < vmOp::SIN || op == vmOp::HALT);
+	}
+	static bool literal(std::string_view text) { return text == "1"; }
+	static bool negate(bool a) { return a; }
+	static bool logical_not(bool a) { return !a; }
+	static bool add(bool a, bool b) { return a != b; }
+	static bool sub(bool a, bool b) { return a != b; }
+	static bool mul(bool a, bool b) { return a && b; }
+	static bool div(bool a, bool) { return a; }
+	static bool pow(bool a, bool b) { return a || !b; }
+	static bool logical_and(bool a, bool b) { return a && b; }
+	static bool logical_or(bool a, bool b) { return a || b; }
+	static bool logical_xor(bool a, bool b) { return a != b; }
+	static bool sin(bool a) { return a; }
+	static bool cos(bool a) { return a; }
+	static bool tan(bool a) { return a; }
+	static bool exp(bool a) { return a; }
+	static bool log(bool a) { return a; }
+	static bool sqrt(bool a) { return a; }
+	static bool abs(bool a) { return a; }
+};
+
+/* exprVM */
+
+// purpose: a compiled expression run on a value stack sized at compile time,
+//	dispatching with computed goto where the compiler has it and a switch
+//	otherwise
+// invariants: 'code' ends with HALT once finish() has been called, and
+//	never pushes more than 'height' values
+// data members:
+//	'code' holds the instructions, 'arg' indexes 'constants' for VALUE and
+//	the variables for VARIABLE
+//	'constants' holds the literals
+//	'height' is the most values on the stack at once
+template <typename adt>
+class exprVM
+{
+public:
+		/* prerequisites */
+
+	// one instruction
+	struct instr
+	{
+		vmOp code;
+		std::uint32_t arg;
+	};
+
+	// a literal, wrapped so a vector of bools still has data()
+	struct literal
+	{
+		adt value;
+	};
+
+private:
+		/* member variables */
+
+	// stacks at most this high live in the frame of run(), higher ones in
+	//	a buffer of the thread
+	static constexpr std::size_t LOCAL = 32;
+
+	std::vector<instr> code;
+
+	std::vector<literal> constants;
+
+	std::size_t height = 0;
+
+	std::size_t level = 0;
+
+		/* member functions */
+
+	// purpose: finds a stack higher than LOCAL, kept by the calling thread
+	//	and only ever grown, so a run allocates only the first time its
+	//	thread sees a program that high
+	// requires: the height
+	// returns: the stack
+	static adt* spill(std::size_t);
+
+	// purpose: runs programs from an instruction on values of type V, each
+	//	operation through exprKernel<V>
+	// requires: where to start, the value of every variable by index, and
+	//	a sink void(V) for ALL
+	// returns: the result of the program that starts there, or with ALL
+	//	passes the result of every program from there on to the sink
+	template <typename V, bool ALL, class Out>
+	V execute(std::size_t, const V*, Out&) const;
+
+public:
+
+		/* member functions */
+
+	// purpose: forgets the program, to compile a new one
+	// requires: nothing
+	// returns: nothing
+	void clear();
+
+	// purpose: appends an instruction
+	// requires: the opcode, one exprKernel<adt> has, and the index of the
+	//	variable for VARIABLE
+	// returns: nothing, or throws when the kernel does not have the opcode
+	void emit(vmOp, std::uint32_t = 0);
+
+	// purpose: appends an instruction pushing a literal
+	// requires: the value
+	// returns: nothing
+	void push(adt);
+
+	// purpose: ends the program, another can be appended after it
+	// requires: nothing
+	// returns: nothing
+	void finish() { code.push_back(instr{ vmOp::HALT, 0 }); level = 0; }
+
+	// purpose: appends the programs of another machine
+	// requires: the machine, and the index here of each of its variables
+	// returns: nothing
+	void append(const exprVM&, const std::uint32_t*);
+
+	// purpose: checks whether there is a program
+	// requires: nothing
+	// returns: a bool
+	bool empty() const { return code.size() <= 1; }
+
+	// purpose: counts the instructions, i.e. where the next program starts
+	// requires: nothing
+	// returns: a size
+	std::size_t size() const { return code.size(); }
+
+	// purpose: finds how much memory the programs take
+	// requires: nothing
+	// returns: a number of bytes
+	std::size_t bytes() const
+	{ return code.capacity() * sizeof(instr)
+		+ constants.capacity() * sizeof(literal); }
+
+	// purpose: runs the program
+	// requires: the value of every variable, by index
+	// returns: the result, or adt() when the program is empty
+	adt run(const adt*) const;
+
+	// purpose: runs the program that starts at an instruction
+	// requires: where it starts and the value of every variable, by index
+	// returns: the result
+	adt run(std::size_t, const adt*) const;
+
+	// purpose: runs every program in order in one pass over the code, the
+	//	stack is reset at each HALT instead of returning
+	// requires: the value of every variable, by index, and a sink void(adt)
+	// returns: nothing, but passes each result to the sink
+	template <class Out>
+	void run_all(const adt*, Out) const;
+
+	// purpose: runs the program on another type of value, each operation
+	//	through the kernel of that type, e.g. to build a graph of it
+	// requires: the value of every variable by index, of a type a literal
+	//	converts to and whose kernel has every opcode of the program
+	// returns: the result, or V() when the program is empty
+	template <typename V>
+	V run_as(const V*) const;
+
+};
+
+
+	/* methods */
+
+/* public */
+
+template <typename adt>
+void exprVM<adt>::clear()
+{
+	code.clear();
+	constants.clear();
+	height = level = 0;
+}
+
+// the height of the stack is tracked as the program grows
+template <typename adt>
+void exprVM<adt>::emit(vmOp op, std::uint32_t arg)
+{
+	if (!exprKernel<adt>::has(op))
+		throw std::invalid_argument("The values of the machine do not have"
+			" this operation\n");
+
+	if (vmArity(op) == 0)
+		height = std::max(height, ++level);
+	else if (vmArity(op) == 2)
+		level--;
+
+	code.push_back(instr{ op, arg });
+}
+
+template <typename adt>
+void exprVM<adt>::push(adt value)
+{
+	emit(vmOp::VALUE, static_cast<std::uint32_t>(constants.size()));
+	constants.push_back(literal{ value });
+}
+
+// the constants are appended after these, so a VALUE moves by their count
+template <typename adt>
+void exprVM<adt>::append(const exprVM& other, const std::uint32_t* vars)
+{
+	const std::uint32_t shift = static_cast<std::uint32_t>(constants.size());
+
+	code.reserve(code.size() + other.code.size());
+	for (instr i : other.code)
+	{
+		if (i.code == vmOp::VALUE)
+			i.arg += shift;
+		else if (i.code == vmOp::VARIABLE)
+			i.arg = vars[i.arg];
+		code.push_back(i);
+	}
+
+	constants.insert(constants.end(), other.constants.begin(),
+		other.constants.end());
+	height = std::max(height, other.height);
+	level = 0;
+}
+
+template <typename adt>
+adt exprVM<adt>::run(const adt* vars) const
+{
+	int none = 0;
+
+	return empty() ? adt() : execute<adt, false>(0, vars, none);
+}
+
+template <typename adt>
+adt exprVM<adt>::run(std::size_t start, const adt* vars) const
+{
+	int none = 0;
+
+	return execute<adt, false>(start, vars, none);
+}
+
+template <typename adt>
+template <class Out>
+void exprVM<adt>::run_all(const adt* vars, Out out) const
+{
+	if (!code.empty())
+		execute<adt, true>(0, vars, out);
+}
+
+template <typename adt>
+template <typename V>
+V exprVM<adt>::run_as(const V* vars) const
+{
+	int none = 0;
+
+	return empty() ? V() : execute<V, false>(0, vars, none);
+}
+
+	/* private */
+
+// a machine is shared by threads that run it at once, so the buffer belongs
+//	to the thread rather than to the machine
+template <typename adt>
+adt* exprVM<adt>::spill(std::size_t n)
+{
+	thread_local std::unique_ptr<adt[]> stack;
+	thread_local std::size_t room = 0;
+
+	if (room < n)
+	{
+		stack.reset(new adt[n]);
+		room = n;
+	}
+
+	return stack.get();
+}
+
+// each handler ends by jumping straight to the next instruction's handler,
+//	so the branch predictor sees one indirect jump per handler instead of
+//	one shared jump for every instruction
+//	another type of value keeps its stack for the one run, since its values
+//	may own memory that a buffer of the thread would hold on to
+template <typename adt>
+template <typename V, bool ALL, class Out>
+V exprVM<adt>::execute(std::size_t start, const V* vars, Out& out) const
+{
+	typedef exprKernel<V> K;
+	static constexpr bool NATIVE = std::is_same_v<V, adt>;
+
+	V local[NATIVE ? LOCAL : 1];
+	std::unique_ptr<V[]> owned;
+	V* base = local;
+
+	if constexpr (NATIVE)
+	{
+		if (height > LOCAL)
+			base = spill(height);
+	}
+	else
+	{
+		owned.reset(new V[height]);
+		base = owned.get();
+	}
+
+	// one past the last value, so an empty stack is top == base
+	V* top = base;
+
+	const instr* ip = code.data() + start;
+	[[maybe_unused]] const instr* const end = code.data() + code.size();
+	const literal* values = constants.data();
+
+#ifdef TECAF_THREADED
+	// in the order of vmOp
+	static const void* const handlers[] = {
+		&&VALUE, &&VARIABLE, &&NEGATE, &&NOT, &&ADD, &&SUB, &&MUL, &&DIV,
+		&&POW, &&AND, &&OR, &&XOR, &&SIN, &&COS, &&TAN, &&EXP, &&LOG, &&SQRT,
+		&&ABS, &&HALT };
+
+#define TECAF_NEXT goto *handlers[static_cast<int>((++ip)->code)]
+
+	goto *handlers[static_cast<int>(ip->code)];
+
+VALUE: *top++ = V(values[ip->arg].value); TECAF_NEXT;
+VARIABLE: *top++ = vars[ip->arg]; TECAF_NEXT;
+NEGATE: top[-1] = K::negate(top[-1]); TECAF_NEXT;
+NOT: top[-1] = K::logical_not(top[-1]); TECAF_NEXT;
+ADD: top--; top[-1] = K::add(top[-1], *top); TECAF_NEXT;
+SUB: top--; top[-1] = K::sub(top[-1], *top); TECAF_NEXT;
+MUL: top--; top[-1] = K::mul(top[-1], *top); TECAF_NEXT;
+DIV: top--; top[-1] = K::div(top[-1], *top); TECAF_NEXT;
+POW: top--; top[-1] = K::pow(top[-1], *top); TECAF_NEXT;
+AND: top--; top[-1] = K::logical_and(top[-1], *top); TECAF_NEXT;
+OR: top--; top[-1] = K::logical_or(top[-1], *top); TECAF_NEXT;
+XOR: top--; top[-1] = K::logical_xor(top[-1], *top); TECAF_NEXT;
+SIN: top[-1] = K::sin(top[-1]); TECAF_NEXT;
+COS: top[-1] = K::cos(top[-1]); TECAF_NEXT;
+TAN: top[-1] = K::tan(top[-1]); TECAF_NEXT;
+EXP: top[-1] = K::exp(top[-1]); TECAF_NEXT;
+LOG: top[-1] = K::log(top[-1]); TECAF_NEXT;
+SQRT: top[-1] = K::sqrt(top[-1]); TECAF_NEXT;
+ABS: top[-1] = K::abs(top[-1]); TECAF_NEXT;
+HALT:
+	if constexpr (ALL)
+	{
+		out(top == base ? V() : top[-1]);
+		top = base;
+		if (ip + 1 != end)
+			TECAF_NEXT;
+		return V();
+	}
+	else
+		return top == base ? V() : top[-1];
+
+#undef TECAF_NEXT
+#else
+	for (;; ip++)
+	{
+		switch (ip->code)
+		{
+		case vmOp::VALUE: *top++ = V(values[ip->arg].value); break;
+		case vmOp::VARIABLE: *top++ = vars[ip->arg]; break;
+		case vmOp::NEGATE: top[-1] = K::negate(top[-1]); break;
+		case vmOp::NOT: top[-1] = K::logical_not(top[-1]); break;
+		case vmOp::ADD: top--; top[-1] = K::add(top[-1], *top); break;
+		case vmOp::SUB: top--; top[-1] = K::sub(top[-1], *top); break;
+		case vmOp::MUL: top--; top[-1] = K::mul(top[-1], *top); break;
+		case vmOp::DIV: top--; top[-1] = K::div(top[-1], *top); break;
+		case vmOp::POW: top--; top[-1] = K::pow(top[-1], *top); break;
+		case vmOp::AND: top--; top[-1] = K::logical_and(top[-1], *top); break;
+		case vmOp::OR: top--; top[-1] = K::logical_or(top[-1], *top); break;
+		case vmOp::XOR: top--; top[-1] = K::logical_xor(top[-1], *top); break;
+		case vmOp::SIN: top[-1] = K::sin(top[-1]); break;
+		case vmOp::COS: top[-1] = K::cos(top[-1]); break;
+		case vmOp::TAN: top[-1] = K::tan(top[-1]); break;
+		case vmOp::EXP: top[-1] = K::exp(top[-1]); break;
+		case vmOp::LOG: top[-1] = K::log(top[-1]); break;
+		case vmOp::SQRT: top[-1] = K::sqrt(top[-1]); break;
+		case vmOp::ABS: top[-1] = K::abs(top[-1]); break;
+		default:
+			if constexpr (ALL)
+			{
+				out(top == base ? V() : top[-1]);
+				top = base;
+				if (ip + 1 != end)
+					break;
+				return V();
+			}
+			else
+				return top == base ? V() : top[-1];
+		}
+	}
+#endif
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <utility>
+#include <vector>
+
+
+/* prototypes */
+
+// purpose: computes the discrete fourier transform of a sequence in place,
+//	X[k] = sum x[j] e^(-2 pi i jk / n), any length is accepted
+// requires: a sequence, and true for the inverse transform (which divides
+//	by n), by default false
+// returns: nothing, but overwrites the sequence
+void fft(std::vector<std::complex<double>>&, bool = false);
+
+
+/* classes */
+
+// purpose: the precomputed tables for transforms of one length
+// invariants: plans are created once per length through get() and never
+//	change afterwards, so they can be shared between threads
+// data members:
+//	'n' is the length of the transform
+//	'rev' is the bit reversal permutation of a power of two length
+//	'twr' and 'twi' hold the twiddles of every radix-2 stage back to back,
+//	the stage of half length m starts at m - 1, so each butterfly loop reads
+//	them with unit stride
+//	'inner' is the power of two plan Bluestein's algorithm convolves with
+//	'chr', 'chi' are the chirp, and 'kr', 'ki' the transformed kernel
+class fftPlan
+{
+private:
+		/* member variables */
+
+	std::size_t n;
+
+	std::vector<std::size_t> rev;
+
+	std::vector<double> twr;
+
+	std::vector<double> twi;
+
+	const fftPlan* inner = nullptr;
+
+	std::vector<double> chr;
+
+	std::vector<double> chi;
+
+	std::vector<double> kr;
+
+	std::vector<double> ki;
+
+		/* constructors */
+
+	// parametrized constructor
+	// builds the tables of a given length
+	explicit fftPlan(std::size_t);
+
+		/* member functions */
+
+	// purpose: runs the radix-2 butterflies
+	// requires: split real and imaginary parts, and the direction
+	// returns: nothing, but transforms the data
+	void radix2(double*, double*, bool) const;
+
+	// purpose: runs Bluestein's chirp-z algorithm for other lengths
+	// requires: split real and imaginary parts, and the direction
+	// returns: nothing, but transforms the data
+	void bluestein(double*, double*, bool) const;
+
+public:
+
+		/* member functions */
+
+	// purpose: finds the plan of a length, building it on first use
+	// requires: a length
+	// returns: the cached plan
+	static const fftPlan& get(std::size_t);
+
+	// purpose: finds the length of the transform
+	// requires: nothing
+	// returns: a size
+	std::size_t size() const { return n; }
+
+	// purpose: transforms split complex data, without normalization
+	// requires: n real parts, n imaginary parts and the direction
+	// returns: nothing, but transforms the data in place
+	void execute(double*, double*, bool = false) const;
+
+};
+
+
+	/* definitions */
+
+void fft(std::vector<std::complex<double>>& data, bool inverse)
+{
+	const std::size_t n = data.size();
+	std::vector<double> re(n), im(n);
+
+	if (n < 2)
+		return;
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		re[i] = data[i].real();
+		im[i] = data[i].imag();
+	}
+
+	fftPlan::get(n).execute(re.data(), im.data(), inverse);
+
+	for (std::size_t i = 0; i < n; i++)
+		data[i] = inverse ? std::complex<double>(re[i] / n, im[i] / n)
+			: std::complex<double>(re[i], im[i]);
+}
+
+
+		/* fftPlan */
+
+	/* constructors */
+
+fftPlan::fftPlan(std::size_t size) : n(size)
+{
+	const double pi = std::numbers::pi;
+
+	if (n > 1 && (n & (n - 1)) == 0)
+	{
+		std::size_t bits = 0;
+		while ((std::size_t(1) << bits) < n) bits++;
+
+		rev.resize(n);
+		for (std::size_t i = 0; i < n; i++)
+		{
+			std::size_t r = 0;
+			for (std::size_t b = 0; b < bits; b++)
+				r |= ((i >> b) & 1) << (bits - 1 - b);
+			rev[i] = r;
+		}
+
+		twr.resize(n - 1);
+		twi.resize(n - 1);
+		for (std::size_t half = 1; half < n; half <<= 1)
+			for (std::size_t j = 0; j < half; j++)
+			{
+				twr[half - 1 + j] = std::cos(-pi * j / half);
+				twi[half - 1 + j] = std::sin(-pi * j / half);
+			}
+	}
+	else if (n > 1)
+	{
+		// w_k = e^(-i pi k^2 / n), k^2 is reduced mod 2n to keep the angle
+		//	accurate for long transforms
+		std::size_t m = 1;
+		while (m < 2 * n - 1) m <<= 1;
+
+		inner = &get(m);
+		chr.resize(n);
+		chi.resize(n);
+		for (std::size_t k = 0; k < n; k++)
+		{
+			const double angle = -pi * static_cast<double>((k * k) % (2 * n))
+				/ static_cast<double>(n);
+			chr[k] = std::cos(angle);
+			chi[k] = std::sin(angle);
+		}
+
+		// the kernel is the conjugate chirp, wrapped around for negative k
+		kr.assign(m, 0.0);
+		ki.assign(m, 0.0);
+		for (std::size_t k = 0; k < n; k++)
+		{
+			kr[k] = chr[k];
+			ki[k] = -chi[k];
+			if (k > 0)
+			{
+				kr[m - k] = chr[k];
+				ki[m - k] = -chi[k];
+			}
+		}
+		inner->execute(kr.data(), ki.data(), false);
+	}
+}
+
+
+	/* methods */
+
+/* private */
+
+void fftPlan::radix2(double* re, double* im, bool inverse) const
+{
+	const double sign = inverse ? -1.0 : 1.0;
+
+	for (std::size_t i = 0; i < n; i++)
+		if (i < rev[i])
+		{
+			std::swap(re[i], re[rev[i]]);
+			std::swap(im[i], im[rev[i]]);
+		}
+
+	for (std::size_t half = 1; half < n; half <<= 1)
+	{
+		const double* wr = twr.data() + half - 1;
+		const double* wi = twi.data() + half - 1;
+
+		for (std::size_t i = 0; i < n; i += 2 * half)
+		{
+			double* ar = re + i;
+			double* ai = im + i;
+			double* br = re + i + half;
+			double* bi = im + i + half;
+
+			// independent lanes with unit stride, so this loop vectorizes
+			for (std::size_t j = 0; j < half; j++)
+			{
+				const double vr = br[j] * wr[j] - bi[j] * sign * wi[j];
+				const double vi = br[j] * sign * wi[j] + bi[j] * wr[j];
+
+				br[j] = ar[j] - vr;
+				bi[j] = ai[j] - vi;
+				ar[j] += vr;
+				ai[j] += vi;
+			}
+		}
+	}
+}
+
+// X = w . ((x . w) conv conj(w)), the convolution runs through the inner
+//	power of two plan
+void fftPlan::bluestein(double* re, double* im, bool inverse) const
+{
+	const std::size_t m = inner->size();
+	const double sign = inverse ? -1.0 : 1.0;
+	thread_local std::vector<double> ar, ai;
+	double r, i;
+
+	ar.assign(m, 0.0);
+	ai.assign(m, 0.0);
+
+	for (std::size_t k = 0; k < n; k++)
+	{
+		ar[k] = re[k] * chr[k] - im[k] * sign * chi[k];
+		ai[k] = re[k] * sign * chi[k] + im[k] * chr[k];
+	}
+
+	inner->execute(ar.data(), ai.data(), false);
+
+	// the inverse chirp's kernel is the conjugate of the forward one
+	for (std::size_t k = 0; k < m; k++)
+	{
+		r = ar[k] * kr[k] - ai[k] * sign * ki[k];
+		i = ar[k] * sign * ki[k] + ai[k] * kr[k];
+		ar[k] = r;
+		ai[k] = i;
+	}
+
+	inner->execute(ar.data(), ai.data(), true);
+
+	for (std::size_t k = 0; k < n; k++)
+	{
+		r = ar[k] / m;
+		i = ai[k] / m;
+		re[k] = r * chr[k] - i * sign * chi[k];
+		im[k] = r * sign * chi[k] + i * chr[k];
+	}
+}
+
+/* public */
+
+const fftPlan& fftPlan::get(std::size_t n)
+{
+	static std::mutex guard;
+	static std::map<std::size_t, std::unique_ptr<const fftPlan>> cache;
+	std::unique_ptr<const fftPlan> built;
+
+	{
+		std::lock_guard<std::mutex> lock(guard);
+		auto found = cache.find(n);
+		if (found != cache.end())
+			return *found->second;
+	}
+
+	// build outside the lock, Bluestein plans fetch their inner plan
+	built.reset(new fftPlan(n));
+
+	std::lock_guard<std::mutex> lock(guard);
+	// another thread may have won the race, its plan is kept
+	return *cache.emplace(n, std::move(built)).first->second;
+}
+
+void fftPlan::execute(double* re, double* im, bool inverse) const
+{
+	if (n < 2)
+		return;
+	else if (!rev.empty())
+		radix2(re, im, inverse);
+	else
+		bluestein(re, im, inverse);
+}
@@ -0,0 +1,468 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TECAF_MMAP 1
+#endif
+
+#include "realfxn.hpp"
+
+
+// purpose: a compiled realFxN in a compact, versioned binary format that is
+//	evaluated in place, i.e. straight out of a memory mapped file
+// invariants: the buffer starts with a header, followed by the steps, the
+//	table descriptors and the table data, each section aligned for long
+//	double; loading only checks the header, so it costs the same for any
+//	graph, verify() checks every step for untrusted input
+// data members:
+//	'owner' keeps the buffer alive (a mapping, a vector or nothing when the
+//	caller owns it)
+//	'head' points at the header at the start of the buffer
+//	'prog' is the program read from the buffer
+class fxImage
+{
+public:
+		/* prerequisites */
+
+	// the format version this header writes and reads
+	static constexpr std::uint16_t VERSION = 1;
+
+	// the layout of the start of an image
+	// the size fields reject images written by a different ABI, e.g. where
+	//	long double is 8 bytes or the byte order differs
+	struct header
+	{
+		char magic[4];
+		std::uint16_t version;
+		std::uint8_t ldbl_size;
+		std::uint8_t step_size;
+		std::uint32_t table_size;
+		std::uint32_t byte_order;
+		std::uint64_t steps;
+		std::uint64_t tables;
+		std::uint64_t values;
+		std::uint64_t dimension;
+		std::uint64_t step_offset;
+		std::uint64_t table_offset;
+		std::uint64_t data_offset;
+		std::uint64_t total;
+	};
+
+private:
+		/* member variables */
+
+	std::shared_ptr<const void> owner;
+
+	const header* head = nullptr;
+
+	realFxN::view prog{};
+
+		/* member functions */
+
+	// purpose: rounds an offset up to the alignment of long double
+	// requires: an offset
+	// returns: the aligned offset
+	static std::uint64_t align(std::uint64_t n)
+	{ return (n + alignof(long double) - 1) / alignof(long double)
+		* alignof(long double); }
+
+	// purpose: checks the header and points the program into the buffer
+	// requires: a buffer and its size
+	// returns: nothing, but throws if the header does not describe it
+	void attach(const void*, std::size_t);
+
+public:
+
+		/* constructors */
+
+	// default constructor
+	// an empty image, it cannot be evaluated
+	fxImage() {}
+
+	// parametrized constructor
+	// views a buffer the caller keeps alive, nothing is copied
+	fxImage(const void*, std::size_t);
+
+		/* factories */
+
+	// purpose: serializes a function
+	// requires: a function
+	// returns: the bytes of its image
+	static std::vector<unsigned char> serialize(const realFxN&);
+
+	// purpose: serializes a function into a file
+	// requires: a function and a path
+	// returns: nothing
+	static void save(const realFxN&, const std::string&);
+
+	// purpose: opens the image in a file, memory mapping it where the
+	//	platform allows it
+	// requires: a path
+	// returns: the image
+	static fxImage open(const std::string&);
+
+	// purpose: takes ownership of serialized bytes
+	// requires: the bytes of an image
+	// returns: the image
+	static fxImage from_bytes(std::vector<unsigned char>);
+
+		/* member functions */
+
+	// purpose: checks that every step only reads earlier steps, variables
+	//	below the dimension and tables inside the data
+	// requires: nothing
+	// returns: true if the image is safe to evaluate
+	bool verify() const;
+
+	// purpose: finds how many coordinates the function reads
+	// requires: nothing
+	// returns: a size
+	std::size_t dimension() const { return prog.dimension; }
+
+	// purpose: finds the number of steps of the program
+	// requires: nothing
+	// returns: a size
+	std::size_t size() const { return prog.size; }
+
+	// purpose: finds the program inside the buffer
+	// requires: nothing
+	// returns: a view that stays valid as long as this image
+	const realFxN::view& program_view() const { return prog; }
+
+	// purpose: evaluates the function and its full gradient
+	// requires: a point and a vector to hold the gradient
+	// returns: the value at the point
+	long double gradient(const std::vector<long double>&,
+		std::vector<long double>&) const;
+
+	// purpose: evaluates the function at many points at once
+	// requires: the points stored one after another, the number of points
+	//	and an output of 'count' values
+	// returns: nothing, but fills the output
+	void evaluate_batch(const long double*, std::size_t, long double*) const;
+
+		/* operators */
+
+	// purpose: evaluates the function at a point
+	// requires: a point with at least dimension() coordinates
+	// returns: a long double, i.e. the result
+	long double operator()(const std::vector<long double>&) const;
+
+	// purpose: evaluates the function at a point
+	// requires: a pointer to at least dimension() coordinates
+	// returns: a long double, i.e. the result
+	long double operator()(const long double*) const;
+
+};
+
+
+	/* constructors */
+
+fxImage::fxImage(const void* data, std::size_t size)
+{
+	attach(data, size);
+}
+
+
+	/* factories */
+
+std::vector<unsigned char> fxImage::serialize(const realFxN& f)
+{
+	const realFxN::view p = f.program_view();
+	header h{};
+	std::vector<unsigned char> out;
+
+	std::memcpy(h.magic, "TCFX", 4);
+	h.version = VERSION;
+	h.ldbl_size = sizeof(long double);
+	h.step_size = sizeof(realFxN::instruction);
+	h.table_size = sizeof(realFxN::table);
+	h.byte_order = 0x01020304;
+	h.steps = p.size;
+	h.dimension = p.dimension;
+	h.step_offset = align(sizeof(header));
+	h.tables = p.table_count;
+	h.values = p.data_size;
+	h.table_offset = align(h.step_offset + p.size * h.step_size);
+	h.data_offset = align(h.table_offset + h.tables * h.table_size);
+	h.total = h.data_offset + h.values * sizeof(long double);
+
+	// zero filled, so the padding between record fields is deterministic
+	out.assign(h.total, 0);
+	std::memcpy(out.data(), &h, sizeof(header));
+
+	for (std::size_t i = 0; i < p.size; i++)
+	{
+		unsigned char* at = out.data() + h.step_offset + i * h.step_size;
+		const realFxN::instruction& s = p.steps[i];
+
+		std::memcpy(at + offsetof(realFxN::instruction, code), &s.code,
+			sizeof(s.code));
+		std::memcpy(at + offsetof(realFxN::instruction, lhs), &s.lhs,
+			sizeof(s.lhs));
+		std::memcpy(at + offsetof(realFxN::instruction, rhs), &s.rhs,
+			sizeof(s.rhs));
+		std::memcpy(at + offsetof(realFxN::instruction, value), &s.value,
+			sizeof(long double));
+	}
+
+	for (std::size_t i = 0; i < h.tables; i++)
+	{
+		unsigned char* at = out.data() + h.table_offset + i * h.table_size;
+		const realFxN::table& t = p.tables[i];
+
+		std::memcpy(at + offsetof(realFxN::table, left), &t.left,
+			sizeof(long double));
+		std::memcpy(at + offsetof(realFxN::table, right), &t.right,
+			sizeof(long double));
+		std::memcpy(at + offsetof(realFxN::table, count), &t.count,
+			sizeof(t.count));
+		std::memcpy(at + offsetof(realFxN::table, offset), &t.offset,
+			sizeof(t.offset));
+	}
+
+	if (h.values)
+		std::memcpy(out.data() + h.data_offset, p.data,
+			h.values * sizeof(long double));
+
+	return out;
+}
+
+void fxImage::save(const realFxN& f, const std::string& path)
+{
+	const std::vector<unsigned char> bytes = serialize(f);
+	std::FILE* out = std::fopen(path.c_str(), "wb");
+	bool ok;
+
+	if (!out)
+		throw std::runtime_error("Could not open " + path + "\n");
+
+	ok = std::fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+	ok = (std::fclose(out) == 0) && ok;
+
+	if (!ok)
+		throw std::runtime_error("Could not write " + path + "\n");
+}
+
+fxImage fxImage::open(const std::string& path)
+{
+	fxImage image;
+
+#ifdef TECAF_MMAP
+	int fd = ::open(path.c_str(), O_RDONLY);
+	struct stat info;
+
+	if (fd < 0 || ::fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		if (fd >= 0) ::close(fd);
+		throw std::runtime_error("Could not open " + path + "\n");
+	}
+
+	const std::size_t size = static_cast<std::size_t>(info.st_size);
+	void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (map == MAP_FAILED)
+		throw std::runtime_error("Could not map " + path + "\n");
+
+	image.owner = std::shared_ptr<const void>(map,
+		[size](const void* p) { ::munmap(const_cast<void*>(p), size); });
+	image.attach(map, size);
+#else
+	std::FILE* in = std::fopen(path.c_str(), "rb");
+	std::vector<unsigned char> bytes;
+	unsigned char block[1 << 16];
+	std::size_t got;
+
+	if (!in)
+		throw std::runtime_error("Could not open " + path + "\n");
+
+	while ((got = std::fread(block, 1, sizeof(block), in)) > 0)
+		bytes.insert(bytes.end(), block, block + got);
+	std::fclose(in);
+
+	image = from_bytes(std::move(bytes));
+#endif
+
+	return image;
+}
+
+fxImage fxImage::from_bytes(std::vector<unsigned char> bytes)
+{
+	auto held = std::make_shared<std::vector<unsigned char>>(std::move(bytes));
+	fxImage image;
+
+	image.owner = held;
+	image.attach(held->data(), held->size());
+
+	return image;
+}
+
+
+	/* methods */
+
+/* private */
+
+void fxImage::attach(const void* data, std::size_t size)
+{
+	const unsigned char* base = static_cast<const unsigned char*>(data);
+
+	if (size < sizeof(header))
+		throw std::invalid_argument("Buffer is too small to be an image\n");
+	if (reinterpret_cast<std::uintptr_t>(data) % alignof(long double) != 0)
+		throw std::invalid_argument("Image buffer must be aligned for long"
+			" double\n");
+
+	head = reinterpret_cast<const header*>(base);
+
+	// a section fits when its offset does and its count is bounded by a
+	//	division, so a crafted count cannot wrap the product
+	auto fits = [this](std::uint64_t offset, std::uint64_t count,
+		std::uint64_t size)
+		{
+			return offset <= head->total
+				&& count <= (head->total - offset) / size;
+		};
+
+	if (std::memcmp(head->magic, "TCFX", 4) != 0)
+		throw std::invalid_argument("Buffer is not a tecaf function image\n");
+	if (head->version != VERSION)
+		throw std::invalid_argument("Unsupported image version "
+			+ std::to_string(head->version) + "\n");
+	if (head->ldbl_size != sizeof(long double)
+		|| head->step_size != sizeof(realFxN::instruction)
+		|| head->table_size != sizeof(realFxN::table)
+		|| head->byte_order != 0x01020304)
+		throw std::invalid_argument("Image was written for a different"
+			" platform\n");
+	if (head->steps == 0 || head->total > size
+		|| !fits(head->step_offset, head->steps, head->step_size)
+		|| !fits(head->table_offset, head->tables, head->table_size)
+		|| !fits(head->data_offset, head->values, sizeof(long double))
+		|| head->step_offset % alignof(long double)
+		|| head->table_offset % alignof(long double)
+		|| head->data_offset % alignof(long double))
+		throw std::invalid_argument("Image sections do not fit the buffer\n");
+
+	prog.steps = reinterpret_cast<const realFxN::instruction*>(
+		base + head->step_offset);
+	prog.size = head->steps;
+	prog.tables = reinterpret_cast<const realFxN::table*>(
+		base + head->table_offset);
+	prog.table_count = head->tables;
+	prog.data = reinterpret_cast<const long double*>(base + head->data_offset);
+	prog.data_size = head->values;
+	prog.dimension = head->dimension;
+}
+
+/* public */
+
+bool fxImage::verify() const
+{
+	using op = realFxN::op;
+
+	if (!head)
+		return false;
+
+	for (std::size_t i = 0; i < prog.size; i++)
+	{
+		const realFxN::instruction& s = prog.steps[i];
+
+		if (s.code > op::TABLE)
+			return false;
+		else if (s.code == op::VAR)
+		{
+			if (s.lhs >= prog.dimension) return false;
+		}
+		else if (s.code != op::CONST)
+		{
+			if (s.lhs >= i || (s.code != op::TABLE && s.rhs >= i))
+				return false;
+		}
+
+		if (s.code == op::TABLE)
+		{
+			if (s.rhs >= prog.table_count) return false;
+
+			const realFxN::table& t = prog.tables[s.rhs];
+			if (t.count < 2 || t.offset > prog.data_size
+				|| t.count > prog.data_size - t.offset)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+long double fxImage::gradient(const std::vector<long double>& x,
+	std::vector<long double>& grad) const
+{
+	thread_local std::vector<long double> arena;
+
+	if (!head)
+		throw std::invalid_argument("Image is empty\n");
+	if (x.size() < prog.dimension)
+		throw std::invalid_argument("Point has fewer coordinates than the"
+			" function has variables\n");
+
+	arena.resize(2 * prog.size);
+	grad.assign(std::max(x.size(), prog.dimension), 0.0l);
+
+	realFxN::forward(prog, x.data(), arena.data());
+	realFxN::reverse(prog, arena.data(), arena.data() + prog.size,
+		grad.data());
+
+	return arena[prog.size - 1];
+}
+
+void fxImage::evaluate_batch(const long double* xs, std::size_t count,
+	long double* out) const
+{
+	if (!head)
+		throw std::invalid_argument("Image is empty\n");
+
+	std::vector<long double> v(prog.size * realFxN::BATCH);
+
+	for (std::size_t base = 0; base < count; base += realFxN::BATCH)
+		realFxN::forward_batch(prog, xs + base * prog.dimension,
+			std::min(realFxN::BATCH, count - base), v.data(), out + base);
+}
+
+
+	/* operators */
+
+long double fxImage::operator()(const std::vector<long double>& x) const
+{
+	if (x.size() < prog.dimension)
+		throw std::invalid_argument("Point has fewer coordinates than the"
+			" function has variables\n");
+
+	return (*this)(x.data());
+}
+
+long double fxImage::operator()(const long double* x) const
+{
+	thread_local std::vector<long double> arena;
+
+	if (!head)
+		throw std::invalid_argument("Image is empty\n");
+
+	arena.resize(prog.size);
+	realFxN::forward(prog, x, arena.data());
+
+	return arena[prog.size - 1];
+}
@@ -0,0 +1,410 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cfloat>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TECAF_MMAP 1
+#endif
+
+#include "realfx.hpp"
+
+
+// purpose: evaluates a function over a raw binary column of values, i.e.
+//	reads x values from a file or stdin, writes f(x) to a file or stdout
+// invariants: the input is a headerless array of native endian values in
+//	the input format, the output is the same in the output format
+// data members:
+//	'fx' is the function being evaluated
+//	'in_fmt' and 'out_fmt' are the input and output value formats
+//	'chunk' is the number of values evaluated per batch
+class fxStream
+{
+public:
+		/* prerequisites */
+
+	// the binary value formats a stream reads or writes
+	// F64 is an IEEE double, F80 is an x87 extended double packed in 10 bytes
+	enum class format { F64, F80 };
+
+private:
+		/* prerequisites */
+
+	// a batch of values moving through the pipeline
+	struct batch
+	{
+		std::vector<long double> values;
+		std::size_t count = 0;
+	};
+
+	// purpose: a blocking hand-off between two pipeline stages
+	// invariants: nullptr marks the end of the stream
+	class handoff
+	{
+	private:
+		std::mutex guard;
+		std::condition_variable ready;
+		std::deque<batch*> items;
+
+	public:
+		void push(batch* b)
+		{
+			{
+				std::lock_guard<std::mutex> lock(guard);
+				items.push_back(b);
+			}
+			ready.notify_one();
+		}
+
+		batch* pop()
+		{
+			std::unique_lock<std::mutex> lock(guard);
+			ready.wait(lock, [this]() { return !items.empty(); });
+			batch* b = items.front();
+			items.pop_front();
+			return b;
+		}
+	};
+
+	// how many batches each side of the evaluation stage can hold, i.e.
+	//	reading and writing are double buffered
+	static constexpr std::size_t DEPTH = 2;
+
+		/* member variables */
+
+	realFx fx;
+
+	format in_fmt;
+
+	format out_fmt;
+
+	std::size_t chunk;
+
+		/* member functions */
+
+	// purpose: finds the number of bytes of one value
+	// requires: a format
+	// returns: a size
+	static std::size_t width(format f) { return (f == format::F64) ? 8 : 10; }
+
+	// purpose: decodes raw values into long doubles
+	// requires: the raw bytes, the output and the count
+	// returns: nothing, but fills the output
+	void decode(const unsigned char*, long double*, std::size_t) const;
+
+	// purpose: encodes long doubles into raw values
+	// requires: the values, the raw output and the count
+	// returns: nothing, but fills the output
+	void encode(const long double*, unsigned char*, std::size_t) const;
+
+	// purpose: runs the three stages over a source of raw bytes
+	// requires: a function that fills a buffer with up to n raw bytes and
+	//	returns how many it wrote (0 at the end), and the output file
+	// returns: the number of values evaluated
+	template <typename Source>
+	std::size_t pipeline(Source, std::FILE*);
+
+public:
+
+		/* constructors */
+
+	// parametrized constructor
+	// takes the function, the input and output formats (F64 by default) and
+	//	the number of values per batch, by default 4096 which keeps a batch
+	//	of inputs and outputs inside L1/L2
+	fxStream(const realFx&, format = format::F64, format = format::F64,
+		std::size_t = 4096);
+
+		/* member functions */
+
+	// purpose: evaluates every value of an input file into an output file
+	// requires: an input path and an output path, "-" means stdin / stdout
+	// returns: the number of values evaluated
+	std::size_t run(const std::string&, const std::string&);
+
+	// purpose: evaluates every value of an open input into an open output
+	// requires: an input file and an output file
+	// returns: the number of values evaluated
+	std::size_t run(std::FILE*, std::FILE*);
+
+};
+
+
+	/* constructors */
+
+fxStream::fxStream(const realFx& f, format in, format out, std::size_t n)
+	: fx(f), in_fmt(in), out_fmt(out), chunk(n)
+{
+	if (chunk == 0)
+		throw std::invalid_argument("Batch size must be positive\n");
+
+	if ((in == format::F80 || out == format::F80) && LDBL_MANT_DIG != 64)
+		throw std::invalid_argument("F80 needs long double to be the x87"
+			" extended format\n");
+}
+
+
+	/* methods */
+
+/* private */
+
+void fxStream::decode(const unsigned char* raw, long double* out,
+	std::size_t n) const
+{
+	if (in_fmt == format::F64)
+	{
+		double d;
+		for (std::size_t i = 0; i < n; i++)
+		{
+			std::memcpy(&d, raw + 8 * i, 8);
+			out[i] = d;
+		}
+	}
+	else
+	{
+		for (std::size_t i = 0; i < n; i++)
+		{
+			out[i] = 0.0l;
+			std::memcpy(out + i, raw + 10 * i, 10);
+		}
+	}
+}
+
+void fxStream::encode(const long double* in, unsigned char* raw,
+	std::size_t n) const
+{
+	if (out_fmt == format::F64)
+	{
+		double d;
+		for (std::size_t i = 0; i < n; i++)
+		{
+			d = static_cast<double>(in[i]);
+			std::memcpy(raw + 8 * i, &d, 8);
+		}
+	}
+	else
+	{
+		for (std::size_t i = 0; i < n; i++)
+			std::memcpy(raw + 10 * i, in + i, 10);
+	}
+}
+
+// a reader thread decodes into 'filled', the calling thread evaluates into
+//	'done', a writer thread encodes and writes; emptied batches go back
+//	through the free lists so nothing is allocated after start up
+template <typename Source>
+std::size_t fxStream::pipeline(Source source, std::FILE* out)
+{
+	const std::size_t in_w = width(in_fmt), out_w = width(out_fmt);
+	std::vector<batch> inputs(DEPTH), outputs(DEPTH);
+	handoff filled, free_in, done, free_out;
+	std::exception_ptr read_error, eval_error, write_error;
+	std::size_t total = 0;
+	batch* x;
+	batch* y;
+
+	for (std::size_t i = 0; i < DEPTH; i++)
+	{
+		inputs[i].values.resize(chunk);
+		outputs[i].values.resize(chunk);
+		free_in.push(&inputs[i]);
+		free_out.push(&outputs[i]);
+	}
+
+	std::thread reader([&]()
+		{
+			std::vector<unsigned char> raw(chunk * in_w);
+			std::size_t have = 0, got;
+			batch* b;
+
+			try
+			{
+				do
+				{
+					// top the block up to a whole batch, a value may be split
+					//	across two reads
+					got = source(raw.data() + have, raw.size() - have);
+					have += got;
+
+					if (have == raw.size() || (got == 0 && have >= in_w))
+					{
+						b = free_in.pop();
+						b->count = have / in_w;
+						decode(raw.data(), b->values.data(), b->count);
+						std::memmove(raw.data(), raw.data() + b->count * in_w,
+							have - b->count * in_w);
+						have -= b->count * in_w;
+						filled.push(b);
+					}
+				} while (got != 0);
+
+				if (have != 0)
+					throw std::runtime_error("Input ends in the middle of a"
+						" value\n");
+			}
+			catch (...)
+			{
+				read_error = std::current_exception();
+			}
+
+			filled.push(nullptr);
+		});
+
+	std::thread writer([&]()
+		{
+			std::vector<unsigned char> raw(chunk * out_w);
+			batch* b;
+
+			while ((b = done.pop()) != nullptr)
+			{
+				encode(b->values.data(), raw.data(), b->count);
+				if (!write_error && std::fwrite(raw.data(), out_w, b->count,
+					out) != b->count)
+					write_error = std::make_exception_ptr(
+						std::runtime_error("Could not write the output\n"));
+				free_out.push(b);
+			}
+		});
+
+	// after a failure the remaining input is drained so the reader finishes
+	while ((x = filled.pop()) != nullptr)
+	{
+		if (!eval_error)
+		{
+			y = free_out.pop();
+			try
+			{
+				fx.evaluate_batch(x->values.data(), y->values.data(),
+					x->count);
+				y->count = x->count;
+				total += x->count;
+				done.push(y);
+			}
+			catch (...)
+			{
+				eval_error = std::current_exception();
+				free_out.push(y);
+			}
+		}
+		free_in.push(x);
+	}
+
+	done.push(nullptr);
+	reader.join();
+	writer.join();
+	std::fflush(out);
+
+	if (eval_error)
+		std::rethrow_exception(eval_error);
+	if (read_error)
+		std::rethrow_exception(read_error);
+	if (write_error)
+		std::rethrow_exception(write_error);
+
+	return total;
+}
+
+/* public */
+
+std::size_t fxStream::run(std::FILE* in, std::FILE* out)
+{
+	return pipeline([in](unsigned char* buf, std::size_t n) -> std::size_t
+		{
+			std::size_t got = std::fread(buf, 1, n, in);
+			if (got == 0 && std::ferror(in))
+				throw std::runtime_error("Could not read the input\n");
+			return got;
+		}, out);
+}
+
+// files are memory mapped where the platform allows it, the reader then
+//	copies blocks out of the page cache without a read call per block
+std::size_t fxStream::run(const std::string& in_path,
+	const std::string& out_path)
+{
+	std::FILE* out = (out_path == "-") ? stdout
+		: std::fopen(out_path.c_str(), "wb");
+	std::size_t total;
+
+	if (!out)
+		throw std::runtime_error("Could not open " + out_path + "\n");
+
+	struct closer
+	{
+		std::FILE* f;
+		~closer() { if (f && f != stdout) std::fclose(f); }
+	} close_out{ out };
+
+	if (in_path == "-")
+		return run(stdin, out);
+
+#ifdef TECAF_MMAP
+	int fd = ::open(in_path.c_str(), O_RDONLY);
+	struct stat info;
+
+	if (fd < 0 || ::fstat(fd, &info) != 0)
+	{
+		if (fd >= 0) ::close(fd);
+		throw std::runtime_error("Could not open " + in_path + "\n");
+	}
+
+	if (info.st_size == 0)
+	{
+		::close(fd);
+		return 0;
+	}
+
+	void* map = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (map == MAP_FAILED)
+		throw std::runtime_error("Could not map " + in_path + "\n");
+
+	::madvise(map, info.st_size, MADV_SEQUENTIAL);
+
+	struct unmapper
+	{
+		void* p;
+		std::size_t n;
+		~unmapper() { ::munmap(p, n); }
+	} unmap{ map, static_cast<std::size_t>(info.st_size) };
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(map);
+	std::size_t offset = 0, size = unmap.n;
+
+	total = pipeline([bytes, &offset, size]
+	(unsigned char* buf, std::size_t n) -> std::size_t
+		{
+			n = std::min(n, size - offset);
+			std::memcpy(buf, bytes + offset, n);
+			offset += n;
+			return n;
+		}, out);
+#else
+	std::FILE* in = std::fopen(in_path.c_str(), "rb");
+
+	if (!in)
+		throw std::runtime_error("Could not open " + in_path + "\n");
+
+	closer close_in{ in };
+	total = run(in, out);
+#endif
+
+	return total;
+}
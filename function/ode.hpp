@@ -0,0 +1,756 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "realfx.hpp"
+#include "realfxn.hpp"
+
+
+// a point of the state space of a system
+typedef std::vector<long double> odeState;
+
+
+// purpose: the dense output of an integration, i.e. a continuous
+//	approximation of the solution between the initial and final x
+// invariants: steps are stored in the order they were taken, so 'xs' is
+//	monotonic in the direction of integration
+// data members:
+//	'dim' is the number of components of the state
+//	'xs' holds the x at the start of each step, followed by the final x
+//	'coef' holds 5 * dim interpolation coefficients per step, in the form
+//	y(t) = c1 + t(c2 + (1 - t)(c3 + t(c4 + (1 - t)c5))), t in [0, 1]
+class odeSolution
+{
+private:
+		/* member variables */
+
+	std::size_t dim = 0;
+
+	std::vector<long double> xs;
+
+	std::vector<long double> coef;
+
+		/* member functions */
+
+	// purpose: finds the step that contains x
+	// requires: an x within the integrated range
+	// returns: the index of the step
+	std::size_t step_of(long double) const;
+
+	friend class odeSolver;
+
+public:
+
+		/* member functions */
+
+	// purpose: finds the number of accepted steps
+	// requires: nothing
+	// returns: a size
+	std::size_t steps() const { return xs.empty() ? 0 : xs.size() - 1; }
+
+	// purpose: finds the number of components of the state
+	// requires: nothing
+	// returns: a size
+	std::size_t dimension() const { return dim; }
+
+	// purpose: finds the x the integration started from
+	// requires: nothing
+	// returns: a long double
+	long double x_begin() const { return xs.front(); }
+
+	// purpose: finds the x the integration ended at
+	// requires: nothing
+	// returns: a long double
+	long double x_end() const { return xs.back(); }
+
+	// purpose: finds the state at the end of the integration
+	// requires: nothing
+	// returns: the final state
+	odeState y_end() const { return (*this)(xs.back()); }
+
+	// purpose: evaluates one component of the solution
+	// requires: an x within the integrated range and a component
+	// returns: a long double
+	long double at(long double, std::size_t) const;
+
+	// purpose: turns one component of the solution into a function
+	// requires: a component, 0 by default
+	// returns: a realFx that interpolates the component, it shares the
+	//	steps of this solution and stays valid after it is destroyed
+	realFx component(std::size_t = 0) const;
+
+	// purpose: evaluates the whole state
+	// requires: an x within the integrated range
+	// returns: the state at x
+	odeState operator()(long double) const;
+
+};
+
+
+// purpose: integrates a system of first order odes y' = f(x, y)
+// invariants: component i of the system is a realFxN of the variables
+//	(x, y0, ..., yn-1), i.e. variable 0 is x and variable j + 1 is yj, so
+//	Jacobians come from its reverse-mode gradient
+// data members:
+//	'rhs' holds one function per component of the state
+//	'rtol' and 'atol' are the relative and absolute error tolerances
+//	'max_steps' bounds the number of attempted steps of one integration
+class odeSolver
+{
+public:
+		/* prerequisites */
+
+	// the integrators a solver can run
+	enum class method { DORMAND_PRINCE, ROSENBROCK };
+
+private:
+		/* member variables */
+
+	std::vector<realFxN> rhs;
+
+	long double rtol = 1e-6l;
+
+	long double atol = 1e-9l;
+
+	std::size_t max_steps = 100000;
+
+		/* member functions */
+
+	// purpose: evaluates the right hand side
+	// requires: an x, a state and a state to hold y'
+	// returns: nothing, but fills y'
+	void eval(long double, const odeState&, odeState&) const;
+
+	// purpose: evaluates the Jacobian of the right hand side wrt y and the
+	//	partial derivative wrt x, one gradient per component
+	// requires: an x, a state, a matrix to hold dy'/dy (row major) and a
+	//	state to hold dy'/dx
+	// returns: nothing, but fills both
+	void jacobian(long double, const odeState&, std::vector<long double>&,
+		odeState&) const;
+
+	// purpose: measures an error estimate against the tolerances
+	// requires: the error, and the states at both ends of the step
+	// returns: the root mean square of the scaled error
+	long double error_norm(const odeState&, const odeState&,
+		const odeState&) const;
+
+	// purpose: picks a first step size from the scale of the problem
+	// requires: the initial x, state and slope, and the final x
+	// returns: a step size
+	long double initial_step(long double, const odeState&, const odeState&,
+		long double) const;
+
+	// purpose: records a step in a solution
+	// requires: the solution, the end of the step, the step size, the
+	//	states and slopes at both ends and the fifth coefficient
+	//	(empty for a cubic)
+	// returns: nothing, but appends to the solution
+	static void record(odeSolution&, long double, long double,
+		const odeState&, const odeState&, const odeState&, const odeState&,
+		const odeState&);
+
+	// purpose: factors a square matrix in place with partial pivoting
+	// requires: a row major matrix, its order and a vector for the pivots
+	// returns: false if the matrix is singular
+	static bool lu_factor(std::vector<long double>&, std::size_t,
+		std::vector<std::size_t>&);
+
+	// purpose: solves a factored system in place
+	// requires: the factors, the order, the pivots and the right hand side
+	// returns: nothing, but overwrites the right hand side
+	static void lu_solve(const std::vector<long double>&, std::size_t,
+		const std::vector<std::size_t>&, odeState&);
+
+public:
+
+		/* constructors */
+
+	// parametrized constructor
+	// takes one function per component, see the invariants for the variables
+	odeSolver(const std::vector<realFxN>&);
+
+	// parametrized constructor
+	// a scalar ode y' = f(x, y), where x is variable 0 and y is variable 1
+	odeSolver(const realFxN&);
+
+		/* member functions */
+
+	// purpose: sets the error tolerances
+	// requires: a relative and an absolute tolerance
+	// returns: this solver
+	odeSolver& tolerance(long double, long double);
+
+	// purpose: sets the most steps one integration may attempt
+	// requires: a count
+	// returns: this solver
+	odeSolver& step_limit(std::size_t);
+
+	// purpose: integrates with the adaptive explicit Dormand-Prince 5(4) pair
+	// requires: the initial x and state, and the final x
+	// returns: the dense solution
+	odeSolution dormand_prince(long double, const odeState&, long double) const;
+
+	// purpose: integrates with the linearly implicit Rosenbrock 2(3) pair of
+	//	Shampine and Reichelt, which stays stable on stiff systems
+	// requires: the initial x and state, and the final x
+	// returns: the dense solution
+	odeSolution rosenbrock(long double, const odeState&, long double) const;
+
+	// purpose: integrates with a chosen method
+	// requires: the method, the initial x and state, and the final x
+	// returns: the dense solution
+	odeSolution solve(method, long double, const odeState&, long double) const;
+
+	// purpose: integrates many initial states over the same range at once,
+	//	spread over a pool of threads
+	// requires: the method, the initial x, the initial states, the final x
+	//	and the number of threads, by default the hardware concurrency
+	// returns: one dense solution per initial state
+	std::vector<odeSolution> solve_many(method, long double,
+		const std::vector<odeState>&, long double, unsigned = 0) const;
+
+};
+
+
+		/* odeSolution */
+
+	/* methods */
+
+/* private */
+
+std::size_t odeSolution::step_of(long double x) const
+{
+	const bool forward = xs.back() >= xs.front();
+	std::size_t i;
+
+	// the first step whose end lies past x
+	if (forward)
+		i = std::upper_bound(xs.begin() + 1, xs.end() - 1, x) - xs.begin();
+	else
+		i = std::upper_bound(xs.begin() + 1, xs.end() - 1, x,
+			[](long double a, long double b) { return a > b; }) - xs.begin();
+
+	return i - 1;
+}
+
+/* public */
+
+long double odeSolution::at(long double x, std::size_t c) const
+{
+	if (steps() == 0)
+		return coef.empty() ? std::nan("") : coef[c];
+
+	const std::size_t i = step_of(x);
+	const long double t = (x - xs[i]) / (xs[i + 1] - xs[i]), s = 1 - t;
+	const long double* k = coef.data() + 5 * dim * i;
+
+	return k[c] + t * (k[dim + c] + s * (k[2 * dim + c]
+		+ t * (k[3 * dim + c] + s * k[4 * dim + c])));
+}
+
+realFx odeSolution::component(std::size_t c) const
+{
+	if (c >= dim)
+		throw std::invalid_argument("Component " + std::to_string(c)
+			+ " is outside the state\n");
+
+	auto self = std::make_shared<const odeSolution>(*this);
+
+	return realFx(std::function<long double(long double&)>(
+		[self, c](long double& x) -> long double
+		{
+			return self->at(x, c);
+		}));
+}
+
+odeState odeSolution::operator()(long double x) const
+{
+	odeState y(dim);
+
+	for (std::size_t c = 0; c < dim; c++)
+		y[c] = at(x, c);
+
+	return y;
+}
+
+
+		/* odeSolver */
+
+	/* constructors */
+
+odeSolver::odeSolver(const std::vector<realFxN>& f) : rhs(f)
+{
+	if (rhs.empty())
+		throw std::invalid_argument("A system needs at least one equation\n");
+
+	for (std::size_t i = 0; i < rhs.size(); i++)
+		if (rhs[i].dimension() > rhs.size() + 1)
+			throw std::invalid_argument("Equation " + std::to_string(i)
+				+ " uses a variable past x and the " + std::to_string(
+				rhs.size()) + " components\n");
+}
+
+odeSolver::odeSolver(const realFxN& f) : odeSolver(std::vector<realFxN>{ f })
+{ }
+
+
+	/* methods */
+
+/* private */
+
+void odeSolver::eval(long double x, const odeState& y, odeState& dy) const
+{
+	thread_local std::vector<long double> point;
+
+	point.resize(y.size() + 1);
+	point[0] = x;
+	std::copy(y.begin(), y.end(), point.begin() + 1);
+
+	for (std::size_t i = 0; i < rhs.size(); i++)
+		dy[i] = rhs[i](point.data());
+}
+
+void odeSolver::jacobian(long double x, const odeState& y,
+	std::vector<long double>& jac, odeState& dfdx) const
+{
+	const std::size_t n = y.size();
+	std::vector<long double> point(n + 1), grad;
+
+	point[0] = x;
+	std::copy(y.begin(), y.end(), point.begin() + 1);
+
+	jac.assign(n * n, 0.0l);
+	dfdx.assign(n, 0.0l);
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		rhs[i].gradient(point, grad);
+		dfdx[i] = grad[0];
+		for (std::size_t j = 0; j < n; j++)
+			jac[i * n + j] = grad[j + 1];
+	}
+}
+
+long double odeSolver::error_norm(const odeState& err, const odeState& y0,
+	const odeState& y1) const
+{
+	long double sum = 0, scale;
+
+	for (std::size_t i = 0; i < err.size(); i++)
+	{
+		scale = atol + rtol * std::max(std::abs(y0[i]), std::abs(y1[i]));
+		sum += (err[i] / scale) * (err[i] / scale);
+	}
+
+	return std::sqrt(sum / err.size());
+}
+
+// Hairer, Norsett and Wanner's starting step heuristic, without the
+//	second evaluation
+long double odeSolver::initial_step(long double x0, const odeState& y0,
+	const odeState& f0, long double x1) const
+{
+	long double d0 = 0, d1 = 0, scale, h;
+
+	for (std::size_t i = 0; i < y0.size(); i++)
+	{
+		scale = atol + rtol * std::abs(y0[i]);
+		d0 += (y0[i] / scale) * (y0[i] / scale);
+		d1 += (f0[i] / scale) * (f0[i] / scale);
+	}
+
+	d0 = std::sqrt(d0 / y0.size());
+	d1 = std::sqrt(d1 / y0.size());
+
+	h = (d0 < 1e-5l || d1 < 1e-5l) ? 1e-6l : 0.01l * d0 / d1;
+	h = std::min(h, std::abs(x1 - x0));
+
+	return (x1 >= x0) ? h : -h;
+}
+
+void odeSolver::record(odeSolution& sol, long double x, long double h,
+	const odeState& y0, const odeState& y1, const odeState& f0,
+	const odeState& f1, const odeState& c5)
+{
+	const std::size_t n = y0.size();
+	long double diff, bspl;
+
+	for (std::size_t i = 0; i < n; i++) sol.coef.push_back(y0[i]);
+	for (std::size_t i = 0; i < n; i++) sol.coef.push_back(y1[i] - y0[i]);
+	for (std::size_t i = 0; i < n; i++)
+		sol.coef.push_back(h * f0[i] - (y1[i] - y0[i]));
+	for (std::size_t i = 0; i < n; i++)
+	{
+		diff = y1[i] - y0[i];
+		bspl = h * f0[i] - diff;
+		sol.coef.push_back(diff - h * f1[i] - bspl);
+	}
+	for (std::size_t i = 0; i < n; i++)
+		sol.coef.push_back(c5.empty() ? 0.0l : c5[i]);
+
+	sol.xs.push_back(x);
+}
+
+bool odeSolver::lu_factor(std::vector<long double>& a, std::size_t n,
+	std::vector<std::size_t>& piv)
+{
+	piv.resize(n);
+
+	for (std::size_t k = 0; k < n; k++)
+	{
+		std::size_t p = k;
+		for (std::size_t i = k + 1; i < n; i++)
+			if (std::abs(a[i * n + k]) > std::abs(a[p * n + k]))
+				p = i;
+
+		piv[k] = p;
+		if (a[p * n + k] == 0)
+			return false;
+
+		if (p != k)
+			for (std::size_t j = 0; j < n; j++)
+				std::swap(a[k * n + j], a[p * n + j]);
+
+		for (std::size_t i = k + 1; i < n; i++)
+		{
+			a[i * n + k] /= a[k * n + k];
+			for (std::size_t j = k + 1; j < n; j++)
+				a[i * n + j] -= a[i * n + k] * a[k * n + j];
+		}
+	}
+
+	return true;
+}
+
+void odeSolver::lu_solve(const std::vector<long double>& a, std::size_t n,
+	const std::vector<std::size_t>& piv, odeState& b)
+{
+	for (std::size_t k = 0; k < n; k++)
+		std::swap(b[k], b[piv[k]]);
+
+	for (std::size_t i = 1; i < n; i++)
+		for (std::size_t j = 0; j < i; j++)
+			b[i] -= a[i * n + j] * b[j];
+
+	for (std::size_t i = n; i-- > 0;)
+	{
+		for (std::size_t j = i + 1; j < n; j++)
+			b[i] -= a[i * n + j] * b[j];
+		b[i] /= a[i * n + i];
+	}
+}
+
+/* public */
+
+odeSolver& odeSolver::tolerance(long double rel, long double abs)
+{
+	if (rel <= 0 || abs <= 0)
+		throw std::invalid_argument("Tolerances must be positive\n");
+
+	rtol = rel;
+	atol = abs;
+
+	return *this;
+}
+
+odeSolver& odeSolver::step_limit(std::size_t n)
+{
+	max_steps = n;
+	return *this;
+}
+
+// Dormand and Prince's 5(4) pair with local extrapolation, the first same
+//	as last stage, and Hairer's fourth order dense output
+odeSolution odeSolver::dormand_prince(long double x0, const odeState& y0,
+	long double x1) const
+{
+	static const long double
+		c2 = 1.0l / 5, c3 = 3.0l / 10, c4 = 4.0l / 5, c5 = 8.0l / 9,
+		a21 = 1.0l / 5,
+		a31 = 3.0l / 40, a32 = 9.0l / 40,
+		a41 = 44.0l / 45, a42 = -56.0l / 15, a43 = 32.0l / 9,
+		a51 = 19372.0l / 6561, a52 = -25360.0l / 2187, a53 = 64448.0l / 6561,
+		a54 = -212.0l / 729,
+		a61 = 9017.0l / 3168, a62 = -355.0l / 33, a63 = 46732.0l / 5247,
+		a64 = 49.0l / 176, a65 = -5103.0l / 18656,
+		a71 = 35.0l / 384, a73 = 500.0l / 1113, a74 = 125.0l / 192,
+		a75 = -2187.0l / 6784, a76 = 11.0l / 84,
+		e1 = 71.0l / 57600, e3 = -71.0l / 16695, e4 = 71.0l / 1920,
+		e5 = -17253.0l / 339200, e6 = 22.0l / 525, e7 = -1.0l / 40,
+		d1 = -12715105075.0l / 11282082432, d3 = 87487479700.0l / 32700410799,
+		d4 = -10690763975.0l / 1880347072, d5 = 701980252875.0l / 199316789632,
+		d6 = -1453857185.0l / 822651844, d7 = 69997945.0l / 29380423;
+
+	const std::size_t n = rhs.size();
+	odeSolution sol;
+	odeState y = y0, yt(n), y1(n), err(n), dense(n),
+		k1(n), k2(n), k3(n), k4(n), k5(n), k6(n), k7(n);
+	long double x = x0, h, norm, fac;
+	bool last, rejected = false;
+
+	if (y0.size() != n)
+		throw std::invalid_argument("Initial state must have one value per"
+			" equation\n");
+
+	sol.dim = n;
+	sol.xs.push_back(x0);
+
+	eval(x, y, k1);
+	h = initial_step(x0, y0, k1, x1);
+
+	for (std::size_t step = 0; x != x1; step++)
+	{
+		if (step >= max_steps)
+			throw std::runtime_error("Step limit reached before x = "
+				+ std::to_string(static_cast<double>(x1)) + "\n");
+
+		// never step past the end
+		last = (h > 0) ? x + h >= x1 : x + h <= x1;
+		if (last)
+			h = x1 - x;
+
+		for (std::size_t i = 0; i < n; i++)
+			yt[i] = y[i] + h * a21 * k1[i];
+		eval(x + c2 * h, yt, k2);
+		for (std::size_t i = 0; i < n; i++)
+			yt[i] = y[i] + h * (a31 * k1[i] + a32 * k2[i]);
+		eval(x + c3 * h, yt, k3);
+		for (std::size_t i = 0; i < n; i++)
+			yt[i] = y[i] + h * (a41 * k1[i] + a42 * k2[i] + a43 * k3[i]);
+		eval(x + c4 * h, yt, k4);
+		for (std::size_t i = 0; i < n; i++)
+			yt[i] = y[i] + h * (a51 * k1[i] + a52 * k2[i] + a53 * k3[i]
+				+ a54 * k4[i]);
+		eval(x + c5 * h, yt, k5);
+		for (std::size_t i = 0; i < n; i++)
+			yt[i] = y[i] + h * (a61 * k1[i] + a62 * k2[i] + a63 * k3[i]
+				+ a64 * k4[i] + a65 * k5[i]);
+		eval(x + h, yt, k6);
+		for (std::size_t i = 0; i < n; i++)
+			y1[i] = y[i] + h * (a71 * k1[i] + a73 * k3[i] + a74 * k4[i]
+				+ a75 * k5[i] + a76 * k6[i]);
+		eval(x + h, y1, k7);
+
+		for (std::size_t i = 0; i < n; i++)
+			err[i] = h * (e1 * k1[i] + e3 * k3[i] + e4 * k4[i] + e5 * k5[i]
+				+ e6 * k6[i] + e7 * k7[i]);
+
+		norm = error_norm(err, y, y1);
+
+		if (!std::isfinite(norm))
+			norm = 1e10l;
+
+		if (norm <= 1)
+		{
+			for (std::size_t i = 0; i < n; i++)
+				dense[i] = h * (d1 * k1[i] + d3 * k3[i] + d4 * k4[i]
+					+ d5 * k5[i] + d6 * k6[i] + d7 * k7[i]);
+
+			x = last ? x1 : x + h;
+			record(sol, x, h, y, y1, k1, k7, dense);
+
+			y.swap(y1);
+			k1.swap(k7);
+
+			fac = (norm == 0) ? 10 : 0.9l * std::pow(norm, -0.2l);
+			// do not grow straight after a rejection
+			h *= rejected ? std::min(1.0l, fac) : std::min(10.0l, fac);
+			rejected = false;
+		}
+		else
+		{
+			h *= std::max(0.2l, 0.9l * std::pow(norm, -0.2l));
+			rejected = true;
+		}
+
+		if (std::abs(h) <= 16 * std::numeric_limits<long double>::epsilon()
+			* std::abs(x))
+			throw std::runtime_error("Step size underflow at x = "
+				+ std::to_string(static_cast<double>(x)) + "\n");
+	}
+
+	// an empty range still has its initial state
+	if (sol.steps() == 0)
+		sol.coef = y0;
+
+	return sol;
+}
+
+// MATLAB's ode23s scheme, one Jacobian and one factorization per attempt
+odeSolution odeSolver::rosenbrock(long double x0, const odeState& y0,
+	long double x1) const
+{
+	const long double d = 1 / (2 + std::sqrt(2.0l));
+	const long double e32 = 6 + std::sqrt(2.0l);
+	const std::size_t n = rhs.size();
+	odeSolution sol;
+	odeState y = y0, y1(n), f0(n), f1(n), f2(n), dfdx(n), err(n), yt(n),
+		k1(n), k2(n), k3(n);
+	std::vector<long double> jac, w;
+	std::vector<std::size_t> piv;
+	long double x = x0, h, norm;
+	bool last, rejected = false;
+
+	if (y0.size() != n)
+		throw std::invalid_argument("Initial state must have one value per"
+			" equation\n");
+
+	sol.dim = n;
+	sol.xs.push_back(x0);
+
+	eval(x, y, f0);
+	h = initial_step(x0, y0, f0, x1);
+
+	for (std::size_t step = 0; x != x1; step++)
+	{
+		if (step >= max_steps)
+			throw std::runtime_error("Step limit reached before x = "
+				+ std::to_string(static_cast<double>(x1)) + "\n");
+
+		last = (h > 0) ? x + h >= x1 : x + h <= x1;
+		if (last)
+			h = x1 - x;
+
+		jacobian(x, y, jac, dfdx);
+
+		// W = I - h d J
+		w.resize(n * n);
+		for (std::size_t i = 0; i < n * n; i++)
+			w[i] = -h * d * jac[i];
+		for (std::size_t i = 0; i < n; i++)
+			w[i * n + i] += 1;
+
+		if (!lu_factor(w, n, piv))
+		{
+			h /= 2;
+			rejected = true;
+			continue;
+		}
+
+		for (std::size_t i = 0; i < n; i++)
+			k1[i] = f0[i] + h * d * dfdx[i];
+		lu_solve(w, n, piv, k1);
+
+		for (std::size_t i = 0; i < n; i++)
+			yt[i] = y[i] + 0.5l * h * k1[i];
+		eval(x + 0.5l * h, yt, f1);
+
+		for (std::size_t i = 0; i < n; i++)
+			k2[i] = f1[i] - k1[i];
+		lu_solve(w, n, piv, k2);
+		for (std::size_t i = 0; i < n; i++)
+		{
+			k2[i] += k1[i];
+			y1[i] = y[i] + h * k2[i];
+		}
+		eval(x + h, y1, f2);
+
+		for (std::size_t i = 0; i < n; i++)
+			k3[i] = f2[i] - e32 * (k2[i] - f1[i]) - 2 * (k1[i] - f0[i])
+				+ h * d * dfdx[i];
+		lu_solve(w, n, piv, k3);
+
+		for (std::size_t i = 0; i < n; i++)
+			err[i] = h / 6 * (k1[i] - 2 * k2[i] + k3[i]);
+
+		norm = error_norm(err, y, y1);
+
+		if (!std::isfinite(norm))
+			norm = 1e10l;
+
+		if (norm <= 1)
+		{
+			x = last ? x1 : x + h;
+			record(sol, x, h, y, y1, f0, f2, odeState());
+
+			y.swap(y1);
+			f0.swap(f2);
+
+			h *= rejected ? 1.0l : std::min(5.0l, 0.8l * std::cbrt(1 / norm));
+			rejected = false;
+		}
+		else
+		{
+			h *= std::max(0.5l, 0.8l * std::cbrt(1 / norm));
+			rejected = true;
+		}
+
+		if (std::abs(h) <= 16 * std::numeric_limits<long double>::epsilon()
+			* std::abs(x))
+			throw std::runtime_error("Step size underflow at x = "
+				+ std::to_string(static_cast<double>(x)) + "\n");
+	}
+
+	// an empty range still has its initial state
+	if (sol.steps() == 0)
+		sol.coef = y0;
+
+	return sol;
+}
+
+odeSolution odeSolver::solve(method m, long double x0, const odeState& y0,
+	long double x1) const
+{
+	return (m == method::ROSENBROCK) ? rosenbrock(x0, y0, x1)
+		: dormand_prince(x0, y0, x1);
+}
+
+// each thread claims the next unsolved initial state until none are left,
+//	so uneven step counts balance out
+std::vector<odeSolution> odeSolver::solve_many(method m, long double x0,
+	const std::vector<odeState>& y0s, long double x1, unsigned threads) const
+{
+	std::vector<odeSolution> out(y0s.size());
+	std::vector<std::exception_ptr> errors(y0s.size());
+	std::vector<std::thread> pool;
+	std::atomic<std::size_t> next{ 0 };
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = static_cast<unsigned>(
+		std::min<std::size_t>(threads, y0s.size()));
+
+	// build the programs before the threads share them
+	for (const realFxN& f : rhs)
+		f.dimension();
+
+	auto work = [&]()
+		{
+			for (std::size_t i = next++; i < y0s.size(); i = next++)
+			{
+				try
+				{
+					out[i] = solve(m, x0, y0s[i], x1);
+				}
+				catch (...)
+				{
+					errors[i] = std::current_exception();
+				}
+			}
+		};
+
+	for (unsigned t = 1; t < threads; t++)
+		pool.emplace_back(work);
+	work();
+	for (std::thread& t : pool)
+		t.join();
+
+	for (const std::exception_ptr& e : errors)
+		if (e)
+			std::rethrow_exception(e);
+
+	return out;
+}
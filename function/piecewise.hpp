@@ -0,0 +1,371 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "realfx.hpp"
+
+
+// purpose: a real-valued function defined by different functions on
+//	consecutive intervals
+// invariants: the breakpoints are strictly increasing and there is one more
+//	piece than breakpoints; piece i covers [breaks[i - 1], breaks[i]), i.e.
+//	a breakpoint belongs to the piece on its right, the first and last pieces
+//	extend to -inf and inf
+// data members:
+//	'breaks' holds the sorted breakpoints
+//	'pieces' holds the function of each interval, from left to right
+class piecewiseFx
+{
+private:
+		/* prerequisites */
+
+	// the number of values a batch sorts by piece at once
+	static constexpr std::size_t BLOCK = 256;
+
+		/* member variables */
+
+	std::vector<long double> breaks;
+
+	std::vector<realFx> pieces;
+
+		/* member functions */
+
+	// purpose: integrates one piece over an interval inside it
+	// requires: the piece, the bounds, the values at both bounds and the
+	//	midpoint, the simpson estimate over the whole interval, the tolerance
+	//	and the remaining depth
+	// returns: a long double
+	static long double simpson(const realFx&, long double, long double,
+		long double, long double, long double, long double, long double, int);
+
+public:
+
+		/* constructors */
+
+	// parametrized constructor
+	// takes the pieces from left to right and the breakpoints between them
+	piecewiseFx(const std::vector<realFx>&, const std::vector<long double>&);
+
+		/* member functions */
+
+	// purpose: finds the piece that covers a value
+	// requires: a value
+	// returns: the index of the piece, i.e. the number of breakpoints <= x
+	std::size_t locate(long double) const;
+
+	// purpose: finds the breakpoints
+	// requires: nothing
+	// returns: the sorted breakpoints
+	const std::vector<long double>& breakpoints() const { return breaks; }
+
+	// purpose: finds the function of one piece
+	// requires: the index of a piece
+	// returns: a realFx
+	const realFx& piece(std::size_t i) const { return pieces.at(i); }
+
+	// purpose: evaluates the function at many values at once
+	// requires: an array of inputs, an array for the outputs and the count
+	// returns: nothing, but fills the outputs
+	void evaluate_batch(const long double*, long double*, std::size_t) const;
+
+	// purpose: finds the definite integral, split at the breakpoints so no
+	//	quadrature straddles a jump
+	// requires: a left bound, a right bound and the tolerance, by default
+	//	1e-10
+	// returns: a long double
+	long double integral(long double, long double, long double = 1e-10) const;
+
+	// purpose: finds an antiderivative
+	// requires: nothing, but the x-intercept can be passed through
+	// returns: a realFx i.e. the integral
+	realFx integral(long double = 0.0l) const;
+
+	// purpose: find the left limit at a value
+	// requires: a number
+	// returns: the left limit of the function at that value
+	long double left_limit(long double) const;
+
+	// purpose: find the right limit at a value
+	// requires: a number
+	// returns: the right limit of the function at that value
+	long double right_limit(long double) const;
+
+	// purpose: determines if the limit exists at a value, at a breakpoint
+	//	the two neighbouring pieces are compared directly
+	// requires: a number
+	// returns: true if it exists, false if it doesn't
+	bool limit_exists_at(long double) const;
+
+	// purpose: finds the limit of a value
+	// requires: a number
+	// returns: the limit of the function at that value
+	long double limit_at(long double) const;
+
+	// purpose: wraps the piecewise function as a plain function
+	// requires: nothing
+	// returns: a realFx that shares the pieces
+	realFx to_fx() const;
+
+		/* operators */
+
+	// purpose: evaluates the function at a value
+	// requires: a value
+	// returns: a long double, i.e. the result
+	long double operator()(long double) const;
+
+};
+
+
+	/* constructors */
+
+piecewiseFx::piecewiseFx(const std::vector<realFx>& fxs,
+	const std::vector<long double>& xs) : breaks(xs), pieces(fxs)
+{
+	if (pieces.size() != breaks.size() + 1)
+		throw std::invalid_argument("A piecewise function needs one more"
+			" piece than breakpoints\n");
+
+	for (std::size_t i = 0; i < breaks.size(); i++)
+		if (std::isnan(breaks[i]) || (i > 0 && !(breaks[i - 1] < breaks[i])))
+			throw std::invalid_argument("Breakpoints must be strictly"
+				" increasing\n");
+}
+
+
+	/* methods */
+
+/* private */
+
+// adaptive simpson's rule, the error estimate of the two halves decides
+//	whether to split further
+long double piecewiseFx::simpson(const realFx& f, long double a,
+	long double b, long double fa, long double fm, long double fb,
+	long double whole, long double tol, int depth)
+{
+	const long double m = (a + b) / 2;
+	const long double lm = (a + m) / 2, rm = (m + b) / 2;
+	const long double flm = f(lm), frm = f(rm);
+	const long double left = (m - a) / 6 * (fa + 4 * flm + fm);
+	const long double right = (b - m) / 6 * (fm + 4 * frm + fb);
+	const long double delta = left + right - whole;
+
+	if (depth <= 0 || std::abs(delta) <= 15 * tol)
+		return left + right + delta / 15;
+
+	return simpson(f, a, m, fa, flm, fm, left, tol / 2, depth - 1)
+		+ simpson(f, m, b, fm, frm, fb, right, tol / 2, depth - 1);
+}
+
+/* public */
+
+// a binary search without branches, the halving step is a conditional move
+//	so random inputs cost no mispredictions
+std::size_t piecewiseFx::locate(long double x) const
+{
+	const long double* first = breaks.data();
+	const long double* base = first;
+	std::size_t len = breaks.size(), half;
+
+	if (len == 0)
+		return 0;
+
+	while (len > 1)
+	{
+		half = len / 2;
+		base = (base[half] <= x) ? base + half : base;
+		len -= half;
+	}
+
+	return static_cast<std::size_t>(base - first) + (*base <= x);
+}
+
+// each block is located as a whole, then counting sorted by piece so every
+//	piece runs one batch over its own values instead of a branch per value
+void piecewiseFx::evaluate_batch(const long double* xs, long double* ys,
+	std::size_t count) const
+{
+	const std::size_t m = pieces.size();
+	std::vector<std::size_t> index(BLOCK), order(BLOCK), start(m + 1);
+	std::vector<long double> in(BLOCK), out(BLOCK);
+	std::size_t n, k;
+
+	for (std::size_t done = 0; done < count; done += n)
+	{
+		n = std::min(BLOCK, count - done);
+
+		for (std::size_t j = 0; j < n; j++)
+			index[j] = locate(xs[done + j]);
+
+		// the common case of a block inside one piece needs no sorting
+		if (std::all_of(index.begin(), index.begin() + n,
+			[first = index[0]](std::size_t i) { return i == first; }))
+		{
+			pieces[index[0]].evaluate_batch(xs + done, ys + done, n);
+			continue;
+		}
+
+		std::fill(start.begin(), start.end(), 0);
+		for (std::size_t j = 0; j < n; j++)
+			start[index[j] + 1]++;
+		for (std::size_t i = 0; i < m; i++)
+			start[i + 1] += start[i];
+
+		for (std::size_t j = 0; j < n; j++)
+		{
+			k = start[index[j]]++;
+			order[k] = j;
+			in[k] = xs[done + j];
+		}
+
+		// start[i] now marks the end of piece i
+		for (std::size_t i = 0, begin = 0; i < m; begin = start[i++])
+			if (start[i] > begin)
+				pieces[i].evaluate_batch(in.data() + begin, out.data() + begin,
+					start[i] - begin);
+
+		for (std::size_t j = 0; j < n; j++)
+			ys[done + order[j]] = out[j];
+	}
+}
+
+// every piece is integrated with its own function up to the breakpoints, so
+//	the value on the far side of a jump never leaks into the sum
+long double piecewiseFx::integral(long double a, long double b,
+	long double tol) const
+{
+	long double sign = 1, total = 0, left, right, fa, fm, fb;
+	std::size_t first, last;
+
+	if (std::isinf(a) || std::isinf(b))
+		throw std::invalid_argument("Infinite bounds are not supported\n");
+
+	if (a == b)
+		return 0;
+	else if (a > b)
+	{
+		std::swap(a, b);
+		sign = -1;
+	}
+
+	first = locate(a);
+	last = locate(b);
+
+	for (std::size_t i = first; i <= last; i++)
+	{
+		left = (i == first) ? a : breaks[i - 1];
+		right = (i == last) ? b : breaks[i];
+
+		if (!(left < right))
+			continue;
+
+		const realFx& f = pieces[i];
+		fa = f(left);
+		fm = f((left + right) / 2);
+		fb = f(right);
+
+		total += simpson(f, left, right, fa, fm, fb,
+			(right - left) / 6 * (fa + 4 * fm + fb),
+			tol * (right - left) / (b - a), 50);
+	}
+
+	return sign * total;
+}
+
+realFx piecewiseFx::integral(long double x_inter) const
+{
+	auto self = std::make_shared<const piecewiseFx>(*this);
+
+	return realFx(std::function<long double(long double&)>(
+		[self, x_inter](long double& x) -> long double
+		{
+			return self->integral(x_inter, x);
+		}));
+}
+
+// left of a breakpoint is the piece that ends there
+long double piecewiseFx::left_limit(long double x) const
+{
+	std::size_t i = locate(x);
+	realFx f;
+
+	if (i > 0 && breaks[i - 1] == x)
+		i--;
+
+	f = pieces[i];
+	return f.left_limit(x);
+}
+
+long double piecewiseFx::right_limit(long double x) const
+{
+	realFx f = pieces[locate(x)];
+
+	return f.right_limit(x);
+}
+
+// away from the breakpoints the piece decides on its own, at a breakpoint
+//	both pieces are evaluated there, falling back to their one sided limits
+//	where a piece is undefined at its end
+bool piecewiseFx::limit_exists_at(long double x) const
+{
+	const std::size_t i = locate(x);
+	long double left, right;
+	realFx f;
+
+	if (i == 0 || breaks[i - 1] != x)
+	{
+		f = pieces[i];
+		return f.limit_exists_at(x);
+	}
+
+	left = pieces[i - 1](x);
+	right = pieces[i](x);
+
+	if (!std::isfinite(left))
+		left = left_limit(x);
+	if (!std::isfinite(right))
+		right = right_limit(x);
+
+	if (std::isnan(left) || std::isnan(right))
+		return false;
+
+	return std::abs(left - right)
+		<= EPSILON * std::max({ 1.0l, std::abs(left), std::abs(right) });
+}
+
+long double piecewiseFx::limit_at(long double x) const
+{
+	const std::size_t i = locate(x);
+
+	if (!limit_exists_at(x))
+		return std::nan("");
+	else if (i > 0 && breaks[i - 1] == x && std::isfinite(pieces[i](x)))
+		return pieces[i](x);
+	else
+		return right_limit(x);
+}
+
+realFx piecewiseFx::to_fx() const
+{
+	auto self = std::make_shared<const piecewiseFx>(*this);
+
+	return realFx(std::function<long double(long double&)>(
+		[self](long double& x) -> long double
+		{
+			return (*self)(x);
+		}));
+}
+
+
+	/* operators */
+
+long double piecewiseFx::operator()(long double x) const
+{
+	return pieces[locate(x)](x);
+}
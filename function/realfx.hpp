@@ -3,9 +3,19 @@
 
 #include <algorithm>
 #include <cmath>
+#include <complex>
+#include <cstddef>
 #include <functional>
+#include <iostream>
 #include <limits>
+#include <memory>
+#include <stdexcept>
 #include <type_traits>
+#include <vector>
+
+#include "fft.hpp"
+#include "realfxn.hpp"
+#include "spline.hpp"
 
 
 // set the positive and negative infinity constants
@@ -17,11 +27,39 @@ const long double EPSILON =
 	std::sqrt(std::numeric_limits<long double>::epsilon());
 
 
+class realFx;
+
+// the scalar-on-the-left operators are befriended by realFx, their default
+//	template arguments have to live on a declaration outside the class
+template <typename T,
+	typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+realFx operator+(const T&, const realFx&);
+
+template <typename T,
+	typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+realFx operator-(const T&, const realFx&);
+
+template <typename T,
+	typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+realFx operator*(const T&, const realFx&);
+
+template <typename T,
+	typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+realFx operator/(const T&, const realFx&);
+
+template <typename T,
+	typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+realFx operator^(const T&, const realFx&);
+
+
 // purpose: represents a real-valued function
 // invariants: the function takes in a long double passed by reference
 //	and returns a long double by value
 // data members:
 //	foo is a functional object i.e. the representative function
+//	graph is the symbolic form of foo when the function was built from a
+//	realFxN, derivatives then use automatic differentiation and batches and
+//	integrals run on the graph's batch kernels; it is null otherwise
 class realFx
 {
 private:
@@ -33,6 +71,8 @@ private:
 
 	real_fx_type foo;
 
+	std::shared_ptr<const realFxN> graph;
+
 		/* member functions */
 
 	// purpose: find the derivative of this function
@@ -50,6 +90,13 @@ private:
 		typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
 	long double _def_integral(const S&, const T&);
 
+	// purpose: integrates the graph with adaptive Gauss-Kronrod quadrature,
+	//	every round evaluates the nodes of all unfinished intervals in one
+	//	batch
+	// requires: a left bound less than the right bound, both finite
+	// returns: a long double, that is the integral
+	long double _graph_integral(long double, long double) const;
+
 public:
 
 		/* constructors */
@@ -77,6 +124,11 @@ public:
 	// assigns this function using a function pointer that takes in a
 	//	long double and returns a long double
 	realFx(long double(*)(long double));
+
+	// parametrized constructor
+	// assigns this function using a symbolic function of at most one
+	//	variable, i.e. variable 0 is x
+	realFx(const realFxN&);
 	
 	// parametrized constructor
 	// creates a constant valued function
@@ -185,6 +237,32 @@ public:
 	// returns: a new function
 	realFx shiftY(long double);
 
+	// purpose: samples the function over one period and finds its spectrum
+	// requires: a left bound, a right bound and the number of samples, the
+	//	samples are f(a + k(b - a) / n) for k = 0 ... n - 1
+	// returns: the discrete fourier transform of the samples
+	std::vector<std::complex<double>> spectrum
+	(long double, long double, std::size_t) const;
+
+	// purpose: replaces the function with a cubic lookup table, for
+	//	functions that are expensive to evaluate
+	// requires: a left bound, a right bound, the number of samples and the
+	//	kind of spline, natural by default; a clamped spline takes its end
+	//	slopes from the function
+	// returns: a new function that interpolates evenly spaced samples, and
+	//	extrapolates the end pieces outside the bounds
+	realFx tabulate(long double, long double, std::size_t,
+		cubicSpline::kind = cubicSpline::kind::NATURAL) const;
+
+	// purpose: interpolates measured data with a cubic spline
+	// requires: strictly increasing x values, one y value per x and the kind
+	//	of spline, natural by default (a clamped spline gets the slopes of
+	//	the end secants)
+	// returns: a new function
+	static realFx from_samples(const std::vector<long double>&,
+		const std::vector<long double>&,
+		cubicSpline::kind = cubicSpline::kind::NATURAL);
+
 		/* operators */
 
 	// purpose: adds a scalar value to a function
@@ -291,6 +369,11 @@ public:
 		typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
 	long double operator()(const T&) const;
 
+	// purpose: evaluates the function at many values at once
+	// requires: an array of inputs, an array for the outputs and the count
+	// returns: nothing, but fills the outputs
+	void evaluate_batch(const long double*, long double*, std::size_t) const;
+
 	// purpose: composes this function at another function
 	// requires: a realFx
 	// returns: a new function, i.e. the composition
@@ -304,6 +387,18 @@ public:
 };
 
 
+	/* prototypes */
+
+// purpose: convolves two functions restricted to an interval, i.e.
+//	(f * g)(x) = integral from a to b of f(t) g(x - t) dt, with one fft
+//	product instead of a quadrature per point
+// requires: two functions, a left bound, a right bound and the number of
+//	samples of each function, 1024 by default
+// returns: a function tabulated over [2a, 2b], zero outside of it
+realFx convolve(const realFx&, const realFx&, long double, long double,
+	std::size_t = 1024);
+
+
 	/* constructors */
 
 // default constructor
@@ -348,8 +443,23 @@ realFx::realFx(const T& number)
 
 }
 
+// parametrized constructor
+// symbolic function
+realFx::realFx(const realFxN& fx)
+	: graph(std::make_shared<const realFxN>(fx))
+{
+	if (fx.dimension() > 1)
+		throw std::invalid_argument("A realFx can only be built from a"
+			" function of one variable\n");
+
+	foo = [g = graph](long double& x) -> long double
+		{
+			return (*g)(&x);
+		};
+}
+
 // copy constuctor
-realFx::realFx(const realFx& other) : foo(other.foo) {}
+realFx::realFx(const realFx& other) : foo(other.foo), graph(other.graph) {}
 
 
 	/* methods */
@@ -357,17 +467,29 @@ realFx::realFx(const realFx& other) : foo(other.foo) {}
 /* private */
 
 // calculate the derivative
+// a symbolic function is differentiated exactly by one reverse sweep
 realFx::real_fx_type realFx::_derivative()
 {
-	return [this](long double& x) -> long double
+	if (graph)
+		return [g = graph](long double& x) -> long double
+			{
+				long double value, slope = 0;
+
+				if (g->dimension() == 0)
+					return 0;
+				g->gradient_batch(&x, 1, &value, &slope);
+				return slope;
+			};
+
+	return [self = *this](long double& x) mutable -> long double
 		{
 			long double del_x;
 
-			if (limit_exists_at(x))
+			if (self.limit_exists_at(x))
 			{
 				del_x = x;
 				del_x += EPSILON;
-				return (this->foo(del_x) - this->foo(x)) / EPSILON;
+				return (self.foo(del_x) - self.foo(x)) / EPSILON;
 			}
 			else
 				return std::nan("");
@@ -388,6 +510,9 @@ long double realFx::_def_integral(const S& l, const T& r)
 	if (left == right) return 0.0;
 	// ensure that the left bound is to the left of the right bound
 	else if (left > right) return -1 * _def_integral(right, left);
+	// symbolic functions have a batched quadrature
+	else if (graph && std::isfinite(left) && std::isfinite(right))
+		return _graph_integral(left, right);
 	// if we have infinite bounds on the left
 	else if (left == N_INF || right == INF)
 	{
@@ -435,6 +560,93 @@ long double realFx::_def_integral(const S& l, const T& r)
 
 }
 
+// G7-K15, an interval is split when the two rules disagree
+long double realFx::_graph_integral(long double a, long double b) const
+{
+	static constexpr long double NODE[8] = {
+		0.991455371120812639206854697526329l,
+		0.949107912342758524526189684047851l,
+		0.864864423359769072789712788640926l,
+		0.741531185599394439863864773280788l,
+		0.586087235467691130294144845693013l,
+		0.405845151377397166906606412076961l,
+		0.207784955007898467600689403773245l,
+		0.0l };
+	static constexpr long double KRONROD[8] = {
+		0.022935322010529224963732008058970l,
+		0.063092092629978553290700663189204l,
+		0.104790010322250183839876322541518l,
+		0.140653259715525918745189590510238l,
+		0.169004726639267902826583426598550l,
+		0.190350578064785409913256402421014l,
+		0.204432940075298892414161999234649l,
+		0.209482141084727828012999174891714l };
+	static constexpr long double GAUSS[4] = {
+		0.129484966168869693270611432679082l,
+		0.279705391489276667901467771423780l,
+		0.381830050505118944950369775488975l,
+		0.417959183673469387755102040816327l };
+
+	struct interval { long double a, b; int depth; };
+
+	std::vector<interval> pending{ { a, b, 0 } }, next;
+	std::vector<long double> xs, ys;
+	long double total = 0, mid, half, k, g, tol;
+
+	while (!pending.empty())
+	{
+		xs.resize(15 * pending.size());
+		ys.resize(xs.size());
+
+		for (std::size_t i = 0; i < pending.size(); i++)
+		{
+			mid = (pending[i].a + pending[i].b) / 2;
+			half = (pending[i].b - pending[i].a) / 2;
+			for (int j = 0; j < 7; j++)
+			{
+				xs[15 * i + 2 * j] = mid - half * NODE[j];
+				xs[15 * i + 2 * j + 1] = mid + half * NODE[j];
+			}
+			xs[15 * i + 14] = mid;
+		}
+
+		graph->evaluate_batch(xs.data(), xs.size(), ys.data());
+
+		next.clear();
+		for (std::size_t i = 0; i < pending.size(); i++)
+		{
+			const long double* y = ys.data() + 15 * i;
+			half = (pending[i].b - pending[i].a) / 2;
+			k = KRONROD[7] * y[14];
+			g = GAUSS[3] * y[14];
+			for (int j = 0; j < 7; j++)
+			{
+				k += KRONROD[j] * (y[2 * j] + y[2 * j + 1]);
+				if (j % 2 == 1)
+					g += GAUSS[j / 2] * (y[2 * j] + y[2 * j + 1]);
+			}
+			k *= half;
+			g *= half;
+
+			// the tolerance is shared out in proportion to the width
+			tol = std::max(1e-14l * std::abs(k),
+				1e-12l * (pending[i].b - pending[i].a) / (b - a));
+			if (std::abs(k - g) <= tol || pending[i].depth >= 48
+				|| !std::isfinite(k))
+				total += k;
+			else
+			{
+				mid = (pending[i].a + pending[i].b) / 2;
+				next.push_back({ pending[i].a, mid, pending[i].depth + 1 });
+				next.push_back({ mid, pending[i].b, pending[i].depth + 1 });
+			}
+		}
+		pending.swap(next);
+	}
+
+	return total;
+}
+
 /* public */
 
 // find the derivative at a value
@@ -454,11 +666,10 @@ realFx realFx::integral(const T& x_inter)
 {
 	real_fx_type bar;
 
-	bar = [this, &x_inter](long double& x) -> long double
+	bar = [self = *this, val = static_cast<long double>(x_inter)]
+	(long double& x) mutable -> long double
 		{
-			long double val;
-			val = static_cast<long double>(x_inter);
-			return _def_integral(val, x);
+			return self._def_integral(val, x);
 		};
 
 	return bar;
@@ -496,6 +707,8 @@ bool realFx::limit_exists_at(const T& val, const long double& h)
 	{
 		return false;
 	}
+
+	return false;
 }
 
 // find the left limit
@@ -539,7 +752,7 @@ long double realFx::right_limit(const T& num, const long double& h)
 
 realFx realFx::reflectX()
 {
-	real_fx_type bar = [this](long double x) ->long double
+	real_fx_type bar = [foo = this->foo](long double x) ->long double
 		{
 			return -1 * foo(x);
 		};
@@ -549,7 +762,7 @@ realFx realFx::reflectX()
 
 realFx realFx::reflectY()
 {
-	real_fx_type bar = [this](long double x) ->long double
+	real_fx_type bar = [foo = this->foo](long double x) ->long double
 		{
 			long double new_x = -1 * x;
 			return foo(new_x);
@@ -560,7 +773,7 @@ realFx realFx::reflectY()
 
 realFx realFx::scale(long double cx, long double cy)
 {
-	real_fx_type bar = [this, &cx, &cy](long double x) -> long double
+	real_fx_type bar = [foo = this->foo, cx, cy](long double x) -> long double
 		{
 			long double new_x = x / cx;
 			return cy * foo(new_x);
@@ -571,7 +784,7 @@ realFx realFx::scale(long double cx, long double cy)
 
 realFx realFx::scaleX(long double c)
 {
-	real_fx_type bar = [this, &c](long double x) -> long double
+	real_fx_type bar = [foo = this->foo, c](long double x) -> long double
 		{
 			long double new_x = x / c;
 			return foo(new_x);
@@ -582,7 +795,7 @@ realFx realFx::scaleX(long double c)
 
 realFx realFx::scaleY(long double c)
 {
-	real_fx_type bar = [this, &c](long double x) -> long double
+	real_fx_type bar = [foo = this->foo, c](long double x) -> long double
 		{
 			return c * foo(x);
 		};
@@ -592,7 +805,7 @@ realFx realFx::scaleY(long double c)
 
 realFx realFx::shift(long double dx, long double dy)
 {
-	real_fx_type bar = [this, &dx, &dy](long double x) -> long double
+	real_fx_type bar = [foo = this->foo, dx, dy](long double x) -> long double
 		{
 			long double new_x = x - dx;
 			return foo(new_x) + dy;
@@ -604,7 +817,7 @@ realFx realFx::shift(long double dx, long double dy)
 
 realFx realFx::shiftX(long double dx)
 {
-	real_fx_type bar = [this, &dx](long double x) -> long double
+	real_fx_type bar = [foo = this->foo, dx](long double x) -> long double
 		{
 			long double new_x = x - dx;
 			return foo(new_x);
@@ -615,7 +828,7 @@ realFx realFx::shiftX(long double dx)
 
 realFx realFx::shiftY(long double dy)
 {
-	real_fx_type bar = [this, &dy](long double x) -> long double
+	real_fx_type bar = [foo = this->foo, dy](long double x) -> long double
 		{
 			return foo(x) + dy;
 		};
@@ -623,6 +836,86 @@ realFx realFx::shiftY(long double dy)
 	return realFx(bar);
 }
 
+// the samples are transformed in double precision, see fft.hpp
+std::vector<std::complex<double>> realFx::spectrum
+(long double a, long double b, std::size_t n) const
+{
+	std::vector<std::complex<double>> samples(n);
+	long double x;
+
+	for (std::size_t k = 0; k < n; k++)
+	{
+		x = a + (b - a) * k / n;
+		samples[k] = static_cast<double>(foo(x));
+	}
+
+	fft(samples);
+
+	return samples;
+}
+
+// the end slopes of a clamped table use one sided second order differences
+//	on a step much finer than the grid
+realFx realFx::tabulate(long double a, long double b, std::size_t n,
+	cubicSpline::kind k) const
+{
+	std::vector<long double> xs(n), ys(n);
+	long double d0 = 0, dn = 0, h, x;
+
+	if (n < 2 || !(a < b))
+		throw std::invalid_argument("A table needs at least 2 samples over a"
+			" non-empty interval\n");
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		xs[i] = (i + 1 == n) ? b : a + (b - a) * i / (n - 1);
+		x = xs[i];
+		ys[i] = foo(x);
+	}
+
+	if (k == cubicSpline::kind::CLAMPED)
+	{
+		long double p[3];
+
+		h = std::cbrt(std::numeric_limits<long double>::epsilon())
+			* std::max(1.0l, std::abs(a));
+		for (int i = 0; i < 3; i++) { x = a + i * h; p[i] = foo(x); }
+		d0 = (-3 * p[0] + 4 * p[1] - p[2]) / (2 * h);
+
+		h = std::cbrt(std::numeric_limits<long double>::epsilon())
+			* std::max(1.0l, std::abs(b));
+		for (int i = 0; i < 3; i++) { x = b - i * h; p[i] = foo(x); }
+		dn = (3 * p[0] - 4 * p[1] + p[2]) / (2 * h);
+	}
+
+	auto table = std::make_shared<const cubicSpline>(xs, ys, k, d0, dn);
+
+	return realFx(real_fx_type([table](long double& x) -> long double
+		{
+			return (*table)(x);
+		}));
+}
+
+realFx realFx::from_samples(const std::vector<long double>& xs,
+	const std::vector<long double>& ys, cubicSpline::kind k)
+{
+	long double d0 = 0, dn = 0;
+	const std::size_t n = xs.size();
+
+	if (k == cubicSpline::kind::CLAMPED && n >= 2 && ys.size() == n)
+	{
+		d0 = (ys[1] - ys[0]) / (xs[1] - xs[0]);
+		dn = (ys[n - 1] - ys[n - 2]) / (xs[n - 1] - xs[n - 2]);
+	}
+
+	auto table = std::make_shared<const cubicSpline>(xs, ys, k, d0, dn);
+
+	return realFx(real_fx_type([table](long double& x) -> long double
+		{
+			return (*table)(x);
+		}));
+}
+
 
 	/* operators */
 
@@ -634,7 +927,7 @@ realFx realFx::operator+(const T& offset)
 
 	num = static_cast<long double>(offset);
 
-	real_fx_type bar = [&foo, &num](long double& x) -> long double
+	real_fx_type bar = [foo = this->foo, num](long double& x) -> long double
 		{
 			return foo(x) + num;
 		};
@@ -644,8 +937,7 @@ realFx realFx::operator+(const T& offset)
 
 // binary addition
 // friend operator
-template <typename T,
-	typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+template <typename T, typename>
 realFx operator+(const T& num, const realFx& foo)
 {
 	realFx::real_fx_type bar;
@@ -653,7 +945,7 @@ realFx operator+(const T& num, const realFx& foo)
 
 	eval = static_cast<long double>(num);
 
-	bar = [&foo, &eval](long double& x) -> long double
+	bar = [foo, eval](long double& x) -> long double
 		{
 			return foo(x) + eval;
 		};
@@ -664,9 +956,9 @@ realFx operator+(const T& num, const realFx& foo)
 // binary addition
 realFx realFx::operator+(const realFx& other)
 {
-	real_fx_type foo_bar = [this, &other](long double& x) -> long double
+	real_fx_type foo_bar = [foo = this->foo, other](long double& x) -> long double
 		{
-			return this->foo(x) + other.foo(x);
+			return foo(x) + other.foo(x);
 		};
 
 	return realFx(foo_bar);
@@ -680,7 +972,7 @@ realFx realFx::operator-(const T& offset)
 
 	num = static_cast<long double>(offset);
 
-	real_fx_type bar = [&foo, &num](long double& x) -> long double
+	real_fx_type bar = [foo = this->foo, num](long double& x) -> long double
 		{
 			return foo(x) - num;
 		};
@@ -690,8 +982,7 @@ realFx realFx::operator-(const T& offset)
 
 // binary subtraction
 // friend operator
-template <typename T,
-	typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+template <typename T, typename>
 realFx operator-(const T& num, const realFx& foo)
 {
 	realFx::real_fx_type bar;
@@ -699,7 +990,7 @@ realFx operator-(const T& num, const realFx& foo)
 
 	eval = static_cast<long double>(num);
 
-	bar = [&foo, &eval](long double& x) -> long double
+	bar = [foo, eval](long double& x) -> long double
 		{
 			return eval - foo(x);
 		};
@@ -710,9 +1001,9 @@ realFx operator-(const T& num, const realFx& foo)
 // binary subtraction
 realFx realFx::operator-(const realFx& other)
 {
-	real_fx_type foo_bar = [this, other](long double& x) -> long double
+	real_fx_type foo_bar = [foo = this->foo, other](long double& x) -> long double
 		{
-			return this->foo(x) - other.foo(x);
+			return foo(x) - other.foo(x);
 		};
 
 	return realFx(foo_bar);
@@ -726,7 +1017,7 @@ realFx realFx::operator*(const T& scalar)
 
 	num = static_cast<long double>(scalar);
 
-	real_fx_type bar = [&foo, &num](long double& x) -> long double
+	real_fx_type bar = [foo = this->foo, num](long double& x) -> long double
 		{
 			return foo(x) * num;
 		};
@@ -736,8 +1027,7 @@ realFx realFx::operator*(const T& scalar)
 
 // binary multiplication
 // friend operator
-template <typename T,
-	typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+template <typename T, typename>
 realFx operator*(const T& num, const realFx& foo)
 {
 	realFx::real_fx_type bar;
@@ -745,7 +1035,7 @@ realFx operator*(const T& num, const realFx& foo)
 
 	eval = static_cast<long double>(num);
 
-	bar = [&foo, &eval](long double& x) -> long double
+	bar = [foo, eval](long double& x) -> long double
 		{
 			return eval * foo(x);
 		};
@@ -756,9 +1046,9 @@ realFx operator*(const T& num, const realFx& foo)
 // binary multiplication
 realFx realFx::operator*(const realFx& other)
 {
-	real_fx_type foo_bar = [this, other](long double& x) -> long double
+	real_fx_type foo_bar = [foo = this->foo, other](long double& x) -> long double
 		{
-			return this->foo(x) * other.foo(x);
+			return foo(x) * other.foo(x);
 		};
 
 	return realFx(foo_bar);
@@ -772,7 +1062,7 @@ realFx realFx::operator/(const T& scalar)
 
 	num = static_cast<long double>(scalar);
 
-	real_fx_type bar = [&foo, &num](long double& x) -> long double
+	real_fx_type bar = [foo = this->foo, num](long double& x) -> long double
 		{
 			return foo(x) / num;
 		};
@@ -782,8 +1072,7 @@ realFx realFx::operator/(const T& scalar)
 
 // binary division
 // friend operator
-template <typename T,
-	typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+template <typename T, typename>
 realFx operator/(const T& num, const realFx& foo)
 {
 	realFx::real_fx_type bar;
@@ -791,7 +1080,7 @@ realFx operator/(const T& num, const realFx& foo)
 
 	eval = static_cast<long double>(num);
 
-	bar = [&foo, &eval](long double& x) -> long double
+	bar = [foo, eval](long double& x) -> long double
 		{
 			return eval / foo(x);
 		};
@@ -802,9 +1091,9 @@ realFx operator/(const T& num, const realFx& foo)
 // binary division
 realFx realFx::operator/(const realFx& other)
 {
-	real_fx_type foo_bar = [this, other](long double& x) -> long double
+	real_fx_type foo_bar = [foo = this->foo, other](long double& x) -> long double
 		{
-			return this->foo(x) / other.foo(x);
+			return foo(x) / other.foo(x);
 		};
 
 	return realFx(foo_bar);
@@ -818,7 +1107,7 @@ realFx realFx::operator^(const T& power)
 
 	num = static_cast<long double>(power);
 
-	real_fx_type bar = [&foo, &num](long double& x) -> long double
+	real_fx_type bar = [foo = this->foo, num](long double& x) -> long double
 		{
 			return pow(foo(x), num);
 		};
@@ -828,8 +1117,7 @@ realFx realFx::operator^(const T& power)
 
 // bitwise exponentiation
 // friend operator
-template <typename T,
-	typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+template <typename T, typename>
 realFx operator^(const T& num, const realFx& foo)
 {
 	realFx::real_fx_type bar;
@@ -837,9 +1125,9 @@ realFx operator^(const T& num, const realFx& foo)
 
 	eval = static_cast<long double>(num);
 
-	bar = [&foo, &eval](long double& x) -> long double
+	bar = [foo, eval](long double& x) -> long double
 		{
-			return eval ^ foo(x);
+			return std::pow(eval, foo(x));
 		};
 
 	return realFx(bar);
@@ -848,9 +1136,9 @@ realFx operator^(const T& num, const realFx& foo)
 // bitwise exponentiation
 realFx realFx::operator^(const realFx& other)
 {
-	auto foo_bar = [this, other](long double& x) -> long double
+	auto foo_bar = [foo = this->foo, other](long double& x) -> long double
 		{
-			return pow(this->foo(x), other.foo(x));
+			return pow(foo(x), other.foo(x));
 		};
 
 	return realFx(foo_bar);
@@ -865,22 +1153,42 @@ long double realFx::operator()(const T& x) const
 	return foo(val);
 }
 
+// batch evaluation
+// one call per chunk instead of per value, the function object is read
+//	once and the loop stays in cache
+void realFx::evaluate_batch(const long double* xs, long double* ys,
+	std::size_t count) const
+{
+	if (graph)
+	{
+		graph->evaluate_batch(xs, count, ys);
+		return;
+	}
+
+	const real_fx_type& bar = foo;
+	long double x;
+
+	for (std::size_t i = 0; i < count; i++)
+	{
+		x = xs[i];
+		ys[i] = bar(x);
+	}
+}
+
 // function call operator
 // creates a lambda function to be the 
 realFx realFx::operator()(const realFx& other) const
 {
-	long double result;
 	real_fx_type foo, bar, foo_o_bar;
 	
 	foo = this->foo;
 	bar = other.foo;
 
-	foo_o_bar = [foo, bar, &result](long double& x) -> long double&
+	foo_o_bar = [foo, bar](long double& x) -> long double
 		{
 			long double bar_x = bar(x);
-			result = foo(bar_x);
 
-			return result;
+			return foo(bar_x);
 		};
 
 	return realFx(foo_o_bar);
@@ -892,6 +1200,71 @@ realFx& realFx::operator=(const realFx& other)
 	if (this != &other)
 	{
 		foo = other.foo;
+		graph = other.graph;
 	}
 	return *this;
 }
+
+
+
+	/* definitions */
+
+// trapezoidal weights on the samples, the linear convolution of the two
+//	sample sets is taken through a zero-padded power of two transform
+realFx convolve(const realFx& f, const realFx& g, long double a,
+	long double b, std::size_t n)
+{
+	std::size_t m = 1;
+	long double h;
+
+	if (n < 2)
+		throw std::invalid_argument("Convolution needs at least 2 samples\n");
+	if (!(a < b))
+		throw std::invalid_argument("Left bound must be less than the right"
+			" bound\n");
+
+	h = (b - a) / (n - 1);
+	while (m < 2 * n - 1) m <<= 1;
+
+	std::vector<double> fr(m, 0.0), fi(m, 0.0), gr(m, 0.0), gi(m, 0.0);
+	auto table = std::make_shared<std::vector<long double>>(2 * n - 1);
+	const fftPlan& plan = fftPlan::get(m);
+	double r;
+
+	for (std::size_t k = 0; k < n; k++)
+	{
+		const double w = (k == 0 || k == n - 1) ? 0.5 : 1.0;
+		fr[k] = w * static_cast<double>(f(a + k * h));
+		gr[k] = w * static_cast<double>(g(a + k * h));
+	}
+
+	plan.execute(fr.data(), fi.data());
+	plan.execute(gr.data(), gi.data());
+
+	for (std::size_t k = 0; k < m; k++)
+	{
+		r = fr[k] * gr[k] - fi[k] * gi[k];
+		fi[k] = fr[k] * gi[k] + fi[k] * gr[k];
+		fr[k] = r;
+	}
+
+	plan.execute(fr.data(), fi.data(), true);
+
+	for (std::size_t k = 0; k < table->size(); k++)
+		(*table)[k] = h * fr[k] / m;
+
+	return realFx(std::function<long double(long double&)>(
+		[table, left = 2 * a, h](long double& x) -> long double
+		{
+			const long double t = (x - left) / h;
+			const std::size_t last = table->size() - 1;
+			std::size_t i;
+
+			if (!(t >= 0) || t > last)
+				return 0.0l;
+
+			i = std::min(static_cast<std::size_t>(t), last - 1);
+
+			return (*table)[i] + (t - i) * ((*table)[i + 1] - (*table)[i]);
+		}));
+}
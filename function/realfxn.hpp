@@ -0,0 +1,786 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+// purpose: represents a real-valued function of several variables, i.e.
+//	f(x0, x1, ..., xn) built from variables, constants and the same operator
+//	vocabulary as realFx, with reverse-mode automatic differentiation
+// invariants: the expression graph is immutable once built, so copies and
+//	sub-functions share nodes freely; variables are indexed from 0
+// data members:
+//	'root' is the node of the expression graph this function evaluates
+//	'compiled' is the flattened program (the tape), built on first use and
+//	shared between copies
+class realFxN
+{
+public:
+		/* prerequisites */
+
+	// the operations a node of the graph can hold
+	// the numbering is part of the serialized format, only append to it
+	enum class op : std::uint8_t
+	{
+		CONST, VAR, ADD, SUB, MUL, DIV, POW, NEG,
+		SIN, COS, TAN, EXP, LOG, SQRT, ABS, TABLE
+	};
+
+	// one step of the flattened program
+	// 'lhs' and 'rhs' index earlier steps, except for VAR where 'lhs' is the
+	//	index of the variable and TABLE where 'rhs' is the index of the
+	//	table; 'value' holds the constant of a CONST step
+	struct instruction
+	{
+		op code;
+		std::uint32_t lhs;
+		std::uint32_t rhs;
+		long double value;
+	};
+
+	// a tabulated proxy, i.e. 'count' samples on a uniform grid over
+	//	[left, right] starting at 'offset' in the table data, linearly
+	//	interpolated and NaN outside the grid
+	struct table
+	{
+		long double left;
+		long double right;
+		std::uint64_t count;
+		std::uint64_t offset;
+	};
+
+	// a flattened program with its tables, either owned by a realFxN or
+	//	read straight out of a serialized image
+	struct view
+	{
+		const instruction* steps;
+		std::size_t size;
+		const table* tables;
+		std::size_t table_count;
+		const long double* data;
+		std::size_t data_size;
+		std::size_t dimension;
+	};
+
+private:
+		/* prerequisites */
+
+	// the samples of a tabulated proxy
+	struct samples
+	{
+		long double left;
+		long double right;
+		std::vector<long double> ys;
+	};
+
+	struct node
+	{
+		op code;
+		std::shared_ptr<const node> lhs;
+		std::shared_ptr<const node> rhs;
+		long double value;
+		std::uint32_t index;
+		std::shared_ptr<const samples> grid;
+	};
+
+	struct program
+	{
+		std::once_flag built;
+		std::vector<instruction> tape;
+		std::vector<table> tables;
+		std::vector<long double> data;
+		std::size_t dimension = 0;
+
+		view get() const
+		{
+			return view{ tape.data(), tape.size(), tables.data(),
+				tables.size(), data.data(), data.size(), dimension };
+		}
+	};
+
+	// the number of points evaluated together by the batched kernels
+	static constexpr std::size_t BATCH = 64;
+
+		/* member variables */
+
+	std::shared_ptr<const node> root;
+
+	std::shared_ptr<program> compiled;
+
+		/* member functions */
+
+	// purpose: builds a function around an existing node
+	// requires: a node
+	explicit realFxN(std::shared_ptr<const node>);
+
+	// purpose: creates a new node from an operation and its operand(s)
+	// requires: an operation and one or two functions
+	// returns: a new function
+	static realFxN make(op, const realFxN&);
+	static realFxN make(op, const realFxN&, const realFxN&);
+
+	// purpose: flattens the graph into a program, once per graph
+	// requires: nothing
+	// returns: the compiled program
+	const program& tape() const;
+
+	// purpose: checks whether a step reads a second operand, 'rhs' means
+	//	nothing to the others and is never read for them
+	// requires: the op code
+	// returns: a bool
+	static bool binary(op code) { return code >= op::ADD && code <= op::POW; }
+
+	// purpose: interpolates a table
+	// requires: a table, the table data, a value and where to put the slope
+	//	(nullptr if it is not needed)
+	// returns: the interpolated value
+	static long double lookup(const table&, const long double*, long double,
+		long double*);
+
+	// purpose: runs the forward sweep of a program
+	// requires: a program, a point and the buffer the step values go into
+	// returns: nothing, but fills the buffer
+	static void forward(const view&, const long double*, long double*);
+
+	// purpose: runs the reverse sweep of a program
+	// requires: a program, the step values of the forward sweep, a buffer for
+	//	the adjoints and the gradient to accumulate into
+	// returns: nothing, but fills the gradient
+	static void reverse(const view&, const long double*, long double*,
+		long double*);
+
+	// purpose: runs the forward sweep over a block of points at once
+	// requires: a program, the points stored one after another, the number
+	//	of points (at most BATCH), a buffer of size() * BATCH step values and
+	//	the output
+	// returns: nothing, but fills the output
+	static void forward_batch(const view&, const long double*, std::size_t,
+		long double*, long double*);
+
+	friend class fxImage;
+
+public:
+
+		/* constructors */
+
+	// default constructor
+	// the zero function
+	realFxN();
+
+	// parametrized constructor
+	// creates a constant valued function
+	template <typename T,
+		typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+	realFxN(const T&);
+
+	// copy constructor
+	realFxN(const realFxN&) = default;
+
+	// destructor
+	~realFxN() {}
+
+		/* factories */
+
+	// purpose: creates the function that returns one coordinate of the point
+	// requires: the index of the coordinate
+	// returns: a new function
+	static realFxN variable(std::uint32_t);
+
+	// purpose: creates a tabulated proxy of a function of one variable, so
+	//	opaque functions (a realFx, a lambda) can live inside a graph
+	// requires: the function, its argument, the bounds of the grid and the
+	//	number of samples
+	// returns: a new function, linear between samples and NaN outside
+	template <typename F>
+	static realFxN tabulate(const F&, const realFxN&, long double,
+		long double, std::size_t);
+
+		/* member functions */
+
+	// purpose: finds how many coordinates the function reads
+	// requires: nothing
+	// returns: one more than the largest variable index
+	std::size_t dimension() const { return tape().dimension; }
+
+	// purpose: finds the flattened program of the function
+	// requires: nothing
+	// returns: the steps in evaluation order, the last one is the result
+	const std::vector<instruction>& instructions() const
+	{ return tape().tape; }
+
+	// purpose: finds the flattened program together with its tables
+	// requires: nothing
+	// returns: a view that stays valid as long as this function
+	view program_view() const { return tape().get(); }
+
+	// purpose: evaluates the function and its full gradient in one forward
+	//	and one reverse sweep
+	// requires: a point and a vector to hold the gradient
+	// returns: a long double i.e. the value at the point
+	long double gradient(const std::vector<long double>&,
+		std::vector<long double>&) const;
+
+	// purpose: evaluates the full gradient at a point
+	// requires: a point
+	// returns: a vector i.e. the gradient
+	std::vector<long double> gradient(const std::vector<long double>&) const;
+
+	// purpose: calculates one partial derivative at a point
+	// requires: a point and the index of the variable
+	// returns: a long double i.e. the partial derivative
+	long double derive_at(const std::vector<long double>&, std::size_t) const;
+
+	// purpose: evaluates the function at many points at once
+	// requires: the points stored one after another, i.e. 'count' rows of
+	//	dimension() values, the number of points and an output of 'count'
+	//	values
+	// returns: nothing, but fills the output
+	void evaluate_batch(const long double*, std::size_t, long double*) const;
+
+	// purpose: evaluates the function at many points at once
+	// requires: a vector of points
+	// returns: a vector of values
+	std::vector<long double> evaluate_batch
+	(const std::vector<std::vector<long double>>&) const;
+
+	// purpose: evaluates the function and its gradient at many points
+	// requires: the points stored one after another, the number of points,
+	//	an output of 'count' values and an output of 'count' rows of
+	//	dimension() partial derivatives
+	// returns: nothing, but fills both outputs
+	void gradient_batch(const long double*, std::size_t, long double*,
+		long double*) const;
+
+	// purpose: reflects the function about the x-axis
+	// requires: nothing
+	// returns: a new function
+	realFxN reflectX() const { return make(op::NEG, *this); }
+
+	// purpose: scales a function in the y direction
+	// requires: a scalar
+	// returns: a new function
+	realFxN scaleY(long double c) const { return *this * c; }
+
+	// purpose: shifts a function in the y direction
+	// requires: a scalar
+	// returns: a new function
+	realFxN shiftY(long double dy) const { return *this + dy; }
+
+		/* operators */
+
+	// purpose: adds two functions
+	// requires: a real valued function
+	// returns: a new function
+	realFxN operator+(const realFxN& other) const
+	{ return make(op::ADD, *this, other); }
+
+	// purpose: subtracts a function from another
+	// requires: a real valued function
+	// returns: a new function
+	realFxN operator-(const realFxN& other) const
+	{ return make(op::SUB, *this, other); }
+
+	// purpose: negates the function
+	// requires: nothing
+	// returns: a new function
+	realFxN operator-() const { return make(op::NEG, *this); }
+
+	// purpose: multiplies two functions
+	// requires: a real valued function
+	// returns: a new function
+	realFxN operator*(const realFxN& other) const
+	{ return make(op::MUL, *this, other); }
+
+	// purpose: divides a function by another function
+	// requires: a real valued function
+	// returns: a new function
+	realFxN operator/(const realFxN& other) const
+	{ return make(op::DIV, *this, other); }
+
+	// purpose: raises a function to the power of another function
+	//	f(x) ^ g(x)
+	// requires: a real valued function
+	// returns: a new function
+	realFxN operator^(const realFxN& other) const
+	{ return make(op::POW, *this, other); }
+
+	// purpose: scalar on the left of a binary operator, c + f(x) etc.
+	// requires: a scalar and a function
+	// returns: a new function
+	template <typename T,
+		typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+	friend realFxN operator+(const T& c, const realFxN& f)
+	{ return realFxN(c) + f; }
+
+	template <typename T,
+		typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+	friend realFxN operator-(const T& c, const realFxN& f)
+	{ return realFxN(c) - f; }
+
+	template <typename T,
+		typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+	friend realFxN operator*(const T& c, const realFxN& f)
+	{ return realFxN(c) * f; }
+
+	template <typename T,
+		typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+	friend realFxN operator/(const T& c, const realFxN& f)
+	{ return realFxN(c) / f; }
+
+	template <typename T,
+		typename = std::enable_if_t<std::is_convertible_v<T, long double>>>
+	friend realFxN operator^(const T& c, const realFxN& f)
+	{ return realFxN(c) ^ f; }
+
+	// purpose: elementary functions of a function
+	// requires: a function
+	// returns: a new function
+	friend realFxN sin(const realFxN& f) { return make(op::SIN, f); }
+	friend realFxN cos(const realFxN& f) { return make(op::COS, f); }
+	friend realFxN tan(const realFxN& f) { return make(op::TAN, f); }
+	friend realFxN exp(const realFxN& f) { return make(op::EXP, f); }
+	friend realFxN log(const realFxN& f) { return make(op::LOG, f); }
+	friend realFxN sqrt(const realFxN& f) { return make(op::SQRT, f); }
+	friend realFxN abs(const realFxN& f) { return make(op::ABS, f); }
+
+	// purpose: raises a function to the power of another, as operator^ does,
+	//	under the name generic code calls
+	// requires: the base and the exponent
+	// returns: a new function
+	friend realFxN pow(const realFxN& f, const realFxN& g)
+	{ return make(op::POW, f, g); }
+
+	// purpose: evaluates the function at a point
+	// requires: a point with at least dimension() coordinates
+	// returns: a long double, i.e. the result
+	long double operator()(const std::vector<long double>&) const;
+
+	// purpose: evaluates the function at a point
+	// requires: a pointer to at least dimension() coordinates
+	// returns: a long double, i.e. the result
+	long double operator()(const long double*) const;
+
+	// purpose: assigns a function to this one
+	// requires: a real function
+	// returns: a real function
+	realFxN& operator=(const realFxN&) = default;
+
+};
+
+
+	/* constructors */
+
+// parametrized constructor
+// wraps an existing node
+realFxN::realFxN(std::shared_ptr<const node> n)
+	: root(std::move(n)), compiled(std::make_shared<program>()) {}
+
+// default constructor
+realFxN::realFxN() : realFxN(0.0l) {}
+
+// parametrized constructor
+// makes a constant-valued function
+template <typename T, typename>
+realFxN::realFxN(const T& number)
+	: realFxN(std::make_shared<const node>(node{ op::CONST, nullptr, nullptr,
+		static_cast<long double>(number), 0, nullptr })) {}
+
+
+	/* factories */
+
+realFxN realFxN::variable(std::uint32_t i)
+{
+	return realFxN(std::make_shared<const node>(
+		node{ op::VAR, nullptr, nullptr, 0.0l, i, nullptr }));
+}
+
+template <typename F>
+realFxN realFxN::tabulate(const F& f, const realFxN& arg, long double a,
+	long double b, std::size_t n)
+{
+	auto grid = std::make_shared<samples>();
+	long double x;
+
+	if (n < 2 || !(a < b))
+		throw std::invalid_argument("A table needs at least 2 samples over a"
+			" non-empty interval\n");
+
+	grid->left = a;
+	grid->right = b;
+	grid->ys.resize(n);
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		x = a + (b - a) * i / (n - 1);
+		grid->ys[i] = static_cast<long double>(f(x));
+	}
+
+	return realFxN(std::make_shared<const node>(
+		node{ op::TABLE, arg.root, nullptr, 0.0l, 0, std::move(grid) }));
+}
+
+
+	/* methods */
+
+/* private */
+
+realFxN realFxN::make(op code, const realFxN& l)
+{
+	return realFxN(std::make_shared<const node>(
+		node{ code, l.root, nullptr, 0.0l, 0, nullptr }));
+}
+
+realFxN realFxN::make(op code, const realFxN& l, const realFxN& r)
+{
+	return realFxN(std::make_shared<const node>(
+		node{ code, l.root, r.root, 0.0l, 0, nullptr }));
+}
+
+// flatten the graph with an iterative post-order walk
+// shared sub-graphs become a single step of the program
+const realFxN::program& realFxN::tape() const
+{
+	std::call_once(compiled->built, [this]()
+		{
+			std::unordered_map<const node*, std::uint32_t> seen;
+			std::unordered_map<const samples*, std::uint32_t> grids;
+			std::vector<std::pair<const node*, bool>> work;
+			std::vector<instruction>& out = compiled->tape;
+
+			work.push_back({ root.get(), false });
+
+			while (!work.empty())
+			{
+				auto [n, expanded] = work.back();
+				work.pop_back();
+
+				if (seen.count(n))
+					continue;
+
+				if (!expanded)
+				{
+					// visit the operands first
+					work.push_back({ n, true });
+					if (n->rhs) work.push_back({ n->rhs.get(), false });
+					if (n->lhs) work.push_back({ n->lhs.get(), false });
+					continue;
+				}
+
+				instruction step{ n->code, 0, 0, n->value };
+
+				if (n->code == op::VAR)
+				{
+					step.lhs = n->index;
+					compiled->dimension = std::max<std::size_t>(
+						compiled->dimension, n->index + std::size_t(1));
+				}
+				if (n->lhs) step.lhs = seen.at(n->lhs.get());
+				if (n->rhs) step.rhs = seen.at(n->rhs.get());
+
+				// every table is stored once, however often it is used
+				if (n->grid && !grids.count(n->grid.get()))
+				{
+					grids[n->grid.get()] = static_cast<std::uint32_t>(
+						compiled->tables.size());
+					compiled->tables.push_back(table{ n->grid->left,
+						n->grid->right, n->grid->ys.size(),
+						compiled->data.size() });
+					compiled->data.insert(compiled->data.end(),
+						n->grid->ys.begin(), n->grid->ys.end());
+				}
+				if (n->grid) step.rhs = grids.at(n->grid.get());
+
+				seen[n] = static_cast<std::uint32_t>(out.size());
+				out.push_back(step);
+			}
+		});
+
+	return *compiled;
+}
+
+long double realFxN::lookup(const table& t, const long double* data,
+	long double x, long double* slope)
+{
+	const long double width = (t.right - t.left) / (t.count - 1);
+	const long double u = (x - t.left) / width;
+	const long double* ys = data + t.offset;
+	std::size_t i;
+
+	if (!(u >= 0) || u > t.count - 1)
+	{
+		if (slope) *slope = std::nan("");
+		return std::nan("");
+	}
+
+	i = std::min(static_cast<std::size_t>(u), static_cast<std::size_t>(
+		t.count - 2));
+
+	if (slope) *slope = (ys[i + 1] - ys[i]) / width;
+
+	return ys[i] + (u - i) * (ys[i + 1] - ys[i]);
+}
+
+void realFxN::forward(const view& prog, const long double* x, long double* v)
+{
+	for (std::size_t i = 0; i < prog.size; i++)
+	{
+		const instruction& s = prog.steps[i];
+
+		if (s.code == op::CONST) { v[i] = s.value; continue; }
+		if (s.code == op::VAR) { v[i] = x[s.lhs]; continue; }
+
+		const long double a = v[s.lhs];
+		const long double b = binary(s.code) ? v[s.rhs] : 0.0l;
+
+		switch (s.code)
+		{
+		case op::ADD: v[i] = a + b; break;
+		case op::SUB: v[i] = a - b; break;
+		case op::MUL: v[i] = a * b; break;
+		case op::DIV: v[i] = a / b; break;
+		case op::POW: v[i] = std::pow(a, b); break;
+		case op::NEG: v[i] = -a; break;
+		case op::SIN: v[i] = std::sin(a); break;
+		case op::COS: v[i] = std::cos(a); break;
+		case op::TAN: v[i] = std::tan(a); break;
+		case op::EXP: v[i] = std::exp(a); break;
+		case op::LOG: v[i] = std::log(a); break;
+		case op::SQRT: v[i] = std::sqrt(a); break;
+		case op::ABS: v[i] = std::abs(a); break;
+		case op::TABLE:
+			v[i] = lookup(prog.tables[s.rhs], prog.data, a, nullptr);
+			break;
+		default: break;
+		}
+	}
+}
+
+// walk the tape backwards pushing each adjoint onto its operands
+void realFxN::reverse(const view& prog, const long double* v,
+	long double* adj, long double* grad)
+{
+	long double slope;
+
+	std::fill(adj, adj + prog.size, 0.0l);
+	adj[prog.size - 1] = 1.0l;
+
+	for (std::size_t i = prog.size; i-- > 0;)
+	{
+		const instruction& s = prog.steps[i];
+		const long double g = adj[i];
+
+		if (g == 0.0l || s.code == op::CONST)
+			continue;
+		if (s.code == op::VAR) { grad[s.lhs] += g; continue; }
+
+		const long double a = v[s.lhs];
+		const long double b = binary(s.code) ? v[s.rhs] : 0.0l;
+
+		switch (s.code)
+		{
+		case op::ADD: adj[s.lhs] += g; adj[s.rhs] += g; break;
+		case op::SUB: adj[s.lhs] += g; adj[s.rhs] -= g; break;
+		case op::MUL: adj[s.lhs] += g * b; adj[s.rhs] += g * a; break;
+		case op::DIV:
+			adj[s.lhs] += g / b;
+			adj[s.rhs] -= g * v[i] / b;
+			break;
+		case op::POW:
+			adj[s.lhs] += g * b * std::pow(a, b - 1);
+			// the exponent only has a derivative where the log is defined
+			if (a > 0) adj[s.rhs] += g * v[i] * std::log(a);
+			break;
+		case op::NEG: adj[s.lhs] -= g; break;
+		case op::SIN: adj[s.lhs] += g * std::cos(a); break;
+		case op::COS: adj[s.lhs] -= g * std::sin(a); break;
+		case op::TAN: adj[s.lhs] += g * (1 + v[i] * v[i]); break;
+		case op::EXP: adj[s.lhs] += g * v[i]; break;
+		case op::LOG: adj[s.lhs] += g / a; break;
+		case op::SQRT: adj[s.lhs] += g / (2 * v[i]); break;
+		case op::ABS: adj[s.lhs] += (a < 0) ? -g : g; break;
+		case op::TABLE:
+			lookup(prog.tables[s.rhs], prog.data, a, &slope);
+			adj[s.lhs] += g * slope;
+			break;
+		default: break;
+		}
+	}
+}
+
+// evaluate a block of points per pass over the program, so each step runs as
+//	a tight loop over lanes instead of once per point
+void realFxN::forward_batch(const view& prog, const long double* x,
+	std::size_t lanes, long double* v, long double* out)
+{
+	const std::size_t dim = prog.dimension;
+
+	for (std::size_t i = 0; i < prog.size; i++)
+	{
+		const instruction& s = prog.steps[i];
+		long double* r = v + i * BATCH;
+		std::size_t k;
+
+		if (s.code == op::CONST)
+		{
+			for (k = 0; k < lanes; k++) r[k] = s.value;
+			continue;
+		}
+		if (s.code == op::VAR)
+		{
+			for (k = 0; k < lanes; k++) r[k] = x[k * dim + s.lhs];
+			continue;
+		}
+
+		const long double* a = v + s.lhs * BATCH;
+		const long double* b = binary(s.code) ? v + s.rhs * BATCH : a;
+
+		switch (s.code)
+		{
+		case op::ADD: for (k = 0; k < lanes; k++) r[k] = a[k] + b[k]; break;
+		case op::SUB: for (k = 0; k < lanes; k++) r[k] = a[k] - b[k]; break;
+		case op::MUL: for (k = 0; k < lanes; k++) r[k] = a[k] * b[k]; break;
+		case op::DIV: for (k = 0; k < lanes; k++) r[k] = a[k] / b[k]; break;
+		case op::POW:
+			for (k = 0; k < lanes; k++) r[k] = std::pow(a[k], b[k]);
+			break;
+		case op::NEG: for (k = 0; k < lanes; k++) r[k] = -a[k]; break;
+		case op::SIN: for (k = 0; k < lanes; k++) r[k] = std::sin(a[k]); break;
+		case op::COS: for (k = 0; k < lanes; k++) r[k] = std::cos(a[k]); break;
+		case op::TAN: for (k = 0; k < lanes; k++) r[k] = std::tan(a[k]); break;
+		case op::EXP: for (k = 0; k < lanes; k++) r[k] = std::exp(a[k]); break;
+		case op::LOG: for (k = 0; k < lanes; k++) r[k] = std::log(a[k]); break;
+		case op::SQRT:
+			for (k = 0; k < lanes; k++) r[k] = std::sqrt(a[k]);
+			break;
+		case op::ABS: for (k = 0; k < lanes; k++) r[k] = std::abs(a[k]); break;
+		case op::TABLE:
+			for (k = 0; k < lanes; k++)
+				r[k] = lookup(prog.tables[s.rhs], prog.data, a[k], nullptr);
+			break;
+		default: break;
+		}
+	}
+
+	std::copy(v + (prog.size - 1) * BATCH, v + (prog.size - 1) * BATCH + lanes,
+		out);
+}
+
+/* public */
+
+// the forward values and adjoints live in a per-thread arena so repeated
+//	gradients do not allocate
+long double realFxN::gradient(const std::vector<long double>& x,
+	std::vector<long double>& grad) const
+{
+	thread_local std::vector<long double> arena;
+	const program& p = tape();
+
+	if (x.size() < p.dimension)
+		throw std::invalid_argument("Point has fewer coordinates than the"
+			" function has variables\n");
+
+	arena.resize(2 * p.tape.size());
+	grad.assign(std::max(x.size(), p.dimension), 0.0l);
+
+	forward(p.get(), x.data(), arena.data());
+	reverse(p.get(), arena.data(), arena.data() + p.tape.size(), grad.data());
+
+	return arena[p.tape.size() - 1];
+}
+
+std::vector<long double> realFxN::gradient
+(const std::vector<long double>& x) const
+{
+	std::vector<long double> grad;
+	gradient(x, grad);
+	return grad;
+}
+
+long double realFxN::derive_at(const std::vector<long double>& x,
+	std::size_t i) const
+{
+	std::vector<long double> grad;
+	gradient(x, grad);
+	return (i < grad.size()) ? grad[i] : 0.0l;
+}
+
+void realFxN::evaluate_batch(const long double* xs, std::size_t count,
+	long double* out) const
+{
+	const program& p = tape();
+	std::vector<long double> v(p.tape.size() * BATCH);
+
+	for (std::size_t base = 0; base < count; base += BATCH)
+		forward_batch(p.get(), xs + base * p.dimension,
+			std::min(BATCH, count - base), v.data(), out + base);
+}
+
+std::vector<long double> realFxN::evaluate_batch
+(const std::vector<std::vector<long double>>& points) const
+{
+	const std::size_t dim = dimension();
+	std::vector<long double> flat(points.size() * dim);
+	std::vector<long double> out(points.size());
+
+	for (std::size_t i = 0; i < points.size(); i++)
+	{
+		if (points[i].size() < dim)
+			throw std::invalid_argument("Point has fewer coordinates than the"
+				" function has variables\n");
+		std::copy(points[i].begin(), points[i].begin() + dim,
+			flat.begin() + i * dim);
+	}
+
+	evaluate_batch(flat.data(), points.size(), out.data());
+
+	return out;
+}
+
+void realFxN::gradient_batch(const long double* xs, std::size_t count,
+	long double* out, long double* grads) const
+{
+	const program& p = tape();
+	const std::size_t n = p.tape.size(), dim = p.dimension;
+	std::vector<long double> arena(2 * n);
+
+	for (std::size_t k = 0; k < count; k++)
+	{
+		std::fill(grads + k * dim, grads + (k + 1) * dim, 0.0l);
+		forward(p.get(), xs + k * dim, arena.data());
+		reverse(p.get(), arena.data(), arena.data() + n, grads + k * dim);
+		out[k] = arena[n - 1];
+	}
+}
+
+
+	/* operators */
+
+long double realFxN::operator()(const std::vector<long double>& x) const
+{
+	if (x.size() < dimension())
+		throw std::invalid_argument("Point has fewer coordinates than the"
+			" function has variables\n");
+
+	return (*this)(x.data());
+}
+
+long double realFxN::operator()(const long double* x) const
+{
+	thread_local std::vector<long double> arena;
+	const program& p = tape();
+
+	arena.resize(p.tape.size());
+	forward(p.get(), x, arena.data());
+
+	return arena[p.tape.size() - 1];
+}
@@ -0,0 +1,328 @@
+#pragma once
+
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+
+// purpose: a piecewise cubic interpolant of samples (x, y)
+// invariants: breakpoints are strictly increasing and there are at least
+//	two; outside of them the first or last piece is extrapolated
+// data members:
+//	'xs' holds the breakpoints in sorted order
+//	'pieces' holds the polynomial of each interval, in powers of x - xs[i]
+//	'tree' holds the breakpoints in Eytzinger (breadth first) order, 1-based,
+//	so the search walks down an implicit tree touching one cache line per
+//	few levels, and 'rank' maps a tree slot back to its sorted index
+//	'uniform' is true when the breakpoints are evenly spaced, the interval
+//	is then computed directly from 'inv_h'
+class cubicSpline
+{
+public:
+		/* prerequisites */
+
+	// how the slopes at the breakpoints are chosen
+	// NATURAL has zero curvature at both ends, CLAMPED has given end slopes,
+	//	PCHIP is Fritsch and Carlson's monotone Hermite interpolant, it never
+	//	overshoots the data
+	enum class kind { NATURAL, CLAMPED, PCHIP };
+
+private:
+		/* prerequisites */
+
+	// y = a + t(b + t(c + t d)) with t = x - xs[i]
+	struct piece
+	{
+		long double a;
+		long double b;
+		long double c;
+		long double d;
+	};
+
+		/* member variables */
+
+	std::vector<long double> xs;
+
+	std::vector<piece> pieces;
+
+	std::vector<long double> tree;
+
+	std::vector<std::size_t> rank;
+
+	bool uniform = false;
+
+	long double inv_h = 0;
+
+		/* member functions */
+
+	// purpose: lays the breakpoints out in Eytzinger order
+	// requires: the next sorted index, and the tree slot to fill
+	// returns: the next sorted index after this subtree
+	std::size_t build_tree(std::size_t, std::size_t);
+
+	// purpose: finds the slopes of a natural or clamped spline
+	// requires: the samples, the kind and the end slopes
+	// returns: the slope at each breakpoint
+	std::vector<long double> spline_slopes(const std::vector<long double>&,
+		kind, long double, long double) const;
+
+	// purpose: finds the slopes of a monotone interpolant
+	// requires: the samples
+	// returns: the slope at each breakpoint
+	std::vector<long double> pchip_slopes(const std::vector<long double>&)
+		const;
+
+public:
+
+		/* constructors */
+
+	// parametrized constructor
+	// takes the breakpoints, the values, the kind (natural by default) and
+	//	the end slopes, which are only read by a clamped spline
+	cubicSpline(const std::vector<long double>&,
+		const std::vector<long double>&, kind = kind::NATURAL,
+		long double = 0, long double = 0);
+
+		/* member functions */
+
+	// purpose: finds the interval that holds a value
+	// requires: a value
+	// returns: i such that xs[i] <= x < xs[i + 1], clamped to the first and
+	//	last interval
+	std::size_t interval(long double) const;
+
+	// purpose: evaluates the interpolant at many values at once
+	// requires: the inputs, the outputs and the count
+	// returns: nothing, but fills the outputs
+	void evaluate_batch(const long double*, long double*, std::size_t) const;
+
+	// purpose: finds the breakpoints
+	// requires: nothing
+	// returns: the sorted breakpoints
+	const std::vector<long double>& breakpoints() const { return xs; }
+
+		/* operators */
+
+	// purpose: evaluates the interpolant
+	// requires: a value
+	// returns: a long double
+	long double operator()(long double) const;
+
+};
+
+
+	/* constructors */
+
+cubicSpline::cubicSpline(const std::vector<long double>& x,
+	const std::vector<long double>& y, kind k, long double d0, long double dn)
+	: xs(x)
+{
+	const std::size_t n = xs.size();
+	std::vector<long double> slope;
+	long double h, delta;
+
+	if (n < 2 || y.size() != n)
+		throw std::invalid_argument("A spline needs at least 2 samples and"
+			" one value per breakpoint\n");
+
+	for (std::size_t i = 1; i < n; i++)
+		if (!(xs[i - 1] < xs[i]))
+			throw std::invalid_argument("Breakpoints must be strictly"
+				" increasing\n");
+
+	slope = (k == kind::PCHIP) ? pchip_slopes(y) : spline_slopes(y, k, d0, dn);
+
+	// cubic Hermite pieces from the values and slopes at both ends
+	pieces.resize(n - 1);
+	for (std::size_t i = 0; i + 1 < n; i++)
+	{
+		h = xs[i + 1] - xs[i];
+		delta = (y[i + 1] - y[i]) / h;
+		pieces[i] = piece{ y[i], slope[i],
+			(3 * delta - 2 * slope[i] - slope[i + 1]) / h,
+			(slope[i] + slope[i + 1] - 2 * delta) / (h * h) };
+	}
+
+	// evenly spaced to within rounding
+	h = (xs.back() - xs.front()) / (n - 1);
+	uniform = true;
+	for (std::size_t i = 1; i < n && uniform; i++)
+		uniform = std::abs(xs[i] - (xs.front() + i * h)) <= 1e-9l * h;
+	inv_h = 1 / h;
+
+	tree.resize(n + 1);
+	rank.resize(n + 1);
+	build_tree(0, 1);
+}
+
+
+	/* methods */
+
+/* private */
+
+std::size_t cubicSpline::build_tree(std::size_t next, std::size_t k)
+{
+	if (k < tree.size())
+	{
+		next = build_tree(next, 2 * k);
+		tree[k] = xs[next];
+		rank[k] = next++;
+		next = build_tree(next, 2 * k + 1);
+	}
+
+	return next;
+}
+
+// the slopes satisfy the usual tridiagonal system for continuous second
+//	derivatives, solved with the Thomas algorithm
+std::vector<long double> cubicSpline::spline_slopes
+(const std::vector<long double>& y, kind k, long double d0, long double dn)
+const
+{
+	const std::size_t n = xs.size();
+	std::vector<long double> lower(n), diag(n), upper(n), rhs(n), m(n);
+	long double h0, h1, w;
+
+	if (n == 2 && k == kind::NATURAL)
+		return std::vector<long double>(2, (y[1] - y[0]) / (xs[1] - xs[0]));
+
+	if (k == kind::CLAMPED)
+	{
+		diag[0] = 1; rhs[0] = d0;
+		diag[n - 1] = 1; rhs[n - 1] = dn;
+	}
+	else
+	{
+		h0 = xs[1] - xs[0];
+		diag[0] = 2; upper[0] = 1; rhs[0] = 3 * (y[1] - y[0]) / h0;
+		h0 = xs[n - 1] - xs[n - 2];
+		lower[n - 1] = 1; diag[n - 1] = 2;
+		rhs[n - 1] = 3 * (y[n - 1] - y[n - 2]) / h0;
+	}
+
+	for (std::size_t i = 1; i + 1 < n; i++)
+	{
+		h0 = xs[i] - xs[i - 1];
+		h1 = xs[i + 1] - xs[i];
+		lower[i] = h1;
+		diag[i] = 2 * (h0 + h1);
+		upper[i] = h0;
+		rhs[i] = 3 * (h1 * (y[i] - y[i - 1]) / h0
+			+ h0 * (y[i + 1] - y[i]) / h1);
+	}
+
+	for (std::size_t i = 1; i < n; i++)
+	{
+		w = lower[i] / diag[i - 1];
+		diag[i] -= w * upper[i - 1];
+		rhs[i] -= w * rhs[i - 1];
+	}
+
+	m[n - 1] = rhs[n - 1] / diag[n - 1];
+	for (std::size_t i = n - 1; i-- > 0;)
+		m[i] = (rhs[i] - upper[i] * m[i + 1]) / diag[i];
+
+	return m;
+}
+
+// weighted harmonic means of the neighbouring secants, zero at extrema,
+//	with the three point end rule that keeps the ends shape preserving
+std::vector<long double> cubicSpline::pchip_slopes
+(const std::vector<long double>& y) const
+{
+	const std::size_t n = xs.size();
+	std::vector<long double> h(n - 1), delta(n - 1), m(n);
+	long double w1, w2;
+
+	for (std::size_t i = 0; i + 1 < n; i++)
+	{
+		h[i] = xs[i + 1] - xs[i];
+		delta[i] = (y[i + 1] - y[i]) / h[i];
+	}
+
+	if (n == 2)
+		return std::vector<long double>(2, delta[0]);
+
+	for (std::size_t i = 1; i + 1 < n; i++)
+	{
+		if (delta[i - 1] * delta[i] <= 0)
+			m[i] = 0;
+		else
+		{
+			w1 = 2 * h[i] + h[i - 1];
+			w2 = h[i] + 2 * h[i - 1];
+			m[i] = (w1 + w2) / (w1 / delta[i - 1] + w2 / delta[i]);
+		}
+	}
+
+	auto end = [](long double h0, long double h1, long double d0,
+		long double d1) -> long double
+		{
+			long double d = ((2 * h0 + h1) * d0 - h0 * d1) / (h0 + h1);
+
+			if (d * d0 <= 0)
+				return 0;
+			else if (d0 * d1 <= 0 && std::abs(d) > std::abs(3 * d0))
+				return 3 * d0;
+			return d;
+		};
+
+	m[0] = end(h[0], h[1], delta[0], delta[1]);
+	m[n - 1] = end(h[n - 2], h[n - 3], delta[n - 2], delta[n - 3]);
+
+	return m;
+}
+
+/* public */
+
+// the descent is branchless: each level picks a child with a comparison
+//	turned into an index, after the loop the slot of the first breakpoint
+//	greater than x is recovered by dropping the trailing right turns
+std::size_t cubicSpline::interval(long double x) const
+{
+	const std::size_t n = xs.size();
+	std::size_t k = 1, i;
+
+	if (uniform)
+	{
+		const long double u = (x - xs.front()) * inv_h;
+		if (!(u > 0))
+			return 0;
+		// clamped first, the cast is undefined past the range of size_t
+		if (!(u < n - 2))
+			return n - 2;
+		return static_cast<std::size_t>(u);
+	}
+
+	while (k <= n)
+		k = 2 * k + (tree[k] <= x);
+	k >>= std::countr_one(k) + 1;
+
+	// k == 0 means every breakpoint is <= x
+	i = (k == 0) ? n : rank[k];
+
+	return std::min(std::max<std::size_t>(i, 1), n - 1) - 1;
+}
+
+void cubicSpline::evaluate_batch(const long double* in, long double* out,
+	std::size_t count) const
+{
+	for (std::size_t j = 0; j < count; j++)
+		out[j] = (*this)(in[j]);
+}
+
+
+	/* operators */
+
+long double cubicSpline::operator()(long double x) const
+{
+	const std::size_t i = interval(x);
+	const piece& p = pieces[i];
+	const long double t = x - xs[i];
+
+	return p.a + t * (p.b + t * (p.c + t * p.d));
+}
@@ -19,6 +19,11 @@
 
 #include "expression.hpp"
 #include "realfx.hpp"
+#include "piecewise.hpp"
+#include "realfxn.hpp"
+#include "ode.hpp"
+#include "fxstream.hpp"
+#include "fximage.hpp"
 
 
 // calculate euler's constant